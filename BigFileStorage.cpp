@@ -1,5 +1,10 @@
 #include "BigFileStorage.hpp"
 
+#include <string.h>
+#include <vector>
+
+#include <boost/endian/buffers.hpp>
+
 #include "UIntArrayHexFormatter.hpp"
 #include "FileOpsHelpers.hpp"
 #include "FileVersion.hpp"
@@ -32,26 +37,98 @@ public:
 private:
     static const FileMagic s_magic;
     static const FileVersion s_currentVersion;
+    //version with values in linked lists of pages
+    static const FileVersion s_pagesVersion;
     static constexpr size_t k_headerSize = FileMagic::binSize() + FileVersion::binSize() + sizeof(OffsetType);
     static constexpr size_t k_firstPagePointerOffset = FileMagic::binSize() + FileVersion::binSize();
     static constexpr size_t k_pageFullSize = 512;
     static constexpr size_t k_pageDataSize = k_pageFullSize - sizeof(OffsetType);
+    //max number of consecutive pages of chain read at once
+    static constexpr size_t k_maxRunPages = 256;
+
+    //Since version 1.1 value is stored in few extents of 2^sizeClass pages each.
+    //First extent starts with header: size class of the first extent, number of other extents
+    //and offset and size class of each of them. Data follows header and continues in other extents.
+    //Free extents are kept in lists per size class, heads of lists follow file header.
+    static constexpr size_t k_sizeClassesCount = 17;
+    static constexpr size_t k_freeListsOffset = k_headerSize;
+    static constexpr size_t k_maxExtents = 32;
+    //size is rounded up, so that one allocation takes at most this number of extents of sizes below max
+    static constexpr size_t k_maxPartialExtents = 4;
+
+    struct Extent {
+        OffsetType offset;
+        uint8_t sizeClass;
+
+        OffsetType size() const
+        {
+            return static_cast<OffsetType>(k_pageFullSize) << sizeClass;
+        }
+    };
+
+    using ExtentsVector = std::vector<Extent>;
+
+    static size_t extentsHeaderSize(size_t extentsCount)
+    {
+        return 2 + (extentsCount - 1) * (sizeof(OffsetType) + 1);
+    }
+
+    static OffsetType extentsCapacity(const ExtentsVector& extents, size_t count);
+
+    //Size classes of extents to be added to extents of given total size and count to fit dataSize
+    static std::vector<uint8_t> planExtents(size_t dataSize, OffsetType existingSize, size_t existingCount);
+
+    static std::vector<uint8_t> splitToSizeClasses(OffsetType pages);
+
+    OffsetType allocateExtent(uint8_t sizeClass);
+
+    void freeExtent(const Extent& extent);
+
+    void writeFreeListHead(uint8_t sizeClass);
+
+    //Extend file to cover extents allocated at the end of file
+    void reserveAllocatedSpace();
+
+    ExtentsVector loadExtents(OffsetType offset);
+
+    void writeExtents(const ExtentsVector& extents, boost::asio::const_buffer buf);
+
+    OffsetType allocateAndWriteExtents(boost::asio::const_buffer buf);
+
+    void overwriteExtents(OffsetType offset, boost::asio::const_buffer buf);
+
+    void readExtents(OffsetType offset, boost::asio::mutable_buffer buf);
+
+    void freeExtents(OffsetType offset);
 
     OffsetType allocatePage(OffsetType& fileSize);
 
+    OffsetType allocateAndWritePages(boost::asio::const_buffer buf);
+
+    void overwritePages(OffsetType offset, boost::asio::const_buffer buf);
+
+    void readPages(OffsetType offset, boost::asio::mutable_buffer buf);
+
+    void freePages(OffsetType offset);
+
     static void throwIfOffsetIsInvalid(OffsetType offset, const char* funcName);
 
     OffsetType m_firstFreePage = 0;
     FileSystem::UniqueFilePtr m_file;
+    bool m_extents = true;
+    std::array<OffsetType, k_sizeClassesCount> m_freeExtents{};
+    OffsetType m_fileSize = 0;
+    OffsetType m_reservedFileSize = 0;
 
 };
 
 const FileMagic BigFileStorageImpl::s_magic{{'B', 'G', 'F', 'S'}};
-const FileVersion BigFileStorageImpl::s_currentVersion{0x0001, 0x0000};
+const FileVersion BigFileStorageImpl::s_currentVersion{0x0001, 0x0001};
+const FileVersion BigFileStorageImpl::s_pagesVersion{0x0001, 0x0000};
 
 void BigFileStorageImpl::openImpl()
 {
-    auto fileSize = m_file->seekEnd();
+    auto fileSize = m_file->getSize();
     if(fileSize == 0 || (fileSize % k_pageFullSize) != 0)
     {
         throw std::runtime_error(
@@ -60,8 +137,7 @@ void BigFileStorageImpl::openImpl()
     }
     std::array<uint8_t, k_headerSize> headerData{};
     auto buf = boost::asio::buffer(headerData);
-    m_file->seek(0);
-    m_file->read(buf);
+    m_file->readAt(0, buf);
     InputBinBuffer in(buf);
 
     FileMagic magic;
@@ -75,18 +151,32 @@ void BigFileStorageImpl::openImpl()
 
     FileVersion version{0, 0};
     version.deserialize(in);
-    if(version != s_currentVersion)
+    //all previous minor versions are supported
+    if(version.major != s_currentVersion.major || version.minor > s_currentVersion.minor)
     {
         throw std::runtime_error(
             fmt::format("BigFileStorageImpl: invalid version of file {}. Expected {}, but found {}",
-                        m_file->getFilename().string(), s_magic, magic));
+                        m_file->getFilename().string(), s_currentVersion, version));
     }
     m_firstFreePage = in.readU64();
+    m_extents = version.minor > s_pagesVersion.minor;
+    m_fileSize = m_reservedFileSize = fileSize;
+    if(m_extents)
+    {
+        std::array<uint8_t, k_sizeClassesCount * sizeof(OffsetType)> freeListsData{};
+        auto freeListsBuf = boost::asio::buffer(freeListsData);
+        m_file->readAt(k_freeListsOffset, freeListsBuf);
+        InputBinBuffer freeListsIn(freeListsBuf);
+        for(auto& head : m_freeExtents)
+        {
+            head = freeListsIn.readU64();
+        }
+    }
 }
 
 void BigFileStorageImpl::createImpl()
 {
-    auto fileSize = m_file->seekEnd();
+    auto fileSize = m_file->getSize();
     if(fileSize != 0)
     {
         throw std::runtime_error(fmt::format("File {} must be empty for SmallToMediumFileStorage:{}",
@@ -98,7 +188,327 @@ void BigFileStorageImpl::createImpl()
     s_magic.serialize(out);
     s_currentVersion.serialize(out);
     out.writeU64(0);
-    m_file->write(buf);
+    //heads of free lists of extents are zero
+    m_file->writeAt(0, buf);
+    m_fileSize = m_reservedFileSize = k_pageFullSize;
+}
+
+BigFileStorageImpl::OffsetType BigFileStorageImpl::allocateAndWrite(boost::asio::const_buffer buf)
+{
+    if(m_extents)
+    {
+        return allocateAndWriteExtents(buf);
+    }
+    return allocateAndWritePages(buf);
+}
+
+void BigFileStorageImpl::overwrite(OffsetType offset, boost::asio::const_buffer buf)
+{
+    throwIfOffsetIsInvalid(offset, "overwrite");
+    if(m_extents)
+    {
+        overwriteExtents(offset, buf);
+        return;
+    }
+    overwritePages(offset, buf);
+}
+
+void BigFileStorageImpl::read(OffsetType offset, boost::asio::mutable_buffer buf)
+{
+    throwIfOffsetIsInvalid(offset, "read");
+    if(m_extents)
+    {
+        readExtents(offset, buf);
+        return;
+    }
+    readPages(offset, buf);
+}
+
+void BigFileStorageImpl::free(OffsetType offset)
+{
+    throwIfOffsetIsInvalid(offset, "free");
+    if(m_extents)
+    {
+        freeExtents(offset);
+        return;
+    }
+    freePages(offset);
+}
+
+BigFileStorageImpl::OffsetType BigFileStorageImpl::extentsCapacity(const ExtentsVector& extents, size_t count)
+{
+    OffsetType rv = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        rv += extents[i].size();
+    }
+    return rv - extentsHeaderSize(count);
+}
+
+std::vector<uint8_t> BigFileStorageImpl::planExtents(size_t dataSize, OffsetType existingSize, size_t existingCount)
+{
+    //header grows with number of extents, so plan is repeated until header of planned extents fits
+    size_t assumedCount = 0;
+    for(;;)
+    {
+        OffsetType required = extentsHeaderSize(std::max<size_t>(existingCount + assumedCount, 1)) + dataSize;
+        if(required <= existingSize)
+        {
+            return {};
+        }
+        auto rv = splitToSizeClasses((required - existingSize + k_pageFullSize - 1) / k_pageFullSize);
+        if(rv.size() <= assumedCount)
+        {
+            if(existingCount + rv.size() > k_maxExtents)
+            {
+                throw std::runtime_error(
+                        fmt::format("BigFileStorage: data of size {} doesn't fit into {} extents", dataSize,
+                                    k_maxExtents));
+            }
+            return rv;
+        }
+        assumedCount = rv.size();
+    }
+}
+
+std::vector<uint8_t> BigFileStorageImpl::splitToSizeClasses(OffsetType pages)
+{
+    std::vector<uint8_t> rv;
+    const uint8_t maxSizeClass = k_sizeClassesCount - 1;
+    const OffsetType maxExtentPages = static_cast<OffsetType>(1) << maxSizeClass;
+    while(pages > maxExtentPages)
+    {
+        rv.push_back(maxSizeClass);
+        pages -= maxExtentPages;
+    }
+    //round up by the lowest bit until few bits are left,
+    //result doesn't exceed the max extent, since it's a power of two
+    auto bitsCount = [](OffsetType value) {
+        size_t count = 0;
+        for(; value; value &= value - 1)
+        {
+            ++count;
+        }
+        return count;
+    };
+    while(bitsCount(pages) > k_maxPartialExtents)
+    {
+        pages += pages & (~pages + 1);
+    }
+    for(int sizeClass = maxSizeClass; sizeClass >= 0; --sizeClass)
+    {
+        if(pages & (static_cast<OffsetType>(1) << sizeClass))
+        {
+            rv.push_back(static_cast<uint8_t>(sizeClass));
+        }
+    }
+    return rv;
+}
+
+BigFileStorageImpl::OffsetType BigFileStorageImpl::allocateExtent(uint8_t sizeClass)
+{
+    if(m_freeExtents[sizeClass])
+    {
+        OffsetType rv = m_freeExtents[sizeClass];
+        readUIntAt(*m_file, rv, m_freeExtents[sizeClass]);
+        writeFreeListHead(sizeClass);
+        return rv;
+    }
+    //split the smallest bigger free extent, halves that aren't used go to free lists
+    for(size_t biggerClass = sizeClass + 1; biggerClass < k_sizeClassesCount; ++biggerClass)
+    {
+        if(!m_freeExtents[biggerClass])
+        {
+            continue;
+        }
+        OffsetType rv = allocateExtent(static_cast<uint8_t>(biggerClass));
+        for(size_t halfClass = sizeClass; halfClass < biggerClass; ++halfClass)
+        {
+            freeExtent({rv + (static_cast<OffsetType>(k_pageFullSize) << halfClass), static_cast<uint8_t>(halfClass)});
+        }
+        return rv;
+    }
+    OffsetType rv = m_reservedFileSize;
+    m_reservedFileSize += static_cast<OffsetType>(k_pageFullSize) << sizeClass;
+    return rv;
+}
+
+void BigFileStorageImpl::freeExtent(const Extent& extent)
+{
+    writeUIntAt(*m_file, extent.offset, m_freeExtents[extent.sizeClass]);
+    m_freeExtents[extent.sizeClass] = extent.offset;
+    writeFreeListHead(extent.sizeClass);
+}
+
+void BigFileStorageImpl::writeFreeListHead(uint8_t sizeClass)
+{
+    writeUIntAt(*m_file, k_freeListsOffset + sizeClass * sizeof(OffsetType), m_freeExtents[sizeClass]);
+}
+
+void BigFileStorageImpl::reserveAllocatedSpace()
+{
+    if(m_reservedFileSize != m_fileSize)
+    {
+        m_file->truncate(m_reservedFileSize);
+        m_fileSize = m_reservedFileSize;
+    }
+}
+
+BigFileStorageImpl::ExtentsVector BigFileStorageImpl::loadExtents(OffsetType offset)
+{
+    //header is shorter than one page, and the first extent is at least one page
+    std::array<uint8_t, k_pageFullSize> headerData{};
+    auto headerBuf = boost::asio::buffer(headerData);
+    m_file->readAt(offset, headerBuf);
+    InputBinBuffer in(headerBuf);
+    ExtentsVector rv;
+    rv.push_back({offset, in.readU8()});
+    size_t othersCount = in.readU8();
+    for(size_t i = 0; i < othersCount; ++i)
+    {
+        OffsetType extentOffset = in.readU64();
+        rv.push_back({extentOffset, in.readU8()});
+    }
+    return rv;
+}
+
+void BigFileStorageImpl::writeExtents(const ExtentsVector& extents, boost::asio::const_buffer buf)
+{
+    std::vector<uint8_t> header(extentsHeaderSize(extents.size()));
+    OutputBinBuffer out(boost::asio::buffer(header));
+    out.writeU8(extents.front().sizeClass);
+    out.writeU8(static_cast<uint8_t>(extents.size() - 1));
+    for(size_t i = 1; i < extents.size(); ++i)
+    {
+        out.writeU64(extents[i].offset);
+        out.writeU8(extents[i].sizeClass);
+    }
+    reserveAllocatedSpace();
+    m_file->writeAt(extents.front().offset, boost::asio::buffer(header));
+    OffsetType extentOffset = extents.front().offset + header.size();
+    OffsetType extentSize = extents.front().size() - header.size();
+    for(size_t i = 0; buf.size(); ++i)
+    {
+        if(i)
+        {
+            extentOffset = extents[i].offset;
+            extentSize = extents[i].size();
+        }
+        size_t toWrite = static_cast<size_t>(std::min<OffsetType>(extentSize, buf.size()));
+        m_file->writeAt(extentOffset, boost::asio::buffer(buf.data(), toWrite));
+        buf += toWrite;
+    }
+}
+
+BigFileStorageImpl::OffsetType BigFileStorageImpl::allocateAndWriteExtents(boost::asio::const_buffer buf)
+{
+    ExtentsVector extents;
+    for(auto sizeClass : planExtents(buf.size(), 0, 0))
+    {
+        extents.push_back({allocateExtent(sizeClass), sizeClass});
+    }
+    writeExtents(extents, buf);
+    return extents.front().offset;
+}
+
+void BigFileStorageImpl::overwriteExtents(OffsetType offset, boost::asio::const_buffer buf)
+{
+    //the first extent is kept, since value is referenced by its offset
+    auto extents = loadExtents(offset);
+    size_t usedCount = 1;
+    while(usedCount < extents.size() && extentsCapacity(extents, usedCount) < buf.size())
+    {
+        ++usedCount;
+    }
+    if(extentsCapacity(extents, usedCount) < buf.size())
+    {
+        //other extents are replaced by new ones, planned for the rest of data
+        for(size_t i = 1; i < extents.size(); ++i)
+        {
+            freeExtent(extents[i]);
+        }
+        extents.resize(1);
+        for(auto sizeClass : planExtents(buf.size(), extents.front().size(), 1))
+        {
+            extents.push_back({allocateExtent(sizeClass), sizeClass});
+        }
+    }
+    else
+    {
+        for(size_t i = usedCount; i < extents.size(); ++i)
+        {
+            freeExtent(extents[i]);
+        }
+        extents.resize(usedCount);
+    }
+    writeExtents(extents, buf);
+}
+
+void BigFileStorageImpl::readExtents(OffsetType offset, boost::asio::mutable_buffer buf)
+{
+    //most values fit into one extent with two bytes header,
+    //so header and data are read at once, with possible excess of data beyond the first extent
+    std::vector<uint8_t> firstData(static_cast<size_t>(std::min<OffsetType>(2 + buf.size(), m_fileSize - offset)));
+    m_file->readAt(offset, boost::asio::buffer(firstData));
+    InputBinBuffer in(boost::asio::buffer(firstData));
+    Extent first{offset, in.readU8()};
+    size_t othersCount = in.readU8();
+    size_t headerSize = extentsHeaderSize(othersCount + 1);
+    ExtentsVector others;
+    if(othersCount)
+    {
+        if(firstData.size() < headerSize)
+        {
+            firstData.resize(headerSize);
+            m_file->readAt(offset, boost::asio::buffer(firstData));
+            in = InputBinBuffer(boost::asio::buffer(firstData));
+            in.skip(2);
+        }
+        for(size_t i = 0; i < othersCount; ++i)
+        {
+            OffsetType extentOffset = in.readU64();
+            others.push_back({extentOffset, in.readU8()});
+        }
+    }
+    //data of the first extent that was read already
+    OffsetType firstExtentDataSize = std::min<OffsetType>(first.size() - headerSize, buf.size());
+    size_t alreadyRead = static_cast<size_t>(
+            std::min<OffsetType>(firstExtentDataSize, firstData.size() - std::min(firstData.size(), headerSize)));
+    memcpy(buf.data(), firstData.data() + headerSize, alreadyRead);
+    buf += alreadyRead;
+    //the rest is read in one batch
+    std::vector<IRandomAccessFile::ReadRequest> requests;
+    if(alreadyRead < firstExtentDataSize)
+    {
+        size_t toRead = static_cast<size_t>(firstExtentDataSize - alreadyRead);
+        requests.push_back({offset + headerSize + alreadyRead, boost::asio::buffer(buf.data(), toRead)});
+        buf += toRead;
+    }
+    for(auto& extent : others)
+    {
+        if(!buf.size())
+        {
+            break;
+        }
+        size_t toRead = static_cast<size_t>(std::min<OffsetType>(extent.size(), buf.size()));
+        requests.push_back({extent.offset, boost::asio::buffer(buf.data(), toRead)});
+        buf += toRead;
+    }
+    if(buf.size())
+    {
+        throw std::runtime_error(
+                fmt::format("BigFileStorage::read: requested {} bytes beyond extents of value at {}",
+                            buf.size(), offset));
+    }
+    m_file->readAtMany(requests);
+}
+
+void BigFileStorageImpl::freeExtents(OffsetType offset)
+{
+    for(auto& extent : loadExtents(offset))
+    {
+        freeExtent(extent);
+    }
 }
 
 BigFileStorageImpl::OffsetType BigFileStorageImpl::allocatePage(OffsetType& fileSize)
@@ -114,19 +524,20 @@ BigFileStorageImpl::OffsetType BigFileStorageImpl::allocatePage(OffsetType& file
     {
         if(!fileSize)
         {
-            fileSize = m_file->seekEnd();
+            fileSize = m_file->getSize();
         }
         else
         {
             fileSize += k_pageFullSize;
         }
         rv = fileSize;
+        m_fileSize = std::max(m_fileSize, fileSize + k_pageFullSize);
     }
 
     return rv;
 }
 
-BigFileStorageImpl::OffsetType BigFileStorageImpl::allocateAndWrite(boost::asio::const_buffer buf)
+BigFileStorageImpl::OffsetType BigFileStorageImpl::allocateAndWritePages(boost::asio::const_buffer buf)
 {
     OffsetType fileSize = 0;
     OffsetType rv = allocatePage(fileSize);
@@ -147,17 +558,14 @@ BigFileStorageImpl::OffsetType BigFileStorageImpl::allocateAndWrite(boost::asio:
         OutputBinBuffer out(boost::asio::buffer(pageData));
         out.writeU64(nextPageOffset);
         out.writeBufAndAdvance(buf, toWrite);
-        m_file->seek(currentPageOffset);
-        m_file->write(boost::asio::buffer(pageData));
+        m_file->writeAt(currentPageOffset, boost::asio::buffer(pageData));
         currentPageOffset = nextPageOffset;
     }
     return rv;
 }
 
-void BigFileStorageImpl::overwrite(BigFileStorageImpl::OffsetType offset, boost::asio::const_buffer buf)
+void BigFileStorageImpl::overwritePages(OffsetType offset, boost::asio::const_buffer buf)
 {
-    throwIfOffsetIsInvalid(offset, "overwrite");
-
     OffsetType fileSize = 0;
     OffsetType nextPageOffset = 0;
     OffsetType currentPageOffset = offset;
@@ -168,6 +576,11 @@ void BigFileStorageImpl::overwrite(BigFileStorageImpl::OffsetType offset, boost:
         {
             readUIntAt(*m_file, currentPageOffset, nextPageOffset);
         }
+        else
+        {
+            //pages beyond the old chain are allocated one by one
+            nextPageOffset = 0;
+        }
         size_t toWrite = k_pageDataSize;
         bool lastPage = buf.size() <= k_pageDataSize;
         if(lastPage)
@@ -186,40 +599,69 @@ void BigFileStorageImpl::overwrite(BigFileStorageImpl::OffsetType offset, boost:
         OutputBinBuffer out(boost::asio::buffer(pageData));
         out.writeU64(lastPage ? 0 : nextPageOffset);
         out.writeBufAndAdvance(buf, toWrite);
-        m_file->seek(currentPageOffset);
-        m_file->write(boost::asio::buffer(pageData));
+        m_file->writeAt(currentPageOffset, boost::asio::buffer(pageData));
         currentPageOffset = nextPageOffset;
     }
     if(!extraSpaceAllocated && nextPageOffset)
     {
-        free(nextPageOffset);
+        freePages(nextPageOffset);
     }
 }
 
-void BigFileStorageImpl::read(OffsetType offset, boost::asio::mutable_buffer buf)
+void BigFileStorageImpl::readPages(OffsetType offset, boost::asio::mutable_buffer buf)
 {
-    throwIfOffsetIsInvalid(offset, "read");
+    //Pages of a value are usually allocated one after another.
+    //So pages following the current one are read speculatively in one vectored read:
+    //next page pointers into nextPages and data directly into buf.
+    //If the chain leaves the run, data read beyond the break is overwritten by the next reads.
+    //min takes args as const ref. This forces
+    //static constants to have an address in C++ before 17.
+    const size_t pageDataSize = k_pageDataSize;
+    const size_t maxRunPages = k_maxRunPages;
+    std::vector<boost::endian::little_uint64_buf_t> nextPages;
+    std::vector<boost::asio::mutable_buffer> bufs;
+    size_t runPages = maxRunPages;
     OffsetType currentPageOffset = offset;
     while(buf.size())
     {
-        std::array<uint8_t, k_pageFullSize> pageData{};
-        auto pageBuf = boost::asio::buffer(pageData);
-        m_file->seek(currentPageOffset);
-        m_file->read(pageBuf);
-        InputBinBuffer in(pageBuf);
-        OffsetType nextPageOffset = in.readU64();
-        //min takes args as const ref. This forces
-        //k_pageDataSize to have an address in C++ before 17.
-        const size_t pageDataSize = k_pageDataSize;
-        size_t toRead = std::min(pageDataSize, buf.size());
-        in.readBufAndAdvance(buf, toRead);
+        OffsetType pages = std::min<OffsetType>(runPages, (buf.size() + k_pageDataSize - 1) / k_pageDataSize);
+        if(currentPageOffset < m_fileSize)
+        {
+            pages = std::min(pages, (m_fileSize - currentPageOffset) / k_pageFullSize);
+        }
+        pages = std::max<OffsetType>(pages, 1);
+        nextPages.resize(static_cast<size_t>(pages));
+        bufs.clear();
+        auto runBuf = buf;
+        for(auto& nextPage : nextPages)
+        {
+            bufs.emplace_back(&nextPage, sizeof(nextPage));
+            bufs.emplace_back(runBuf.data(), std::min(pageDataSize, runBuf.size()));
+            runBuf += bufs.back().size();
+        }
+        m_file->readAtVectored(currentPageOffset, bufs);
+        size_t chainPages = 0;
+        OffsetType nextPageOffset = 0;
+        for(auto& nextPage : nextPages)
+        {
+            ++chainPages;
+            currentPageOffset += k_pageFullSize;
+            nextPageOffset = nextPage.value();
+            if(nextPageOffset != currentPageOffset)
+            {
+                break;
+            }
+        }
+        buf += chainPages * k_pageDataSize;
         currentPageOffset = nextPageOffset;
+        //fragmented chain wastes less on speculative reads with shorter runs
+        runPages = chainPages == nextPages.size() ? std::min(runPages * 2, maxRunPages)
+                                                  : std::max<size_t>(runPages / 2, 1);
     }
 }
 
-void BigFileStorageImpl::free(OffsetType offset)
+void BigFileStorageImpl::freePages(OffsetType offset)
 {
-    throwIfOffsetIsInvalid(offset, "free");
     if(m_firstFreePage)
     {
         OffsetType lastPageOffset = offset;
@@ -65,8 +65,7 @@ inline void writeUIntAt(IRandomAccessFile& file, IRandomAccessFile::OffsetType o
 
     putUIntToBuf(outBuf, value);
 
-    file.seek(offset);
-    file.write(boost::asio::buffer(data));
+    file.writeAt(offset, boost::asio::buffer(data));
 }
 
 template<class T>
@@ -75,12 +74,27 @@ void readUIntAt(IRandomAccessFile& file, IRandomAccessFile::OffsetType offset, T
     static_assert(std::is_integral<T>::value, "readUIntAt is for integral types only");
     static_assert(sizeof(T) <= 8, "Unsupported int type size");
     std::array<uint8_t, sizeof(T)> data;
-    file.seek(offset);
     auto buf = boost::asio::buffer(data);
-    file.read(buf);
+    file.readAt(offset, buf);
     InputBinBuffer inBuf(buf);
     using namespace phkvs::details;
     getUIntFromBuf(inBuf, value);
 }
 
-}
\ No newline at end of file
+//Return size bytes of file data at offset. Data of memory mapped file is returned without copying,
+//otherwise it's read into provided storage.
+template<size_t N>
+boost::asio::const_buffer readAtOrView(IRandomAccessFile& file, IRandomAccessFile::OffsetType offset,
+                                       std::array<uint8_t, N>& storage, size_t size = N)
+{
+    auto view = file.viewAt(offset, size);
+    if(view.size() == size)
+    {
+        return view;
+    }
+    auto buf = boost::asio::buffer(storage.data(), size);
+    file.readAt(offset, buf);
+    return buf;
+}
+
+}
@@ -4,48 +4,73 @@
 #include "platform/win32/RandomAccessFileWin32.hpp"
 #else
 #include "platform/posix/RandomAccessFilePosix.hpp"
+#include "platform/posix/MappedRandomAccessFilePosix.hpp"
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define PHKVS_HAS_URING
+#include "platform/linux/UringRandomAccessFileLinux.hpp"
+#endif
+#endif
 #endif
 
 namespace phkvs {
 
-FileSystem::UniqueFilePtr FileSystem::createFileUnique(boost::filesystem::path filename)
+template<class FilePtr, class Handle>
+FilePtr FileSystem::makeFile(boost::filesystem::path& filename, Handle&& handle, AccessMode mode)
+{
+#ifndef _WIN32
+    if(mode == AccessMode::memoryMapped)
+    {
+        return FilePtr(new MappedRandomAccessFile(std::move(filename), std::move(handle)));
+    }
+#endif
+#ifdef PHKVS_HAS_URING
+    if(mode == AccessMode::uring)
+    {
+        return FilePtr(new UringRandomAccessFile(std::move(filename), std::move(handle)));
+    }
+#endif
+    return FilePtr(new RandomAccessFile(std::move(filename), std::move(handle)));
+}
+
+FileSystem::UniqueFilePtr FileSystem::createFileUnique(boost::filesystem::path filename, AccessMode mode)
 {
     auto handle = RandomAccessFile::create(filename);
     if(!handle)
     {
         return {};
     }
-    return std::make_unique<RandomAccessFile>(filename, std::move(handle));
+    return makeFile<UniqueFilePtr>(filename, std::move(handle), mode);
 }
 
-FileSystem::SharedFilePtr FileSystem::createFileShared(boost::filesystem::path filename)
+FileSystem::SharedFilePtr FileSystem::createFileShared(boost::filesystem::path filename, AccessMode mode)
 {
     auto handle = RandomAccessFile::create(filename);
     if(!handle)
     {
         return {};
     }
-    return std::make_shared<RandomAccessFile>(filename, std::move(handle));
+    return makeFile<SharedFilePtr>(filename, std::move(handle), mode);
 }
 
-FileSystem::UniqueFilePtr FileSystem::openFileUnique(boost::filesystem::path filename)
+FileSystem::UniqueFilePtr FileSystem::openFileUnique(boost::filesystem::path filename, AccessMode mode)
 {
     auto handle = RandomAccessFile::open(filename);
     if(!handle)
     {
         return {};
     }
-    return std::make_unique<RandomAccessFile>(filename, std::move(handle));
+    return makeFile<UniqueFilePtr>(filename, std::move(handle), mode);
 }
 
-FileSystem::SharedFilePtr FileSystem::openFileShared(boost::filesystem::path filename)
+FileSystem::SharedFilePtr FileSystem::openFileShared(boost::filesystem::path filename, AccessMode mode)
 {
     auto handle = RandomAccessFile::open(filename);
     if(!handle)
     {
         return {};
     }
-    return std::make_shared<RandomAccessFile>(filename, std::move(handle));
+    return makeFile<SharedFilePtr>(filename, std::move(handle), mode);
 }
 
 int FileSystem::getLastError()
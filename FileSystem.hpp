@@ -12,12 +12,25 @@ class FileSystem{
 public:
     using UniqueFilePtr = std::unique_ptr<IRandomAccessFile>;
     using SharedFilePtr = std::shared_ptr<IRandomAccessFile>;
-    static UniqueFilePtr createFileUnique(boost::filesystem::path filename);
-    static SharedFilePtr createFileShared(boost::filesystem::path filename);
-    static UniqueFilePtr openFileUnique(boost::filesystem::path  filename);
-    static SharedFilePtr openFileShared(boost::filesystem::path  filename);
+
+    enum class AccessMode{
+        regular,
+        //Memory mapped file. Falls back to regular on platforms without mmap support.
+        memoryMapped,
+        //Batched reads are submitted via io_uring. Falls back to regular on platforms without io_uring.
+        uring
+    };
+
+    static UniqueFilePtr createFileUnique(boost::filesystem::path filename, AccessMode mode = AccessMode::regular);
+    static SharedFilePtr createFileShared(boost::filesystem::path filename, AccessMode mode = AccessMode::regular);
+    static UniqueFilePtr openFileUnique(boost::filesystem::path  filename, AccessMode mode = AccessMode::regular);
+    static SharedFilePtr openFileShared(boost::filesystem::path  filename, AccessMode mode = AccessMode::regular);
 
     static int getLastError();
+
+private:
+    template<class FilePtr, class Handle>
+    static FilePtr makeFile(boost::filesystem::path& filename, Handle&& handle, AccessMode mode);
 };
 
-}
\ No newline at end of file
+}
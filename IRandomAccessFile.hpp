@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdio.h>
+#include <vector>
 #include <boost/asio/buffer.hpp>
 #include <boost/filesystem/path.hpp>
 
@@ -10,6 +11,11 @@ class IRandomAccessFile{
 public:
     using OffsetType = uint64_t;
 
+    struct ReadRequest {
+        OffsetType offset;
+        boost::asio::mutable_buffer buf;
+    };
+
     virtual void read(boost::asio::mutable_buffer buf) = 0;
     virtual void write(boost::asio::const_buffer buf) = 0;
     //Seek to specified absolute offset
@@ -17,6 +23,38 @@ public:
     //Seek to the end of the file and return file size
     virtual OffsetType seekEnd() = 0;
 
+    //Positional read/write at specified absolute offset.
+    //File position is not used and not changed, so concurrent readAt calls are safe.
+    virtual void readAt(OffsetType offset, boost::asio::mutable_buffer buf) = 0;
+    virtual void writeAt(OffsetType offset, boost::asio::const_buffer buf) = 0;
+    //Positional reads of independent requests.
+    //Implementation may submit them at once and complete in any order.
+    virtual void readAtMany(const std::vector<ReadRequest>& requests)
+    {
+        for(auto& request : requests)
+        {
+            readAt(request.offset, request.buf);
+        }
+    }
+    //Positional read of consecutive bytes starting at offset into several buffers in order.
+    virtual void readAtVectored(OffsetType offset, const std::vector<boost::asio::mutable_buffer>& bufs)
+    {
+        for(auto& buf : bufs)
+        {
+            readAt(offset, buf);
+            offset += buf.size();
+        }
+    }
+    //Return file size without changing file position
+    virtual OffsetType getSize() = 0;
+    //Return view of file data without copying, if file is memory mapped.
+    //View is valid until next write. Empty buffer is returned if file isn't mapped.
+    virtual boost::asio::const_buffer viewAt(OffsetType offset, size_t size) = 0;
+    //Flush written data to storage device
+    virtual void sync() = 0;
+    //Change file size. File position isn't changed.
+    virtual void truncate(OffsetType size) = 0;
+
     virtual const boost::filesystem::path& getFilename()const = 0;
 
     virtual ~IRandomAccessFile() = default;
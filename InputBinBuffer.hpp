@@ -55,6 +55,15 @@ public:
         buf += amount;
     }
 
+    //Return view of next amount bytes without copying
+    boost::asio::const_buffer viewAndAdvance(size_t amount)
+    {
+        checkRemainingSpaceAndThrow(amount);
+        boost::asio::const_buffer rv(m_buf.data(), amount);
+        m_buf += amount;
+        return rv;
+    }
+
     float readFloat()
     {
         static_assert(sizeof(uint32_t) == sizeof(float), "float is not 32 bit");
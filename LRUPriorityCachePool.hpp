@@ -37,6 +37,21 @@ public:
 
     LRUPriorityCachePool(const LRUPriorityCachePool&) = delete;
 
+    //Called for least recently used item before reuse.
+    //If it returns true, item is moved to the end of its list instead of reuse (CLOCK-like second chance).
+    //Predicate is expected to reset the condition it checks, otherwise items are reused in LRU order.
+    void setSecondChance(std::function<bool(V*)> secondChance)
+    {
+        m_secondChance = std::move(secondChance);
+    }
+
+    //Called before least recently used item is chosen for reuse.
+    //Returned item, if not null, is reused instead, e.g. item that is known to be useless.
+    void setReuseCandidate(std::function<V*()> reuseCandidate)
+    {
+        m_reuseCandidate = std::move(reuseCandidate);
+    }
+
     V* allocate(uint8_t prio)
     {
         if(prio >= MXP)
@@ -47,19 +62,43 @@ public:
         {
             auto& rv = m_freeItems.front();
             m_freeItems.pop_front();
+            rv.*prioPtr = prio;
             m_prioLists[prio].push_back(rv);
             return &rv;
         }
         if(m_mainPool.size() < m_maxItems)
         {
             m_mainPool.emplace_back();
+            m_mainPool.back().*prioPtr = prio;
             m_prioLists[prio].push_back(m_mainPool.back());
             return &m_mainPool.back();
         }
+        if(m_reuseCandidate)
+        {
+            if(auto rv = m_reuseCandidate())
+            {
+                m_reuseNotify(rv);
+                uint8_t oldPrio = rv->*prioPtr;
+                m_prioLists[oldPrio].erase(m_prioLists[oldPrio].iterator_to(*rv));
+                rv->*prioPtr = prio;
+                m_prioLists[prio].push_back(*rv);
+                return rv;
+            }
+        }
         for(uint8_t idx = MXP; idx-- > 0;)
         {
             if(!m_prioLists[idx].empty())
             {
+                if(m_secondChance)
+                {
+                    size_t count = m_prioLists[idx].size();
+                    while(count-- > 0 && m_secondChance(&m_prioLists[idx].front()))
+                    {
+                        auto& item = m_prioLists[idx].front();
+                        m_prioLists[idx].pop_front();
+                        m_prioLists[idx].push_back(item);
+                    }
+                }
                 auto& rv = m_prioLists[idx].front();
                 m_reuseNotify(&rv);
                 m_prioLists[idx].pop_front();
@@ -92,6 +131,8 @@ private:
     std::array<PoolList, MXP> m_prioLists;
     size_t m_maxItems;
     std::function<void(V*)> m_reuseNotify;
+    std::function<bool(V*)> m_secondChance;
+    std::function<V*()> m_reuseCandidate;
     PoolList m_freeItems;
     std::deque<V> m_mainPool;
 };
@@ -1,17 +1,22 @@
 #include "PHKVStorage.hpp"
 
 #include <mutex>
+#include <shared_mutex>
 #include <condition_variable>
+#include <deque>
 #include <map>
 #include <stdexcept>
 #include <atomic>
+#include <thread>
 #include <stdint.h>
 
 #include <fmt/format.h>
 #include <boost/intrusive/rbtree.hpp>
+#include <boost/intrusive/set.hpp>
 #include <boost/next_prior.hpp>
 #include <boost/mpl/vector.hpp>
 #include <boost/mpl/contains.hpp>
+#include <boost/functional/hash.hpp>
 
 #include "StorageVolume.hpp"
 #include "StringViewFormatter.hpp"
@@ -70,25 +75,40 @@ public:
     ~PHKVStorageImpl() override;
 
     VolumeId createAndMountVolume(const boost::filesystem::path& volumePath, boost::string_view volumeName,
-                                  boost::string_view mountPointPath) override;
+                                  boost::string_view mountPointPath, boost::optional<Durability> durability) override;
 
     VolumeId mountVolume(const boost::filesystem::path& volumePath, boost::string_view volumeName,
-                         boost::string_view mountPointPath) override;
+                         boost::string_view mountPointPath, boost::optional<Durability> durability) override;
 
     void unmountVolume(VolumeId volumeId) override;
 
     std::vector<VolumeInfo> getMountVolumesInfo() const override;
 
+    void compactVolume(VolumeId volumeId) override;
+
     void store(boost::string_view keyPath, const ValueType& value, TimePointOpt expTime) override;
 
     boost::optional<ValueType> lookup(boost::string_view keyPath) override;
 
+    std::vector<boost::optional<ValueType>> lookupMany(const std::vector<boost::string_view>& keyPaths) override;
+
     void eraseKey(boost::string_view keyPath) override;
 
     void eraseDirRecursive(boost::string_view dirPath) override;
 
+    void write(const WriteBatch& batch) override;
+
+    void storeAsync(boost::string_view keyPath, const ValueType& value, TimePointOpt expTime,
+                    CompletionHandler handler) override;
+
+    void lookupAsync(boost::string_view keyPath, LookupHandler handler) override;
+
+    void eraseAsync(boost::string_view keyPath, CompletionHandler handler) override;
+
     boost::optional<std::vector<DirEntry>> getDirEntries(boost::string_view dirPath) override;
 
+    DirCursor::UniquePtr scanDir(boost::string_view dirPath, const ScanOptions& options) override;
+
     static boost::filesystem::path
     makeMainFileFullPath(const boost::filesystem::path& volumePath, const std::string& volumeName)
     {
@@ -113,6 +133,33 @@ public:
         return rv;
     }
 
+    static boost::filesystem::path
+    makeWalFileFullPath(const boost::filesystem::path& volumePath, const std::string& volumeName)
+    {
+        auto rv = volumePath / volumeName;
+        rv += ".phkvswal";
+        return rv;
+    }
+
+    //Files written by compaction, they replace volume files once marker file is created
+    static boost::filesystem::path makeCompactionFilePath(const boost::filesystem::path& volumeFilePath)
+    {
+        auto rv = volumeFilePath;
+        rv += ".compact";
+        return rv;
+    }
+
+    static boost::filesystem::path
+    makeCompactionMarkerFullPath(const boost::filesystem::path& volumePath, const std::string& volumeName)
+    {
+        auto rv = volumePath / volumeName;
+        rv += ".phkvscompact";
+        return rv;
+    }
+
+    //Replace volume files with compacted ones if marker file exists, otherwise remove leftovers of compaction
+    static void finishCompaction(const boost::filesystem::path& volumePath, const std::string& volumeName);
+
 private:
 
     struct MountPointInfo {
@@ -122,16 +169,35 @@ private:
         VolumeId volumeId;
         uint32_t lastOpSeqAssigned = 0;
         uint32_t lastOpSeqExecuted = 0;
+        //last op seq that was processed by background flusher
+        uint32_t lastOpSeqSynced = 0;
+        //error of last failed background sync and range of ops it affected
+        std::exception_ptr syncError;
+        uint32_t syncErrorFirstOpSeq = 0;
+        uint32_t syncErrorLastOpSeq = 0;
+        Durability durability = Durability::none;
         bool abortOp = false;
         StorageVolume::UniquePtr volume;
+        //orders modifying operations, guards op seqs and sync state
         std::mutex volumeMtx;
         std::condition_variable volumeCondVar;
+        //held exclusively by modifying operations and flush, shared by lookups
+        std::shared_timed_mutex volumeRwMtx;
+        //held for the whole compaction of volume
+        std::mutex compactionMtx;
+        //completions of executed async ops that wait for background sync, guarded by volumeMtx
+        std::deque<std::pair<uint32_t, CompletionHandler>> syncWaiters;
+        //async ops in order of op seqs, guarded by m_asyncMtx
+        std::deque<std::function<void()>> asyncOps;
+        //volume is queued for or being processed by async thread
+        bool asyncScheduled = false;
     };
 
     static FileSystem::UniqueFilePtr
-    createAndCheckFile(boost::string_view callFunc, const boost::filesystem::path& path)
+    createAndCheckFile(boost::string_view callFunc, const boost::filesystem::path& path,
+                       FileSystem::AccessMode mode = FileSystem::AccessMode::regular)
     {
-        auto rv = FileSystem::createFileUnique(path);
+        auto rv = FileSystem::createFileUnique(path, mode);
         if(!rv)
         {
             int error = FileSystem::getLastError();
@@ -142,9 +208,10 @@ private:
     }
 
     static FileSystem::UniqueFilePtr
-    openAndCheckFile(boost::string_view callFunc, const boost::filesystem::path& path)
+    openAndCheckFile(boost::string_view callFunc, const boost::filesystem::path& path,
+                     FileSystem::AccessMode mode = FileSystem::AccessMode::regular)
     {
-        auto rv = FileSystem::openFileUnique(path);
+        auto rv = FileSystem::openFileUnique(path, mode);
         if(!rv)
         {
             int error = FileSystem::getLastError();
@@ -156,8 +223,119 @@ private:
 
     using LockGuard = std::lock_guard<std::mutex>;
     using UniqueLock = std::unique_lock<std::mutex>;
+    using ShardMutex = std::shared_timed_mutex;
+    using ShardLockGuard = std::lock_guard<ShardMutex>;
+    using ShardUniqueLock = std::unique_lock<ShardMutex>;
+    using ShardSharedLock = std::shared_lock<ShardMutex>;
+    using VolumeWriteLock = std::lock_guard<std::shared_timed_mutex>;
+    using VolumeReadLock = std::shared_lock<std::shared_timed_mutex>;
     using MountPointInfoPtr = std::shared_ptr<MountPointInfo>;
 
+    FileSystem::AccessMode mainFileAccessMode() const
+    {
+        return m_options.memoryMappedMainFile ? FileSystem::AccessMode::memoryMapped :
+               FileSystem::AccessMode::regular;
+    }
+
+    FileSystem::AccessMode dataFileAccessMode() const
+    {
+        return m_options.uringDataFiles ? FileSystem::AccessMode::uring : FileSystem::AccessMode::regular;
+    }
+
+    StorageVolume::Options volumeOptions() const
+    {
+        StorageVolume::Options rv;
+        rv.nodeCacheSize = m_options.volumeNodeCacheSize;
+        rv.dirStructure = m_options.volumeDirStructure;
+        rv.nodePageSize = m_options.volumeNodePageSize;
+        rv.nodeEntriesCount = m_options.volumeNodeEntriesCount;
+        rv.hashIndex = m_options.volumeHashIndex;
+        rv.dirFilters = m_options.volumeDirFilters;
+        return rv;
+    }
+
+    WriteAheadLog::Options walOptions() const
+    {
+        WriteAheadLog::Options rv;
+        rv.groupCommitSize = m_options.syncGroupSize;
+        return rv;
+    }
+
+    Options m_options;
+
+    std::mutex m_flusherMtx;
+    std::condition_variable m_flusherCondVar;
+    std::thread m_flusherThread;
+    bool m_stopFlusher{false};
+
+    void startFlusher();
+
+    void stopFlusher();
+
+    void flusherThreadProc();
+
+    void syncVolumes();
+
+    std::mutex m_reaperMtx;
+    std::condition_variable m_reaperCondVar;
+    std::thread m_reaperThread;
+    bool m_stopReaper{false};
+
+    void startReaper();
+
+    void stopReaper();
+
+    void reaperThreadProc();
+
+    void reapVolumes();
+
+    std::mutex m_asyncMtx;
+    std::condition_variable m_asyncCondVar;
+    //volumes with async ops, each volume is processed by one thread at a time
+    std::deque<MountPointInfoPtr> m_asyncReady;
+    std::vector<std::thread> m_asyncThreads;
+    bool m_stopAsync{false};
+
+    void startAsyncThreads();
+
+    void stopAsyncThreads();
+
+    void asyncThreadProc();
+
+    void postAsyncTask(const MountPointInfoPtr& mount, std::function<void()> task);
+
+    //Acquire op seq and queue op, so async ops of volume are queued in op seq order
+    void postVolumeOp(const MountPointInfoPtr& mount, std::function<void()> op, CompletionHandler handler);
+
+    void executeAsyncOp(MountPointInfo& mnt, uint32_t opSeq, const std::function<void()>& op,
+                        const CompletionHandler& handler);
+
+    using Completions = std::vector<std::pair<CompletionHandler, std::exception_ptr>>;
+
+    //Take completions of synced async ops, called with volumeMtx locked
+    static Completions takeSyncedWaiters(MountPointInfo& mnt);
+
+    static void complete(const Completions& completions);
+
+    std::mutex m_compactorMtx;
+    std::condition_variable m_compactorCondVar;
+    std::thread m_compactorThread;
+    bool m_stopCompactor{false};
+
+    void startCompactor();
+
+    void stopCompactor();
+
+    void compactorThreadProc();
+
+    void compactVolumes();
+
+    //Returns false if compaction was stopped before files were replaced
+    bool compactMount(MountPointInfo& mnt, std::chrono::milliseconds stepPause);
+
+    StorageVolume::UniquePtr openVolume(const boost::filesystem::path& volumePath, const std::string& volumeName,
+                                        Durability durability);
+
     struct MountTree {
         std::map<VolumeId, MountPointInfoPtr> mountPoints;
         using SubdirsMap = std::map<std::string, MountTree, StringStringViewComparator>;
@@ -175,14 +353,26 @@ private:
     void erasePathFromMountTree(MountTree& subtree, const std::vector<boost::string_view>& mountPath,
                                 size_t idx, VolumeId volumeId);
 
-    std::tuple<MountPointInfoPtr, uint32_t> getVolumeByIdAndAllocateOpSeq(VolumeId volumeId);
+    MountPointInfoPtr getVolumeById(VolumeId volumeId);
 
     uint32_t acquireVolumeOpSeq(MountPointInfo& mount);
 
-    void executeOpInSequence(MountPointInfo& mnt, uint32_t opSeq, const std::function<void()>& op);
+    //waitSync = false doesn't wait for background sync of perBatch durability
+    void executeOpInSequence(MountPointInfo& mnt, uint32_t opSeq, const std::function<void()>& op,
+                             bool waitSync = true);
 
     static void waitForPendingOps(MountPointInfo& mnt, UniqueLock& lock);
 
+    //Lock shards with given indices in order of index
+    std::vector<ShardUniqueLock> lockCacheShards(std::vector<size_t> indices);
+
+    std::vector<ShardUniqueLock> lockAllCacheShards();
+
+    static void waitForSync(MountPointInfo& mnt, uint32_t opSeq, UniqueLock& lock);
+
+    //Error of background sync that affected synced op
+    static std::exception_ptr getSyncError(MountPointInfo& mnt, uint32_t opSeq);
+
     static boost::string_view getLocalMountPath(const boost::string_view& fullPath, MountPointInfo& mnt);
 
     struct VolumeNotFound {
@@ -194,10 +384,39 @@ private:
     void getVolumesFromTree(const MountTree& tree, const std::vector<boost::string_view>& path, size_t idx,
                             std::vector<MountPointInfoPtr>& volumes);
 
+    //Merges batches of dir entries read from volumes mounted along dir path with mount points below dir.
+    //Entry of higher priority volume hides entries with the same name of other volumes.
+    class DirCursorImpl : public DirCursor {
+    public:
+        //volumes must be ordered by priority
+        DirCursorImpl(const std::string& dirPath, const ScanOptions& options,
+                      const std::vector<MountPointInfoPtr>& volumes, const std::vector<std::string>& mountSubdirs);
+
+        boost::optional<ScanEntry> next() override;
+
+    private:
+        struct EntriesSource {
+            //null for mount points, they are known in advance
+            MountPointInfoPtr mount;
+            std::string localPath;
+            //scan of volume is continued from this name
+            std::string from;
+            std::deque<ScanEntry> entries;
+            bool complete = false;
+        };
+
+        void fetch(EntriesSource& source);
+
+        ScanOptions m_options;
+        std::vector<EntriesSource> m_sources;
+    };
+
     std::atomic_uint_fast32_t m_cacheSeq{0};
 
     struct CacheTreeNode;
 
+    struct CacheShard;
+
     struct CacheNodeComparator {
         bool operator()(const CacheTreeNode& l, const CacheTreeNode& r) const;
 
@@ -212,6 +431,8 @@ private:
 
         boost::intrusive::list_member_hook<> poolListNode;
         uint8_t poolPrio;
+        //set by readers that hold shared lock instead of touching node in pool
+        std::atomic<bool> referenced{false};
 
         using CacheTree = boost::intrusive::rbtree<CacheTreeNode, boost::intrusive::compare<CacheNodeComparator>>;
 
@@ -231,6 +452,10 @@ private:
         std::string name;
         boost::variant<ValueType, Dir> value;
         CacheTreeNode* parent;
+        //cached value isn't returned after expiration time of key
+        TimePointOpt expTime;
+        //keys with expiration time are linked into set of their shard
+        boost::intrusive::set_member_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> expirationHook;
 
         Dir& getDir()
         {
@@ -266,8 +491,8 @@ private:
         node.parent = parent;
     }
 
-    void initValueCacheNode(CacheTreeNode& node, std::string&& name, const ValueType& value, VolumeId volumeId,
-                            CacheTreeNode* parent)
+    void initValueCacheNode(CacheShard& shard, CacheTreeNode& node, std::string&& name, const ValueType& value,
+                            TimePointOpt expTime, VolumeId volumeId, CacheTreeNode* parent)
     {
         node.type = EntryType::key;
         node.cacheSeq = m_cacheSeq.load(std::memory_order_acquire);
@@ -275,6 +500,25 @@ private:
         node.value = value;
         node.volumeId = volumeId;
         node.parent = parent;
+        setCacheNodeExpiration(shard, node, expTime);
+    }
+
+    static void setCacheNodeExpiration(CacheShard& shard, CacheTreeNode& node, TimePointOpt expTime)
+    {
+        if(node.expirationHook.is_linked())
+        {
+            node.expirationHook.unlink();
+        }
+        node.expTime = expTime;
+        if(expTime)
+        {
+            shard.expiringNodes.insert(node);
+        }
+    }
+
+    static bool isExpiredCacheNode(const CacheTreeNode& node, TimePoint now = std::chrono::system_clock::now())
+    {
+        return node.expTime && *node.expTime < now;
     }
 
     bool isActualCacheDirNode(CacheTreeNode& node)
@@ -290,10 +534,59 @@ private:
                node.cacheSeq == m_cacheSeq.load(std::memory_order_acquire);
     }
 
-    mutable std::mutex m_cacheMtx;
+    static constexpr size_t k_minCacheShardPoolSize = 16;
+
     using CachePoolType = LRUPriorityCachePool<CacheTreeNode, &CacheTreeNode::poolListNode, &CacheTreeNode::poolPrio, 2>;
-    CachePoolType m_cachePool;
-    CacheTreeNode* m_cacheRoot;
+
+    struct CacheNodeExpirationComparator {
+        bool operator()(const CacheTreeNode& l, const CacheTreeNode& r) const
+        {
+            return *l.expTime < *r.expTime;
+        }
+    };
+
+    using ExpiringNodesSet = boost::intrusive::multiset<CacheTreeNode,
+            boost::intrusive::member_hook<CacheTreeNode, decltype(CacheTreeNode::expirationHook),
+                    &CacheTreeNode::expirationHook>,
+            boost::intrusive::compare<CacheNodeExpirationComparator>,
+            boost::intrusive::constant_time_size<false>>;
+
+    //Part of cache tree with its own lock and pool.
+    //Entries of root dir are distributed among shards by name,
+    //everything below root level entry belongs to the same shard as the entry.
+    struct CacheShard {
+        CacheShard(size_t poolSize, std::function<void(CacheTreeNode*)> reuseNotify) :
+                pool(poolSize, std::move(reuseNotify))
+        {
+        }
+
+        //lookups that hit cache take shared lock, everything else takes exclusive lock
+        ShardMutex mtx;
+        //key nodes ordered by expiration time, expired ones are reused before least recently used.
+        //Nodes unlink themselves on destruction, so set must outlive pool.
+        ExpiringNodesSet expiringNodes;
+        CachePoolType pool;
+        //root dir contains only entries of this shard
+        CacheTreeNode* root;
+    };
+
+    std::vector<std::unique_ptr<CacheShard>> m_cacheShards;
+
+    size_t getCacheShardIndex(boost::string_view rootEntryName) const
+    {
+        return boost::hash_range(rootEntryName.begin(), rootEntryName.end()) % m_cacheShards.size();
+    }
+
+    CacheShard& getCacheShard(const PathAndKey& pathKey)
+    {
+        return *m_cacheShards[getCacheShardIndex(pathKey.path.empty() ? pathKey.key : pathKey.path.front())];
+    }
+
+    //path must not be empty, root dir is spread among all shards
+    CacheShard& getCacheShard(const std::vector<boost::string_view>& path)
+    {
+        return *m_cacheShards[getCacheShardIndex(path.front())];
+    }
 
     enum class FindResult {
         found,
@@ -302,15 +595,53 @@ private:
         inconsistentCache
     };
 
-    std::tuple<FindResult, CacheTreeNode*> findInCache(const std::vector<boost::string_view>& path);
+    //Methods below must be called with mutex of shard locked.
+
+    //With shared lock only reference bits of nodes are modified
+    std::tuple<FindResult, CacheTreeNode*> findInCache(CacheShard& shard, const std::vector<boost::string_view>& path,
+                                                       bool exclusive = true);
+
+    static void touchCacheNode(CacheShard& shard, CacheTreeNode* node, bool exclusive)
+    {
+        if(exclusive)
+        {
+            shard.pool.touch(node);
+        }
+        else
+        {
+            node->referenced.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    void storeInCache(CacheShard& shard, const PathAndKey& pathKey, const ValueType& value, TimePointOpt expTime,
+                      VolumeId volumeId, uint8_t prio);
+
+    void fillCache(CacheShard& shard, const std::vector<boost::string_view>& path);
+
+    void eraseFromCache(CacheShard& shard, CacheTreeNode* dirNode, CacheTreeNode* childNode);
+
+    void cacheNodeReuseNotify(CacheShard& shard, CacheTreeNode* node);
+
+    //Return content of dir node to pool
+    static void freeCacheDirContent(CacheShard& shard, CacheTreeNode* dirNode);
 
-    void storeInCache(const PathAndKey& pathKey, const ValueType& value, VolumeId volumeId, uint8_t prio);
+    //Return true if result of lookup is known from cache, value is set if key was found.
+    //With shared lock cache isn't filled, so false is also returned if cache is inconsistent.
+    bool lookupInCache(CacheShard& shard, const PathAndKey& pathKey, boost::optional<ValueType>& value,
+                       bool exclusive = true);
 
-    void fillCache(const std::vector<boost::string_view>& path);
+    //Lookup in cache with shared lock first and with exclusive lock if cache must be filled
+    bool lookupInCache(const PathAndKey& pathKey, boost::optional<ValueType>& value);
 
-    void eraseFromCache(CacheTreeNode* dirNode, CacheTreeNode* childNode);
+    //Cache part of modifying operations.
+    //Return volume to execute operation on or nullptr if there is nothing to do.
+    MountPointInfoPtr prepareStore(CacheShard& shard, boost::string_view keyPath, const PathAndKey& pathKey,
+                                   const ValueType& value, TimePointOpt expTime);
 
-    void cacheNodeReuseNotify(CacheTreeNode* node);
+    MountPointInfoPtr prepareEraseKey(CacheShard& shard, const PathAndKey& pathKey);
+
+    MountPointInfoPtr prepareExpire(CacheShard& shard, boost::string_view keyPath, const PathAndKey& pathKey,
+                                    TimePointOpt expTime);
 };
 
 bool PHKVStorageImpl::CacheNodeComparator::operator()(const PHKVStorageImpl::CacheTreeNode& l,
@@ -350,174 +681,834 @@ void PHKVStorageImpl::CacheTreeNode::Dir::erase(CacheTreeNode* node)
 }
 
 PHKVStorageImpl::PHKVStorageImpl(const Options& options) :
-        m_cachePool(options.cachePoolSize,
-                std::bind(&PHKVStorageImpl::cacheNodeReuseNotify, this, std::placeholders::_1))
+        m_options(options)
 {
-    m_cacheRoot = m_cachePool.allocate(0);
-    initDirCacheNode(*m_cacheRoot, "", nullptr);
+    size_t shardsCount = std::max<size_t>(options.cacheShardsCount, 1);
+    size_t shardPoolSize = std::max<size_t>(options.cachePoolSize / shardsCount, k_minCacheShardPoolSize);
+    for(size_t i = 0; i < shardsCount; ++i)
+    {
+        m_cacheShards.push_back(std::make_unique<CacheShard>(shardPoolSize, [this, i](CacheTreeNode* node) {
+            cacheNodeReuseNotify(*m_cacheShards[i], node);
+        }));
+        auto& shard = *m_cacheShards.back();
+        shard.pool.setSecondChance([&shard](CacheTreeNode* node) {
+            bool referenced = node->referenced.exchange(false, std::memory_order_relaxed);
+            //root and dirs with cached content are reused only if nothing else can be
+            return referenced || node == shard.root ||
+                   (node->type == EntryType::dir && !node->getDir().content.empty());
+        });
+        shard.pool.setReuseCandidate([&shard]() -> CacheTreeNode* {
+            if(shard.expiringNodes.empty() || !isExpiredCacheNode(*shard.expiringNodes.begin()))
+            {
+                return nullptr;
+            }
+            return &*shard.expiringNodes.begin();
+        });
+        shard.root = shard.pool.allocate(0);
+        initDirCacheNode(*shard.root, "", nullptr);
+    }
 }
 
 PHKVStorageImpl::~PHKVStorageImpl()
 {
-    m_cacheRoot->clear();
+    //reaper, compactor and async ops may wait for flusher to sync their ops
+    stopCompactor();
+    stopReaper();
+    stopAsyncThreads();
+    stopFlusher();
+    //complete async ops that wait for sync
+    syncVolumes();
+    for(auto& shard:m_cacheShards)
+    {
+        shard->root->clear();
+    }
 }
 
-void PHKVStorageImpl::cacheNodeReuseNotify(CacheTreeNode* node)
+void PHKVStorageImpl::startFlusher()
 {
-    if(node->parent)
+    LockGuard guard(m_flusherMtx);
+    if(m_flusherThread.joinable())
     {
-        node->parent->getDir().content.erase(node->parent->getDir().content.iterator_to(*node));
-        node->parent->getDir().cacheComplete = false;
+        return;
     }
+    m_flusherThread = std::thread(&PHKVStorageImpl::flusherThreadProc, this);
 }
 
-PHKVStorageImpl::VolumeId
-PHKVStorageImpl::createAndMountVolume(const boost::filesystem::path& volumePath, boost::string_view volumeName,
-                                      boost::string_view mountPointPath)
+void PHKVStorageImpl::stopFlusher()
 {
-    if(!boost::filesystem::exists(volumePath))
     {
-        boost::filesystem::create_directories(volumePath);
+        LockGuard guard(m_flusherMtx);
+        m_stopFlusher = true;
     }
-    std::string volumeNameStr = toString(volumeName);
-    auto mainPath = makeMainFileFullPath(volumePath, volumeNameStr);
-    auto stmPath = makeStmFileFullPath(volumePath, volumeNameStr);
-    auto bigPath = makeBigFileFullPath(volumePath, volumeNameStr);
-    for(auto pathPtr:{&mainPath, &stmPath, &bigPath})
+    m_flusherCondVar.notify_all();
+    if(m_flusherThread.joinable())
     {
-        if(boost::filesystem::exists(*pathPtr))
-        {
-            throw std::runtime_error(fmt::format("PHKVStorage::createAndMountVolume: File {} already exists.",
-                    pathPtr->string()));
-        }
+        m_flusherThread.join();
     }
-    auto volume = StorageVolume::create(createAndCheckFile("PHKVStorage::createAndMountVolume", mainPath),
-            SmallToMediumFileStorage::create(createAndCheckFile("PHKVStorage::createAndMountVolume", stmPath)),
-            BigFileStorage::create(createAndCheckFile("PHKVStorage::createAndMountVolume", bigPath)));
-
-    auto infoPtr = std::make_shared<MountPointInfo>();
-
-    auto& info = *infoPtr;
-    info.volume = std::move(volume);
-    info.volumeName = volumeNameStr;
-    info.volumePath = volumePath;
-    return registerMount(mountPointPath, infoPtr);
 }
 
-PHKVStorageImpl::VolumeId
-PHKVStorageImpl::mountVolume(const boost::filesystem::path& volumePath, boost::string_view volumeName,
-                             boost::string_view mountPointPath)
+void PHKVStorageImpl::flusherThreadProc()
 {
-    std::string volumeNameStr = toString(volumeName);
-    auto mainPath = makeMainFileFullPath(volumePath, volumeNameStr);
-    auto stmPath = makeStmFileFullPath(volumePath, volumeNameStr);
-    auto bigPath = makeBigFileFullPath(volumePath, volumeNameStr);
-    for(auto pathPtr:{&mainPath, &stmPath, &bigPath})
+    UniqueLock lock(m_flusherMtx);
+    while(!m_stopFlusher)
     {
-        if(!boost::filesystem::exists(*pathPtr))
+        m_flusherCondVar.wait_for(lock, m_options.syncInterval);
+        if(m_stopFlusher)
         {
-            throw std::runtime_error(fmt::format("PHKVStorage::createAndMountVolume: File {} doesn't exists.",
-                    pathPtr->string()));
+            break;
         }
+        lock.unlock();
+        syncVolumes();
+        lock.lock();
     }
-    auto volume = StorageVolume::open(openAndCheckFile("PHKVStorage::mountVolume", mainPath),
-            SmallToMediumFileStorage::open(openAndCheckFile("PHKVStorage::mountVolume", stmPath)),
-            BigFileStorage::open(openAndCheckFile("PHKVStorage::mountVolume", bigPath)));
-
-    auto infoPtr = std::make_shared<MountPointInfo>();
-    auto& info = *infoPtr;
-    info.volume = std::move(volume);
-    info.volumeName = volumeNameStr;
-    info.volumePath = volumePath;
-
-    return registerMount(mountPointPath, infoPtr);
 }
 
-void PHKVStorageImpl::unmountVolume(VolumeId volumeId)
+void PHKVStorageImpl::syncVolumes()
 {
-    LockGuard guard(m_mountInfoMtx);
-    auto it = m_volumeIdMap.find(volumeId);
-    if(it == m_volumeIdMap.end())
+    std::vector<MountPointInfoPtr> mounts;
     {
-        return;
+        LockGuard guard(m_mountInfoMtx);
+        for(auto& p : m_volumeIdMap)
+        {
+            auto durability = p.second->durability;
+            if(durability == Durability::periodic || durability == Durability::perBatch)
+            {
+                mounts.push_back(p.second);
+            }
+        }
+    }
+    for(auto& mnt : mounts)
+    {
+        Completions completions;
+        {
+            //all ops executed so far get into the same sync
+            LockGuard guard(mnt->volumeMtx);
+            if(mnt->lastOpSeqSynced == mnt->lastOpSeqExecuted)
+            {
+                continue;
+            }
+            try
+            {
+                VolumeWriteLock writeLock(mnt->volumeRwMtx);
+                mnt->volume->flush();
+            }
+            catch(...)
+            {
+                mnt->syncError = std::current_exception();
+                mnt->syncErrorFirstOpSeq = mnt->lastOpSeqSynced + 1;
+                mnt->syncErrorLastOpSeq = mnt->lastOpSeqExecuted;
+            }
+            mnt->lastOpSeqSynced = mnt->lastOpSeqExecuted;
+            mnt->volumeCondVar.notify_all();
+            completions = takeSyncedWaiters(*mnt);
+        }
+        complete(completions);
     }
-
-    auto& info = *it->second;
-    auto path = splitDirPath(info.mountPoint);
-    erasePathFromMountTree(m_mountTree, path, 0, info.volumeId);
-    m_volumeIdMap.erase(it);
-
-    m_cacheSeq.fetch_add(1, std::memory_order_release);
 }
 
-void
-PHKVStorageImpl::erasePathFromMountTree(MountTree& subtree, const std::vector<boost::string_view>& mountPath,
-                                        size_t idx, VolumeId volumeId)
+void PHKVStorageImpl::startAsyncThreads()
 {
-    if(idx == mountPath.size())
+    LockGuard guard(m_asyncMtx);
+    if(!m_asyncThreads.empty())
     {
-        subtree.mountPoints.erase(volumeId);
         return;
     }
-    auto it = subtree.subdirs.find(mountPath[idx]);
-    if(it == subtree.subdirs.end())
+    size_t threadsCount = std::max<size_t>(m_options.asyncThreadsCount, 1);
+    for(size_t i = 0; i < threadsCount; ++i)
     {
-        //report error?
-        return;
+        m_asyncThreads.emplace_back(&PHKVStorageImpl::asyncThreadProc, this);
     }
-    auto& nextTree = it->second;
-    erasePathFromMountTree(it->second, mountPath, idx + 1, volumeId);
-    --subtree.childMounts;
-    if(nextTree.mountPoints.empty() && nextTree.subdirs.empty())
+}
+
+void PHKVStorageImpl::stopAsyncThreads()
+{
     {
-        subtree.subdirs.erase(it);
+        LockGuard guard(m_asyncMtx);
+        m_stopAsync = true;
+    }
+    m_asyncCondVar.notify_all();
+    for(auto& thread : m_asyncThreads)
+    {
+        thread.join();
     }
 }
 
-std::vector<PHKVStorageImpl::VolumeInfo> PHKVStorageImpl::getMountVolumesInfo() const
+void PHKVStorageImpl::asyncThreadProc()
 {
-    LockGuard guard(m_mountInfoMtx);
-    std::vector<VolumeInfo> rv;
-    for(auto& p : m_volumeIdMap)
+    UniqueLock lock(m_asyncMtx);
+    for(;;)
     {
-        const MountPointInfo& mp = *p.second;
-        rv.push_back({mp.volumePath, mp.volumeName, mp.mountPoint, mp.volumeId});
+        while(m_asyncReady.empty() && !m_stopAsync)
+        {
+            m_asyncCondVar.wait(lock);
+        }
+        //queued ops are executed before stop
+        if(m_asyncReady.empty())
+        {
+            break;
+        }
+        auto mount = std::move(m_asyncReady.front());
+        m_asyncReady.pop_front();
+        {
+            auto task = std::move(mount->asyncOps.front());
+            mount->asyncOps.pop_front();
+            lock.unlock();
+            task();
+        }
+        lock.lock();
+        if(mount->asyncOps.empty())
+        {
+            mount->asyncScheduled = false;
+        }
+        else
+        {
+            //other volumes go first
+            m_asyncReady.push_back(std::move(mount));
+        }
     }
-    return rv;
 }
 
-std::tuple<PHKVStorageImpl::MountPointInfoPtr, uint32_t>
-PHKVStorageImpl::getVolumeByIdAndAllocateOpSeq(VolumeId volumeId)
+void PHKVStorageImpl::postAsyncTask(const MountPointInfoPtr& mount, std::function<void()> task)
 {
-    LockGuard guard(m_mountInfoMtx);
-    auto it = m_volumeIdMap.find(volumeId);
-    if(it == m_volumeIdMap.end())
     {
-        return {};
+        LockGuard guard(m_asyncMtx);
+        mount->asyncOps.push_back(std::move(task));
+        if(mount->asyncScheduled)
+        {
+            return;
+        }
+        mount->asyncScheduled = true;
+        m_asyncReady.push_back(mount);
     }
-    auto rv = it->second;
-    return {rv, ++rv->lastOpSeqAssigned};
+    m_asyncCondVar.notify_one();
 }
 
-uint32_t PHKVStorageImpl::acquireVolumeOpSeq(MountPointInfo& mount)
+void PHKVStorageImpl::postVolumeOp(const MountPointInfoPtr& mount, std::function<void()> op,
+                                   CompletionHandler handler)
 {
     LockGuard guard(m_mountInfoMtx);
-    return ++mount.lastOpSeqAssigned;
+    auto opSeq = ++mount->lastOpSeqAssigned;
+    postAsyncTask(mount, [this, mount, opSeq, op = std::move(op), handler = std::move(handler)]() {
+        executeAsyncOp(*mount, opSeq, op, handler);
+    });
 }
 
-PHKVStorageImpl::VolumeId
-PHKVStorageImpl::registerMount(const boost::string_view& mountPointPath, MountPointInfoPtr infoPtr)
+void PHKVStorageImpl::executeAsyncOp(MountPointInfo& mnt, uint32_t opSeq, const std::function<void()>& op,
+                                     const CompletionHandler& handler)
 {
-    LockGuard guard(m_mountInfoMtx);
-    m_cacheSeq.fetch_add(1, std::memory_order_release);
-    auto rv = ++m_lastVolumeId;
-
-    auto& info = *infoPtr;
-    info.volumeId = rv;
-    info.mountPoint = toString(mountPointPath);
-    m_volumeIdMap.emplace(info.volumeId, infoPtr);
-
-    auto path = splitDirPath(mountPointPath);
+    Completions completions;
+    try
+    {
+        executeOpInSequence(mnt, opSeq, op, false);
+        if(mnt.durability == Durability::perBatch)
+        {
+            //completed by flusher, so async thread isn't blocked until sync
+            LockGuard guard(mnt.volumeMtx);
+            if(!mnt.volume->hasUnsyncedChanges())
+            {
+                mnt.lastOpSeqSynced = mnt.lastOpSeqExecuted;
+                mnt.volumeCondVar.notify_all();
+            }
+            mnt.syncWaiters.emplace_back(opSeq, handler);
+            completions = takeSyncedWaiters(mnt);
+        }
+        else
+        {
+            completions.emplace_back(handler, std::exception_ptr());
+        }
+    }
+    catch(...)
+    {
+        completions.emplace_back(handler, std::current_exception());
+    }
+    complete(completions);
+}
+
+PHKVStorageImpl::Completions PHKVStorageImpl::takeSyncedWaiters(MountPointInfo& mnt)
+{
+    Completions rv;
+    while(!mnt.syncWaiters.empty() &&
+          static_cast<int32_t>(mnt.lastOpSeqSynced - mnt.syncWaiters.front().first) >= 0)
+    {
+        auto& waiter = mnt.syncWaiters.front();
+        rv.emplace_back(std::move(waiter.second), getSyncError(mnt, waiter.first));
+        mnt.syncWaiters.pop_front();
+    }
+    return rv;
+}
+
+void PHKVStorageImpl::complete(const Completions& completions)
+{
+    for(auto& completion : completions)
+    {
+        try
+        {
+            completion.first(completion.second);
+        }
+        catch(...)
+        {
+        }
+    }
+}
+
+void PHKVStorageImpl::startReaper()
+{
+    LockGuard guard(m_reaperMtx);
+    if(m_reaperThread.joinable())
+    {
+        return;
+    }
+    m_reaperThread = std::thread(&PHKVStorageImpl::reaperThreadProc, this);
+}
+
+void PHKVStorageImpl::stopReaper()
+{
+    {
+        LockGuard guard(m_reaperMtx);
+        m_stopReaper = true;
+    }
+    m_reaperCondVar.notify_all();
+    if(m_reaperThread.joinable())
+    {
+        m_reaperThread.join();
+    }
+}
+
+void PHKVStorageImpl::reaperThreadProc()
+{
+    UniqueLock lock(m_reaperMtx);
+    while(!m_stopReaper)
+    {
+        m_reaperCondVar.wait_for(lock, m_options.reaperInterval);
+        if(m_stopReaper)
+        {
+            break;
+        }
+        lock.unlock();
+        reapVolumes();
+        lock.lock();
+    }
+}
+
+void PHKVStorageImpl::reapVolumes()
+{
+    std::vector<MountPointInfoPtr> mounts;
+    {
+        LockGuard guard(m_mountInfoMtx);
+        for(auto& p : m_volumeIdMap)
+        {
+            mounts.push_back(p.second);
+        }
+    }
+    for(auto& mnt : mounts)
+    {
+        {
+            //check without taking a place in op sequence
+            VolumeReadLock readLock(mnt->volumeRwMtx);
+            if(!mnt->volume->hasExpiredKeys())
+            {
+                continue;
+            }
+        }
+        //reaped keys are already expired, so cache isn't invalidated
+        auto opSeq = acquireVolumeOpSeq(*mnt);
+        try
+        {
+            executeOpInSequence(*mnt, opSeq, [this, &mnt]() {
+                mnt->volume->reapExpired(m_options.reaperBatchSize);
+            });
+        }
+        catch(...)
+        {
+            //keys stay in expiration index and are retried on next pass
+        }
+    }
+}
+
+void PHKVStorageImpl::startCompactor()
+{
+    LockGuard guard(m_compactorMtx);
+    if(m_compactorThread.joinable())
+    {
+        return;
+    }
+    m_compactorThread = std::thread(&PHKVStorageImpl::compactorThreadProc, this);
+}
+
+void PHKVStorageImpl::stopCompactor()
+{
+    {
+        LockGuard guard(m_compactorMtx);
+        m_stopCompactor = true;
+    }
+    m_compactorCondVar.notify_all();
+    if(m_compactorThread.joinable())
+    {
+        m_compactorThread.join();
+    }
+}
+
+void PHKVStorageImpl::compactorThreadProc()
+{
+    UniqueLock lock(m_compactorMtx);
+    while(!m_stopCompactor)
+    {
+        m_compactorCondVar.wait_for(lock, m_options.compactionInterval);
+        if(m_stopCompactor)
+        {
+            break;
+        }
+        lock.unlock();
+        compactVolumes();
+        lock.lock();
+    }
+}
+
+void PHKVStorageImpl::compactVolumes()
+{
+    std::vector<MountPointInfoPtr> mounts;
+    {
+        LockGuard guard(m_mountInfoMtx);
+        for(auto& p : m_volumeIdMap)
+        {
+            mounts.push_back(p.second);
+        }
+    }
+    for(auto& mnt : mounts)
+    {
+        try
+        {
+            uint64_t freedSize;
+            {
+                VolumeReadLock readLock(mnt->volumeRwMtx);
+                freedSize = mnt->volume->getFreedSize();
+            }
+            uint64_t filesSize = 0;
+            for(auto& path : {makeMainFileFullPath(mnt->volumePath, mnt->volumeName),
+                              makeStmFileFullPath(mnt->volumePath, mnt->volumeName),
+                              makeBigFileFullPath(mnt->volumePath, mnt->volumeName)})
+            {
+                filesSize += boost::filesystem::file_size(path);
+            }
+            if(freedSize == 0 || freedSize < filesSize * m_options.compactionFreedRatio)
+            {
+                continue;
+            }
+            if(!compactMount(*mnt, m_options.compactionStepPause))
+            {
+                break;
+            }
+        }
+        catch(...)
+        {
+            //volume is left as is and checked again on next pass
+        }
+    }
+}
+
+void PHKVStorageImpl::compactVolume(VolumeId volumeId)
+{
+    auto mnt = getVolumeById(volumeId);
+    if(!mnt)
+    {
+        throw std::runtime_error(fmt::format("PHKVStorage::compactVolume: Volume {} isn't mounted.", volumeId));
+    }
+    compactMount(*mnt, std::chrono::milliseconds(0));
+}
+
+bool PHKVStorageImpl::compactMount(MountPointInfo& mnt, std::chrono::milliseconds stepPause)
+{
+    LockGuard compactionGuard(mnt.compactionMtx);
+    std::vector<boost::filesystem::path> volumeFiles{makeMainFileFullPath(mnt.volumePath, mnt.volumeName),
+                                                     makeStmFileFullPath(mnt.volumePath, mnt.volumeName),
+                                                     makeBigFileFullPath(mnt.volumePath, mnt.volumeName)};
+    std::vector<boost::filesystem::path> compactionFiles;
+    for(auto& path : volumeFiles)
+    {
+        compactionFiles.push_back(makeCompactionFilePath(path));
+        boost::filesystem::remove(compactionFiles.back());
+    }
+    auto targetOptions = volumeOptions();
+    targetOptions.dirStructure = mnt.volume->getDirStructure();
+    targetOptions.nodePageSize = mnt.volume->getNodePageSize();
+    targetOptions.nodeEntriesCount = mnt.volume->getNodeEntriesCount();
+    targetOptions.hashIndex = mnt.volume->hasHashIndex();
+    targetOptions.dirFilters = mnt.volume->hasDirFilters();
+    auto target = StorageVolume::create(
+            createAndCheckFile("compactVolume", compactionFiles[0], mainFileAccessMode()),
+            SmallToMediumFileStorage::create(
+                    createAndCheckFile("compactVolume", compactionFiles[1], dataFileAccessMode())),
+            BigFileStorage::create(createAndCheckFile("compactVolume", compactionFiles[2], dataFileAccessMode())),
+            targetOptions);
+    auto removeCompactionFiles = [&target, &compactionFiles]() {
+        target.reset();
+        for(auto& path : compactionFiles)
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove(path, ec);
+        }
+    };
+    //keys are already in volume, so cache isn't affected by copying
+    auto runStep = [this, &mnt](const std::function<void()>& step) {
+        auto opSeq = acquireVolumeOpSeq(mnt);
+        executeOpInSequence(mnt, opSeq, step);
+    };
+    bool replacing = false;
+    try
+    {
+        bool copying = true;
+        runStep([&mnt, &target, &copying, this]() {
+            mnt.volume->startCopy(*target);
+            copying = mnt.volume->copyStep(m_options.compactionStepSize);
+        });
+        while(copying)
+        {
+            if(stepPause.count() != 0)
+            {
+                UniqueLock lock(m_compactorMtx);
+                if(m_compactorCondVar.wait_for(lock, stepPause, [this]() { return m_stopCompactor; }))
+                {
+                    runStep([&mnt]() { mnt.volume->stopCopy(); });
+                    removeCompactionFiles();
+                    return false;
+                }
+            }
+            runStep([&mnt, &copying, this]() {
+                copying = mnt.volume->copyStep(m_options.compactionStepSize);
+            });
+        }
+        runStep([&]() {
+            mnt.volume->stopCopy();
+            target.reset();
+            for(auto& path : compactionFiles)
+            {
+                openAndCheckFile("compactVolume", path)->sync();
+            }
+            //from now on compacted files replace volume files, even if process is interrupted
+            replacing = true;
+            createAndCheckFile("compactVolume", makeCompactionMarkerFullPath(mnt.volumePath, mnt.volumeName))
+                    ->sync();
+            mnt.volume.reset();
+            finishCompaction(mnt.volumePath, mnt.volumeName);
+            mnt.volume = openVolume(mnt.volumePath, mnt.volumeName, mnt.durability);
+        });
+    }
+    catch(...)
+    {
+        if(!replacing)
+        {
+            try
+            {
+                runStep([&mnt]() { mnt.volume->stopCopy(); });
+            }
+            catch(...)
+            {
+            }
+            removeCompactionFiles();
+        }
+        throw;
+    }
+    return true;
+}
+
+void PHKVStorageImpl::finishCompaction(const boost::filesystem::path& volumePath, const std::string& volumeName)
+{
+    auto markerPath = makeCompactionMarkerFullPath(volumePath, volumeName);
+    bool replace = boost::filesystem::exists(markerPath);
+    for(auto& path : {makeMainFileFullPath(volumePath, volumeName),
+                      makeStmFileFullPath(volumePath, volumeName),
+                      makeBigFileFullPath(volumePath, volumeName)})
+    {
+        auto compactionPath = makeCompactionFilePath(path);
+        if(!boost::filesystem::exists(compactionPath))
+        {
+            //already replaced
+            continue;
+        }
+        if(replace)
+        {
+            boost::filesystem::rename(compactionPath, path);
+        }
+        else
+        {
+            boost::filesystem::remove(compactionPath);
+        }
+    }
+    if(replace)
+    {
+        //log has changes of replaced files only
+        boost::filesystem::remove(makeWalFileFullPath(volumePath, volumeName));
+        boost::filesystem::remove(markerPath);
+    }
+}
+
+void PHKVStorageImpl::cacheNodeReuseNotify(CacheShard& shard, CacheTreeNode* node)
+{
+    //content of reused dir would be left with dangling parent
+    if(node->type == EntryType::dir)
+    {
+        freeCacheDirContent(shard, node);
+    }
+    if(node->parent)
+    {
+        auto& dir = node->parent->getDir();
+        dir.content.erase(dir.content.iterator_to(*node));
+        //expired key is hidden by volume as well, unless it hides key of other volume
+        if(!isExpiredCacheNode(*node) || dir.overlapingDir)
+        {
+            dir.cacheComplete = false;
+        }
+    }
+    if(node->expirationHook.is_linked())
+    {
+        node->expirationHook.unlink();
+    }
+}
+
+void PHKVStorageImpl::freeCacheDirContent(CacheShard& shard, CacheTreeNode* dirNode)
+{
+    auto& dir = dirNode->getDir();
+    while(!dir.content.empty())
+    {
+        auto& node = *dir.content.begin();
+        dir.content.erase(dir.content.begin());
+        if(node.type == EntryType::dir)
+        {
+            freeCacheDirContent(shard, &node);
+        }
+        setCacheNodeExpiration(shard, node, {});
+        node.parent = nullptr;
+        shard.pool.free(&node);
+    }
+    dir.cacheComplete = false;
+}
+
+PHKVStorageImpl::VolumeId
+PHKVStorageImpl::createAndMountVolume(const boost::filesystem::path& volumePath, boost::string_view volumeName,
+                                      boost::string_view mountPointPath, boost::optional<Durability> durability)
+{
+    auto volumeDurability = durability.value_or(m_options.durability);
+    if(!boost::filesystem::exists(volumePath))
+    {
+        boost::filesystem::create_directories(volumePath);
+    }
+    std::string volumeNameStr = toString(volumeName);
+    auto mainPath = makeMainFileFullPath(volumePath, volumeNameStr);
+    auto stmPath = makeStmFileFullPath(volumePath, volumeNameStr);
+    auto bigPath = makeBigFileFullPath(volumePath, volumeNameStr);
+    auto walPath = makeWalFileFullPath(volumePath, volumeNameStr);
+    for(auto pathPtr:{&mainPath, &stmPath, &bigPath, &walPath})
+    {
+        if(boost::filesystem::exists(*pathPtr))
+        {
+            throw std::runtime_error(fmt::format("PHKVStorage::createAndMountVolume: File {} already exists.",
+                    pathPtr->string()));
+        }
+    }
+    auto mainFile = createAndCheckFile("PHKVStorage::createAndMountVolume", mainPath, mainFileAccessMode());
+    auto stmFile = createAndCheckFile("PHKVStorage::createAndMountVolume", stmPath, dataFileAccessMode());
+    auto bigFile = createAndCheckFile("PHKVStorage::createAndMountVolume", bigPath, dataFileAccessMode());
+    StorageVolume::UniquePtr volume;
+    if(volumeDurability != Durability::none)
+    {
+        std::vector<FileSystem::UniqueFilePtr> dataFiles;
+        dataFiles.push_back(std::move(mainFile));
+        dataFiles.push_back(std::move(stmFile));
+        dataFiles.push_back(std::move(bigFile));
+        auto log = WriteAheadLog::create(createAndCheckFile("PHKVStorage::createAndMountVolume", walPath),
+                std::move(dataFiles), walOptions());
+        volume = StorageVolume::create(std::move(log), volumeOptions());
+    }
+    else
+    {
+        volume = StorageVolume::create(std::move(mainFile), SmallToMediumFileStorage::create(std::move(stmFile)),
+                BigFileStorage::create(std::move(bigFile)), volumeOptions());
+    }
+
+    auto infoPtr = std::make_shared<MountPointInfo>();
+
+    auto& info = *infoPtr;
+    info.volume = std::move(volume);
+    info.volumeName = volumeNameStr;
+    info.volumePath = volumePath;
+    info.durability = volumeDurability;
+    if(volumeDurability == Durability::periodic || volumeDurability == Durability::perBatch)
+    {
+        startFlusher();
+    }
+    if(m_options.reaperInterval.count() != 0)
+    {
+        startReaper();
+    }
+    if(m_options.compactionInterval.count() != 0)
+    {
+        startCompactor();
+    }
+    return registerMount(mountPointPath, infoPtr);
+}
+
+StorageVolume::UniquePtr PHKVStorageImpl::openVolume(const boost::filesystem::path& volumePath,
+                                                     const std::string& volumeName, Durability durability)
+{
+    auto mainPath = makeMainFileFullPath(volumePath, volumeName);
+    auto stmPath = makeStmFileFullPath(volumePath, volumeName);
+    auto bigPath = makeBigFileFullPath(volumePath, volumeName);
+    for(auto pathPtr:{&mainPath, &stmPath, &bigPath})
+    {
+        if(!boost::filesystem::exists(*pathPtr))
+        {
+            throw std::runtime_error(fmt::format("PHKVStorage::createAndMountVolume: File {} doesn't exists.",
+                    pathPtr->string()));
+        }
+    }
+    auto walPath = makeWalFileFullPath(volumePath, volumeName);
+    bool walExists = boost::filesystem::exists(walPath);
+    auto mainFile = openAndCheckFile("PHKVStorage::mountVolume", mainPath, mainFileAccessMode());
+    auto stmFile = openAndCheckFile("PHKVStorage::mountVolume", stmPath, dataFileAccessMode());
+    auto bigFile = openAndCheckFile("PHKVStorage::mountVolume", bigPath, dataFileAccessMode());
+    StorageVolume::UniquePtr volume;
+    if(durability != Durability::none)
+    {
+        std::vector<FileSystem::UniqueFilePtr> dataFiles;
+        dataFiles.push_back(std::move(mainFile));
+        dataFiles.push_back(std::move(stmFile));
+        dataFiles.push_back(std::move(bigFile));
+        auto log = walExists ?
+                   WriteAheadLog::open(openAndCheckFile("PHKVStorage::mountVolume", walPath),
+                           std::move(dataFiles), walOptions()) :
+                   WriteAheadLog::create(createAndCheckFile("PHKVStorage::mountVolume", walPath),
+                           std::move(dataFiles), walOptions());
+        volume = StorageVolume::open(std::move(log), volumeOptions());
+    }
+    else
+    {
+        if(walExists)
+        {
+            //volume was used with log, apply what is left in it and continue without log
+            WriteAheadLog::replay(*openAndCheckFile("PHKVStorage::mountVolume", walPath),
+                    {mainFile.get(), stmFile.get(), bigFile.get()});
+            boost::filesystem::remove(walPath);
+        }
+        volume = StorageVolume::open(std::move(mainFile), SmallToMediumFileStorage::open(std::move(stmFile)),
+                BigFileStorage::open(std::move(bigFile)), volumeOptions());
+    }
+    return volume;
+}
+
+PHKVStorageImpl::VolumeId
+PHKVStorageImpl::mountVolume(const boost::filesystem::path& volumePath, boost::string_view volumeName,
+                             boost::string_view mountPointPath, boost::optional<Durability> durability)
+{
+    auto volumeDurability = durability.value_or(m_options.durability);
+    std::string volumeNameStr = toString(volumeName);
+    finishCompaction(volumePath, volumeNameStr);
+    auto volume = openVolume(volumePath, volumeNameStr, volumeDurability);
+
+    auto infoPtr = std::make_shared<MountPointInfo>();
+    auto& info = *infoPtr;
+    info.volume = std::move(volume);
+    info.volumeName = volumeNameStr;
+    info.volumePath = volumePath;
+    info.durability = volumeDurability;
+    if(volumeDurability == Durability::periodic || volumeDurability == Durability::perBatch)
+    {
+        startFlusher();
+    }
+    if(m_options.reaperInterval.count() != 0)
+    {
+        startReaper();
+    }
+    if(m_options.compactionInterval.count() != 0)
+    {
+        startCompactor();
+    }
+
+    return registerMount(mountPointPath, infoPtr);
+}
+
+void PHKVStorageImpl::unmountVolume(VolumeId volumeId)
+{
+    LockGuard guard(m_mountInfoMtx);
+    auto it = m_volumeIdMap.find(volumeId);
+    if(it == m_volumeIdMap.end())
+    {
+        return;
+    }
+
+    auto& info = *it->second;
+    auto path = splitDirPath(info.mountPoint);
+    erasePathFromMountTree(m_mountTree, path, 0, info.volumeId);
+    m_volumeIdMap.erase(it);
+
+    m_cacheSeq.fetch_add(1, std::memory_order_release);
+}
+
+void
+PHKVStorageImpl::erasePathFromMountTree(MountTree& subtree, const std::vector<boost::string_view>& mountPath,
+                                        size_t idx, VolumeId volumeId)
+{
+    if(idx == mountPath.size())
+    {
+        subtree.mountPoints.erase(volumeId);
+        return;
+    }
+    auto it = subtree.subdirs.find(mountPath[idx]);
+    if(it == subtree.subdirs.end())
+    {
+        //report error?
+        return;
+    }
+    auto& nextTree = it->second;
+    erasePathFromMountTree(it->second, mountPath, idx + 1, volumeId);
+    --subtree.childMounts;
+    if(nextTree.mountPoints.empty() && nextTree.subdirs.empty())
+    {
+        subtree.subdirs.erase(it);
+    }
+}
+
+std::vector<PHKVStorageImpl::VolumeInfo> PHKVStorageImpl::getMountVolumesInfo() const
+{
+    LockGuard guard(m_mountInfoMtx);
+    std::vector<VolumeInfo> rv;
+    for(auto& p : m_volumeIdMap)
+    {
+        const MountPointInfo& mp = *p.second;
+        rv.push_back({mp.volumePath, mp.volumeName, mp.mountPoint, mp.volumeId});
+    }
+    return rv;
+}
+
+PHKVStorageImpl::MountPointInfoPtr PHKVStorageImpl::getVolumeById(VolumeId volumeId)
+{
+    LockGuard guard(m_mountInfoMtx);
+    auto it = m_volumeIdMap.find(volumeId);
+    if(it == m_volumeIdMap.end())
+    {
+        return {};
+    }
+    return it->second;
+}
+
+uint32_t PHKVStorageImpl::acquireVolumeOpSeq(MountPointInfo& mount)
+{
+    LockGuard guard(m_mountInfoMtx);
+    return ++mount.lastOpSeqAssigned;
+}
+
+PHKVStorageImpl::VolumeId
+PHKVStorageImpl::registerMount(const boost::string_view& mountPointPath, MountPointInfoPtr infoPtr)
+{
+    LockGuard guard(m_mountInfoMtx);
+    m_cacheSeq.fetch_add(1, std::memory_order_release);
+    auto rv = ++m_lastVolumeId;
+
+    auto& info = *infoPtr;
+    info.volumeId = rv;
+    info.mountPoint = toString(mountPointPath);
+    m_volumeIdMap.emplace(info.volumeId, infoPtr);
+
+    auto path = splitDirPath(mountPointPath);
 
     MountTree* node = &m_mountTree;
     for(auto& item: path)
@@ -535,7 +1526,8 @@ PHKVStorageImpl::registerMount(const boost::string_view& mountPointPath, MountPo
     return rv;
 }
 
-void PHKVStorageImpl::executeOpInSequence(MountPointInfo& mnt, uint32_t opSeq, const std::function<void()>& op)
+void PHKVStorageImpl::executeOpInSequence(MountPointInfo& mnt, uint32_t opSeq, const std::function<void()>& op,
+                                          bool waitSync)
 {
     UniqueLock lock(mnt.volumeMtx);
     while(opSeq - mnt.lastOpSeqExecuted != 1 && !mnt.abortOp)
@@ -548,7 +1540,12 @@ void PHKVStorageImpl::executeOpInSequence(MountPointInfo& mnt, uint32_t opSeq, c
     }
     try
     {
+        VolumeWriteLock writeLock(mnt.volumeRwMtx);
         op();
+        if(mnt.durability == Durability::perOp)
+        {
+            mnt.volume->flush();
+        }
     }
     catch(...)
     {
@@ -559,6 +1556,67 @@ void PHKVStorageImpl::executeOpInSequence(MountPointInfo& mnt, uint32_t opSeq, c
     }
     mnt.lastOpSeqExecuted = opSeq;
     mnt.volumeCondVar.notify_all();
+    if(mnt.durability == Durability::perBatch && waitSync)
+    {
+        waitForSync(mnt, opSeq, lock);
+    }
+}
+
+void PHKVStorageImpl::waitForSync(MountPointInfo& mnt, uint32_t opSeq, UniqueLock& lock)
+{
+    if(!mnt.volume->hasUnsyncedChanges())
+    {
+        //group size was exceeded and everything executed so far was synced by op itself
+        mnt.lastOpSeqSynced = opSeq;
+        mnt.volumeCondVar.notify_all();
+        return;
+    }
+    auto isSynced = [&mnt](uint32_t seq) {
+        return static_cast<int32_t>(mnt.lastOpSeqSynced - seq) >= 0;
+    };
+    while(!isSynced(opSeq) && !mnt.abortOp)
+    {
+        mnt.volumeCondVar.wait(lock);
+    }
+    if(isSynced(opSeq))
+    {
+        if(auto error = getSyncError(mnt, opSeq))
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+std::exception_ptr PHKVStorageImpl::getSyncError(MountPointInfo& mnt, uint32_t opSeq)
+{
+    if(mnt.syncError && static_cast<int32_t>(opSeq - mnt.syncErrorFirstOpSeq) >= 0 &&
+       static_cast<int32_t>(mnt.syncErrorLastOpSeq - opSeq) >= 0)
+    {
+        return mnt.syncError;
+    }
+    return {};
+}
+
+std::vector<PHKVStorageImpl::ShardUniqueLock> PHKVStorageImpl::lockCacheShards(std::vector<size_t> indices)
+{
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    std::vector<ShardUniqueLock> rv;
+    for(auto idx:indices)
+    {
+        rv.emplace_back(m_cacheShards[idx]->mtx);
+    }
+    return rv;
+}
+
+std::vector<PHKVStorageImpl::ShardUniqueLock> PHKVStorageImpl::lockAllCacheShards()
+{
+    std::vector<ShardUniqueLock> rv;
+    for(auto& shard:m_cacheShards)
+    {
+        rv.emplace_back(shard->mtx);
+    }
+    return rv;
 }
 
 void PHKVStorageImpl::waitForPendingOps(MountPointInfo& mnt, UniqueLock& lock)
@@ -611,11 +1669,91 @@ void PHKVStorageImpl::getVolumesFromTree(const MountTree& tree, const std::vecto
     }
 }
 
+PHKVStorageImpl::DirCursorImpl::DirCursorImpl(const std::string& dirPath, const ScanOptions& options,
+                                              const std::vector<MountPointInfoPtr>& volumes,
+                                              const std::vector<std::string>& mountSubdirs) :
+        m_options(options)
+{
+    for(auto& mnt : volumes)
+    {
+        EntriesSource source;
+        source.mount = mnt;
+        source.localPath = toString(getLocalMountPath(dirPath, *mnt));
+        source.from = options.from;
+        m_sources.push_back(std::move(source));
+    }
+    EntriesSource mountPoints;
+    mountPoints.complete = true;
+    for(auto& name : mountSubdirs)
+    {
+        if(name >= options.from && isPrefixOf(options.prefix, name))
+        {
+            mountPoints.entries.push_back({EntryType::dir, name, {}});
+        }
+    }
+    m_sources.push_back(std::move(mountPoints));
+}
+
+void PHKVStorageImpl::DirCursorImpl::fetch(EntriesSource& source)
+{
+    ScanOptions options = m_options;
+    options.from = source.from;
+    boost::optional<std::vector<ScanEntry>> batch;
+    {
+        VolumeReadLock readLock(source.mount->volumeRwMtx);
+        batch = source.mount->volume->scanDir(source.localPath, options);
+    }
+    if(!batch || batch->size() < options.batchSize)
+    {
+        source.complete = true;
+    }
+    if(batch && !batch->empty())
+    {
+        //the smallest name greater than name of the last entry
+        source.from = batch->back().name;
+        source.from += '\0';
+        std::move(batch->begin(), batch->end(), std::back_inserter(source.entries));
+    }
+}
+
+boost::optional<PHKVStorageImpl::ScanEntry> PHKVStorageImpl::DirCursorImpl::next()
+{
+    EntriesSource* best = nullptr;
+    for(auto& source : m_sources)
+    {
+        if(source.entries.empty() && !source.complete)
+        {
+            fetch(source);
+        }
+        if(source.entries.empty())
+        {
+            continue;
+        }
+        if(!best || source.entries.front().name < best->entries.front().name)
+        {
+            best = &source;
+        }
+    }
+    if(!best)
+    {
+        return {};
+    }
+    ScanEntry rv = std::move(best->entries.front());
+    best->entries.pop_front();
+    for(auto& source : m_sources)
+    {
+        if(!source.entries.empty() && source.entries.front().name == rv.name)
+        {
+            source.entries.pop_front();
+        }
+    }
+    return {std::move(rv)};
+}
 
 std::tuple<PHKVStorageImpl::FindResult, PHKVStorageImpl::CacheTreeNode*>
-PHKVStorageImpl::findInCache(const std::vector<boost::string_view>& path)
+PHKVStorageImpl::findInCache(CacheShard& shard, const std::vector<boost::string_view>& path, bool exclusive)
 {
-    CacheTreeNode* node = m_cacheRoot;
+    CacheTreeNode* node = shard.root;
     for(auto& item: path)
     {
         if(node->cacheSeq != m_cacheSeq.load(std::memory_order_acquire))
@@ -632,7 +1770,7 @@ PHKVStorageImpl::findInCache(const std::vector<boost::string_view>& path)
         {
             return {dir.cacheComplete ? FindResult::notFound : FindResult::inconsistentCache, nullptr};
         }
-        m_cachePool.touch(node);
+        touchCacheNode(shard, node, exclusive);
     }
     if(node->cacheSeq != m_cacheSeq.load(std::memory_order_acquire))
     {
@@ -646,9 +1784,10 @@ PHKVStorageImpl::findInCache(const std::vector<boost::string_view>& path)
 }
 
 void
-PHKVStorageImpl::storeInCache(const PathAndKey& pathKey, const ValueType& value, VolumeId volumeId, uint8_t prio)
+PHKVStorageImpl::storeInCache(CacheShard& shard, const PathAndKey& pathKey, const ValueType& value,
+                              TimePointOpt expTime, VolumeId volumeId, uint8_t prio)
 {
-    CacheTreeNode* node = m_cacheRoot;
+    CacheTreeNode* node = shard.root;
     for(auto& item:pathKey.path)
     {
         if(node->type != EntryType::dir)
@@ -656,7 +1795,7 @@ PHKVStorageImpl::storeInCache(const PathAndKey& pathKey, const ValueType& value,
             //error?
             return;
         }
-        m_cachePool.touch(node);
+        shard.pool.touch(node);
         auto nextNode = node->getDir().find(item);
         if(nextNode)
         {
@@ -664,7 +1803,7 @@ PHKVStorageImpl::storeInCache(const PathAndKey& pathKey, const ValueType& value,
         }
         else
         {
-            auto newNode = m_cachePool.allocate(prio);
+            auto newNode = shard.pool.allocate(prio);
             initDirCacheNode(*newNode, toString(item), node);
             node->getDir().content.insert_unique(*newNode);
             node = newNode;
@@ -678,24 +1817,28 @@ PHKVStorageImpl::storeInCache(const PathAndKey& pathKey, const ValueType& value,
     auto keyNode = node->getDir().find(pathKey.key);
     if(!keyNode)
     {
-        auto newNode = m_cachePool.allocate(prio);
-        initValueCacheNode(*newNode, toString(pathKey.key), value, volumeId, node);
+        auto newNode = shard.pool.allocate(prio);
+        initValueCacheNode(shard, *newNode, toString(pathKey.key), value, expTime, volumeId, node);
         node->getDir().content.insert_unique(*newNode);
     }
     else
     {
         keyNode->getValue() = value;
+        setCacheNodeExpiration(shard, *keyNode, expTime);
     }
 }
 
-void PHKVStorageImpl::fillCache(const std::vector<boost::string_view>& path)
+void PHKVStorageImpl::fillCache(CacheShard& shard, const std::vector<boost::string_view>& path)
 {
-    //LockGuard guardCache(m_cacheMtx);
     LockGuard guardMount(m_mountInfoMtx);
     MountTree* mountNode = &m_mountTree;
-    CacheTreeNode* cacheNode = m_cacheRoot;
+    CacheTreeNode* cacheNode = shard.root;
     std::string fullPath = "/";
     size_t idx = 0;
+    //root dir entries of other shards are skipped
+    auto isOtherShardEntry = [this, &shard, &idx](boost::string_view name) {
+        return idx == 0 && m_cacheShards[getCacheShardIndex(name)].get() != &shard;
+    };
     std::string tempKeyPath;
     bool mountFollowingPath = true;
     do
@@ -709,33 +1852,47 @@ void PHKVStorageImpl::fillCache(const std::vector<boost::string_view>& path)
             for(auto& p:mountNode->mountPoints)
             {
                 MountPointInfo& mountPoint = *p.second;
-                UniqueLock lock(mountPoint.volumeMtx);
-                waitForPendingOps(mountPoint, lock);
+                VolumeReadLock readLock;
+                {
+                    UniqueLock lock(mountPoint.volumeMtx);
+                    waitForPendingOps(mountPoint, lock);
+                    //later ops wait for exclusive lock until dir is read
+                    readLock = VolumeReadLock(mountPoint.volumeRwMtx);
+                }
                 auto dir = mountPoint.volume->getDirEntries(getLocalMountPath(fullPath, mountPoint));
 
                 if(dir)
                 {
                     for(auto& dirEntry:*dir)
                     {
+                        if(isOtherShardEntry(dirEntry.name))
+                        {
+                            continue;
+                        }
                         auto& cacheDir = cacheNode->getDir();
                         auto node = cacheDir.find(dirEntry.name);
                         if(!node)
                         {
-                            auto newCacheNode = m_cachePool.allocate(mountNode->childMounts > 1 ? 0 : 1);
+                            auto newCacheNode = shard.pool.allocate(mountNode->childMounts > 1 ? 0 : 1);
                             if(dirEntry.type == EntryType::key)
                             {
                                 tempKeyPath = toString(getLocalMountPath(fullPath, mountPoint));
                                 tempKeyPath += "/";
                                 tempKeyPath += dirEntry.name;
-                                auto val = mountPoint.volume->lookup(tempKeyPath);
-                                if(val)
+                                TimePointOpt expTime;
+                                auto val = mountPoint.volume->lookup(tempKeyPath, expTime);
+                                if(!val)
                                 {
-                                    initValueCacheNode(*newCacheNode,
-                                            std::move(dirEntry.name),
-                                            *val,
-                                            mountPoint.volumeId,
-                                            cacheNode);
+                                    //expired after dir entries were read
+                                    shard.pool.free(newCacheNode);
+                                    continue;
                                 }
+                                initValueCacheNode(shard, *newCacheNode,
+                                        std::move(dirEntry.name),
+                                        *val,
+                                        expTime,
+                                        mountPoint.volumeId,
+                                        cacheNode);
                             }
                             else
                             {
@@ -752,10 +1909,19 @@ void PHKVStorageImpl::fillCache(const std::vector<boost::string_view>& path)
                                     tempKeyPath = toString(getLocalMountPath(fullPath, mountPoint));
                                     tempKeyPath += "/";
                                     tempKeyPath += dirEntry.name;
-                                    auto val = mountPoint.volume->lookup(tempKeyPath);
-                                    initValueCacheNode(*node,
+                                    TimePointOpt expTime;
+                                    auto val = mountPoint.volume->lookup(tempKeyPath, expTime);
+                                    if(!val)
+                                    {
+                                        setCacheNodeExpiration(shard, *node, {});
+                                        cacheDir.erase(node);
+                                        shard.pool.free(node);
+                                        continue;
+                                    }
+                                    initValueCacheNode(shard, *node,
                                             std::move(dirEntry.name),
                                             *val,
+                                            expTime,
                                             mountPoint.volumeId,
                                             cacheNode);
                                 }
@@ -767,7 +1933,7 @@ void PHKVStorageImpl::fillCache(const std::vector<boost::string_view>& path)
                                     initDirCacheNode(*node, std::move(dirEntry.name), cacheNode);
                                 }
                             }
-                            m_cachePool.touch(node);
+                            shard.pool.touch(node);
                         }
                         if(!cacheNode->getDir().cacheComplete)
                         {
@@ -781,10 +1947,14 @@ void PHKVStorageImpl::fillCache(const std::vector<boost::string_view>& path)
             {
                 for(auto& p : mountNode->subdirs)
                 {
+                    if(isOtherShardEntry(p.first))
+                    {
+                        continue;
+                    }
                     auto node = cacheNode->getDir().find(p.first);
                     if(!node)
                     {
-                        auto newCacheNode = m_cachePool.allocate(mountNode->childMounts > 1 ? 0 : 1);
+                        auto newCacheNode = shard.pool.allocate(mountNode->childMounts > 1 ? 0 : 1);
                         initDirCacheNode(*newCacheNode, std::string(p.first), cacheNode);
                         cacheNode->getDir().content.insert_unique(*newCacheNode);
                     }
@@ -810,7 +1980,7 @@ void PHKVStorageImpl::fillCache(const std::vector<boost::string_view>& path)
                 auto node = cacheNode->getDir().find(item);
                 if(!node)
                 {
-                    auto newCacheNode = m_cachePool.allocate(mountNode->childMounts > 1 ? 0 : 1);
+                    auto newCacheNode = shard.pool.allocate(mountNode->childMounts > 1 ? 0 : 1);
                     initDirCacheNode(*newCacheNode, toString(item), cacheNode);
                     cacheNode->getDir().content.insert_unique(*newCacheNode);
                     cacheNode = newCacheNode;
@@ -827,14 +1997,105 @@ void PHKVStorageImpl::fillCache(const std::vector<boost::string_view>& path)
     } while(idx <= path.size());
 }
 
-void PHKVStorageImpl::eraseFromCache(CacheTreeNode* dirNode, CacheTreeNode* childNode)
+void PHKVStorageImpl::eraseFromCache(CacheShard& shard, CacheTreeNode* dirNode, CacheTreeNode* childNode)
 {
+    setCacheNodeExpiration(shard, *childNode, {});
     dirNode->getDir().erase(childNode);
-    m_cachePool.free(childNode);
+    shard.pool.free(childNode);
     if(dirNode->getDir().content.empty() && dirNode->parent)
     {
-        eraseFromCache(dirNode->parent, dirNode);
+        eraseFromCache(shard, dirNode->parent, dirNode);
+    }
+}
+
+PHKVStorageImpl::MountPointInfoPtr
+PHKVStorageImpl::prepareStore(CacheShard& shard, boost::string_view keyPath, const PathAndKey& pathKey,
+                              const ValueType& value, TimePointOpt expTime)
+{
+    FindResult result;
+    CacheTreeNode* node;
+    std::tie(result, node) = findInCache(shard, pathKey.path);
+    if(result == FindResult::inconsistentCache)
+    {
+        fillCache(shard, pathKey.path);
+        std::tie(result, node) = findInCache(shard, pathKey.path);
+    }
+
+    if(node)
+    {
+        auto keyNode = node->getDir().find(pathKey.key);
+        if(keyNode)
+        {
+            keyNode->value = value;
+            setCacheNodeExpiration(shard, *keyNode, expTime);
+            shard.pool.touch(keyNode);
+            auto mount = getVolumeById(keyNode->volumeId);
+            if(mount)
+            {
+                return mount;
+            }
+        }
+    }
+    auto volumes = findVolumesByPath(keyPath);
+    if(volumes.empty())
+    {
+        throw std::runtime_error(fmt::format("No volumes were mount for path {}", keyPath));
+    }
+
+    uint8_t prio = volumes.size() > 1 ? 0 : 1;
+    auto mount = volumes.front();
+    storeInCache(shard, pathKey, value, expTime, mount->volumeId, prio);
+    return mount;
+}
+
+PHKVStorageImpl::MountPointInfoPtr PHKVStorageImpl::prepareEraseKey(CacheShard& shard, const PathAndKey& pathKey)
+{
+    FindResult result;
+    CacheTreeNode* node;
+    std::tie(result, node) = findInCache(shard, pathKey.path);
+    if(result == FindResult::inconsistentCache)
+    {
+        fillCache(shard, pathKey.path);
+        std::tie(result, node) = findInCache(shard, pathKey.path);
+    }
+
+    if(result == FindResult::found)
+    {
+        auto keyNode = node->getDir().find(pathKey.key);
+        if(keyNode && isActualCacheKeyNode(*keyNode))
+        {
+            auto mount = getVolumeById(keyNode->volumeId);
+            eraseFromCache(shard, node, keyNode);
+            return mount;
+        }
+    }
+    return {};
+}
+
+PHKVStorageImpl::MountPointInfoPtr
+PHKVStorageImpl::prepareExpire(CacheShard& shard, boost::string_view keyPath, const PathAndKey& pathKey,
+                               TimePointOpt expTime)
+{
+    FindResult result;
+    CacheTreeNode* node;
+    std::tie(result, node) = findInCache(shard, pathKey.path);
+    if(result == FindResult::inconsistentCache)
+    {
+        fillCache(shard, pathKey.path);
+        std::tie(result, node) = findInCache(shard, pathKey.path);
+    }
+
+    if(result == FindResult::found)
+    {
+        auto keyNode = node->getDir().find(pathKey.key);
+        //expired key can't be revived
+        if(keyNode && isActualCacheKeyNode(*keyNode) && !isExpiredCacheNode(*keyNode))
+        {
+            setCacheNodeExpiration(shard, *keyNode, expTime);
+            return getVolumeById(keyNode->volumeId);
+        }
     }
+    return {};
 }
 
 void PHKVStorageImpl::store(boost::string_view keyPath, const ValueType& value, TimePointOpt expTime)
@@ -843,86 +2104,151 @@ void PHKVStorageImpl::store(boost::string_view keyPath, const ValueType& value,
     MountPointInfoPtr mount;
     uint32_t volumeOpSeq;
     {
-        LockGuard guard(m_cacheMtx);
-        FindResult result;
-        CacheTreeNode* node;
-        std::tie(result, node) = findInCache(pathKey.path);
-        if(result == FindResult::inconsistentCache)
+        auto& shard = getCacheShard(pathKey);
+        ShardLockGuard guard(shard.mtx);
+        mount = prepareStore(shard, keyPath, pathKey, value, expTime);
+        volumeOpSeq = acquireVolumeOpSeq(*mount);
+    }
+    executeOpInSequence(*mount, volumeOpSeq, [&mount, keyPath, &value, expTime]() {
+        mount->volume->store(getLocalMountPath(keyPath, *mount), value, expTime);
+    });
+}
+
+bool PHKVStorageImpl::lookupInCache(CacheShard& shard, const PathAndKey& pathKey, boost::optional<ValueType>& value,
+                                    bool exclusive)
+{
+    FindResult result;
+    CacheTreeNode* node;
+    std::tie(result, node) = findInCache(shard, pathKey.path, exclusive);
+    if(result == FindResult::inconsistentCache)
+    {
+        if(!exclusive)
         {
-            fillCache(pathKey.path);
-            std::tie(result, node) = findInCache(pathKey.path);
+            return false;
         }
+        fillCache(shard, pathKey.path);
+        std::tie(result, node) = findInCache(shard, pathKey.path);
+    }
 
-
-        if(node)
+    if(node)
+    {
+        auto keyNode = node->getDir().find(pathKey.key);
+        if(keyNode && isActualCacheKeyNode(*keyNode))
         {
-            auto keyNode = node->getDir().find(pathKey.key);
-            if(keyNode)
+            if(isExpiredCacheNode(*keyNode))
             {
-                keyNode->value = value;
-                m_cachePool.touch(keyNode);
-                std::tie(mount, volumeOpSeq) = getVolumeByIdAndAllocateOpSeq(keyNode->volumeId);
+                //key of other volume could be hidden by expired one
+                return !node->getDir().overlapingDir;
             }
+            touchCacheNode(shard, keyNode, exclusive);
+            value = keyNode->getValue();
+            return true;
         }
-        if(!mount)
-        {
-            auto volumes = findVolumesByPath(keyPath);
-            if(volumes.empty())
-            {
-                throw std::runtime_error(fmt::format("No volumes were mount for path {}", keyPath));
-            }
+        return node->getDir().cacheComplete;
+    }
+    return true;
+}
 
-            uint8_t prio = volumes.size() > 1 ? 0 : 1;
-            mount = volumes.front();
-            storeInCache(pathKey, value, mount->volumeId, prio);
-            volumeOpSeq = acquireVolumeOpSeq(*mount);
+bool PHKVStorageImpl::lookupInCache(const PathAndKey& pathKey, boost::optional<ValueType>& value)
+{
+    auto& shard = getCacheShard(pathKey);
+    {
+        ShardSharedLock lock(shard.mtx);
+        if(lookupInCache(shard, pathKey, value, false))
+        {
+            return true;
         }
     }
-    executeOpInSequence(*mount, volumeOpSeq, [&mount, keyPath, &value, expTime]() {
-        mount->volume->store(getLocalMountPath(keyPath, *mount), value, expTime);
-    });
+    ShardLockGuard guard(shard.mtx);
+    return lookupInCache(shard, pathKey, value);
 }
 
 boost::optional<PHKVStorageImpl::ValueType> PHKVStorageImpl::lookup(boost::string_view keyPath)
 {
     auto pathKey = splitKeyPath(keyPath);
-    bool isCacheComplete = true;
     {
-        LockGuard guard(m_cacheMtx);
-        FindResult result;
-        CacheTreeNode* node;
-        std::tie(result, node) = findInCache(pathKey.path);
-        if(result == FindResult::inconsistentCache)
+        boost::optional<ValueType> rv;
+        if(lookupInCache(pathKey, rv))
+        {
+            return rv;
+        }
+    }
+    auto volumes = findVolumesByPath(keyPath);
+    for(auto& vol:volumes)
+    {
+        VolumeReadLock readLock(vol->volumeRwMtx);
+        auto rv = vol->volume->lookup(getLocalMountPath(keyPath, *vol));
+        if(rv)
         {
-            fillCache(pathKey.path);
-            std::tie(result, node) = findInCache(pathKey.path);
+            return rv;
         }
+    }
+    return {};
+}
 
-        if(node)
+std::vector<boost::optional<PHKVStorageImpl::ValueType>>
+PHKVStorageImpl::lookupMany(const std::vector<boost::string_view>& keyPaths)
+{
+    std::vector<boost::optional<ValueType>> rv(keyPaths.size());
+    //indices of keys that must be looked up in volumes
+    std::vector<size_t> pending;
+    for(size_t i = 0; i < keyPaths.size(); ++i)
+    {
+        if(!lookupInCache(splitKeyPath(keyPaths[i]), rv[i]))
         {
-            auto keyNode = node->getDir().find(pathKey.key);
-            if(keyNode && isActualCacheKeyNode(*keyNode))
-            {
-                m_cachePool.touch(&*keyNode);
-                return keyNode->getValue();
-            }
-            isCacheComplete = node->getDir().cacheComplete;
+            pending.push_back(i);
         }
     }
-    if(!isCacheComplete)
+    std::vector<std::vector<MountPointInfoPtr>> keyVolumes(keyPaths.size());
+    for(auto idx:pending)
+    {
+        keyVolumes[idx] = findVolumesByPath(keyPaths[idx]);
+    }
+    struct VolumeLookup {
+        MountPointInfoPtr mount;
+        std::vector<size_t> indices;
+        std::vector<boost::string_view> localPaths;
+    };
+    //volumes of key are checked in order of priority, like in lookup
+    for(size_t volumeIdx = 0; !pending.empty(); ++volumeIdx)
     {
-        auto volumes = findVolumesByPath(keyPath);
-        for(auto& vol:volumes)
+        std::map<VolumeId, VolumeLookup> volumeLookups;
+        for(auto idx:pending)
+        {
+            if(volumeIdx >= keyVolumes[idx].size())
+            {
+                continue;
+            }
+            auto& mount = keyVolumes[idx][volumeIdx];
+            auto& volumeLookup = volumeLookups[mount->volumeId];
+            volumeLookup.mount = mount;
+            volumeLookup.indices.push_back(idx);
+            volumeLookup.localPaths.push_back(getLocalMountPath(keyPaths[idx], *mount));
+        }
+        pending.clear();
+        for(auto& p:volumeLookups)
         {
-            LockGuard guard(vol->volumeMtx);
-            auto rv = vol->volume->lookup(getLocalMountPath(keyPath, *vol));
-            if(rv)
+            auto& volumeLookup = p.second;
+            std::vector<boost::optional<ValueType>> values;
+            {
+                VolumeReadLock readLock(volumeLookup.mount->volumeRwMtx);
+                values = volumeLookup.mount->volume->lookupMany(volumeLookup.localPaths);
+            }
+            for(size_t i = 0; i < values.size(); ++i)
             {
-                return rv;
+                auto idx = volumeLookup.indices[i];
+                if(values[i])
+                {
+                    rv[idx] = std::move(values[i]);
+                }
+                else
+                {
+                    pending.push_back(idx);
+                }
             }
         }
     }
-    return {};
+    return rv;
 }
 
 void PHKVStorageImpl::eraseKey(boost::string_view keyPath)
@@ -931,30 +2257,18 @@ void PHKVStorageImpl::eraseKey(boost::string_view keyPath)
     MountPointInfoPtr mount;
     uint32_t volumeOpSeq;
     {
-        LockGuard guard(m_cacheMtx);
-        FindResult result;
-        CacheTreeNode* node;
-        std::tie(result, node) = findInCache(pathKey.path);
-        if(result == FindResult::inconsistentCache)
-        {
-            fillCache(pathKey.path);
-            std::tie(result, node) = findInCache(pathKey.path);
-        }
-
-        if(result == FindResult::found)
+        auto& shard = getCacheShard(pathKey);
+        ShardLockGuard guard(shard.mtx);
+        mount = prepareEraseKey(shard, pathKey);
+        if(mount)
         {
-            auto keyNode = node->getDir().find(pathKey.key);
-            if(keyNode && isActualCacheKeyNode(*keyNode))
-            {
-                std::tie(mount, volumeOpSeq) = getVolumeByIdAndAllocateOpSeq(keyNode->volumeId);
-                eraseFromCache(node, keyNode);
-            }
+            volumeOpSeq = acquireVolumeOpSeq(*mount);
         }
     }
     if(mount)
     {
         executeOpInSequence(*mount, volumeOpSeq, [&mount, keyPath]() {
-            mount->volume->eraseKey(keyPath);
+            mount->volume->eraseKey(getLocalMountPath(keyPath, *mount));
         });
     }
 }
@@ -964,22 +2278,29 @@ void PHKVStorageImpl::eraseDirRecursive(boost::string_view dirPath)
     auto path = splitDirPath(dirPath);
     std::vector<std::pair<MountPointInfoPtr, uint32_t>> mops;
     {
-        LockGuard guard(m_cacheMtx);
-        FindResult result;
-        CacheTreeNode* node;
-        std::tie(result, node) = findInCache(path);
-        if(result == FindResult::inconsistentCache)
+        std::vector<ShardUniqueLock> locks;
+        if(path.empty())
         {
-            fillCache(path);
-            std::tie(result, node) = findInCache(path);
+            //root dir itself is never erased from cache, but op seqs must be ordered with ops of all shards
+            locks = lockAllCacheShards();
         }
-
-        if(result == FindResult::found)
+        else
         {
-            if(node->parent)
+            auto& shard = getCacheShard(path);
+            locks.emplace_back(shard.mtx);
+            FindResult result;
+            CacheTreeNode* node;
+            std::tie(result, node) = findInCache(shard, path);
+            if(result == FindResult::inconsistentCache)
+            {
+                fillCache(shard, path);
+                std::tie(result, node) = findInCache(shard, path);
+            }
+
+            if(result == FindResult::found)
             {
                 node->clear();
-                eraseFromCache(node->parent, node);
+                eraseFromCache(shard, node->parent, node);
             }
         }
         auto volumes = findVolumesByPath(dirPath);
@@ -1002,30 +2323,289 @@ void PHKVStorageImpl::eraseDirRecursive(boost::string_view dirPath)
     }
 }
 
-boost::optional<std::vector<PHKVStorageImpl::DirEntry>> PHKVStorageImpl::getDirEntries(boost::string_view dirPath)
+void PHKVStorageImpl::write(const WriteBatch& batch)
 {
-    auto path = splitDirPath(dirPath);
+    struct VolumeBatch {
+        MountPointInfoPtr mount;
+        uint32_t opSeq;
+        WriteBatch batch;
+    };
+    std::vector<VolumeBatch> volumeBatches;
+    {
+        std::vector<PathAndKey> pathKeys;
+        std::vector<size_t> shardIndices;
+        for(auto& op:batch.getOps())
+        {
+            pathKeys.push_back(splitKeyPath(op.keyPath));
+            auto& pathKey = pathKeys.back();
+            shardIndices.push_back(getCacheShardIndex(pathKey.path.empty() ? pathKey.key : pathKey.path.front()));
+        }
+        //all shards of batch are locked at once, so op seqs are allocated in the same order as cache changes
+        auto locks = lockCacheShards(shardIndices);
+        std::map<VolumeId, size_t> volumeBatchIndex;
+        try
+        {
+            for(size_t opIdx = 0; opIdx < batch.getOps().size(); ++opIdx)
+            {
+                auto& op = batch.getOps()[opIdx];
+                auto& pathKey = pathKeys[opIdx];
+                auto& shard = *m_cacheShards[shardIndices[opIdx]];
+                MountPointInfoPtr mount;
+                switch(op.type)
+                {
+                    case WriteBatch::OpType::store:
+                        mount = prepareStore(shard, op.keyPath, pathKey, op.value, op.expTime);
+                        break;
+                    case WriteBatch::OpType::eraseKey:
+                        mount = prepareEraseKey(shard, pathKey);
+                        break;
+                    case WriteBatch::OpType::expire:
+                        mount = prepareExpire(shard, op.keyPath, pathKey, op.expTime);
+                        break;
+                }
+                if(!mount)
+                {
+                    continue;
+                }
+                auto it = volumeBatchIndex.find(mount->volumeId);
+                if(it == volumeBatchIndex.end())
+                {
+                    it = volumeBatchIndex.emplace(mount->volumeId, volumeBatches.size()).first;
+                    volumeBatches.push_back({mount, 0, {}});
+                }
+                auto& volumeBatch = volumeBatches[it->second].batch;
+                auto localPath = getLocalMountPath(op.keyPath, *mount);
+                switch(op.type)
+                {
+                    case WriteBatch::OpType::store:
+                        volumeBatch.store(localPath, op.value, op.expTime);
+                        break;
+                    case WriteBatch::OpType::eraseKey:
+                        volumeBatch.eraseKey(localPath);
+                        break;
+                    case WriteBatch::OpType::expire:
+                        volumeBatch.expire(localPath, op.expTime);
+                        break;
+                }
+            }
+        }
+        catch(...)
+        {
+            //cache was partially modified by ops that won't be executed
+            m_cacheSeq.fetch_add(1, std::memory_order_release);
+            throw;
+        }
+        for(auto& volumeBatch:volumeBatches)
+        {
+            volumeBatch.opSeq = acquireVolumeOpSeq(*volumeBatch.mount);
+        }
+    }
+    //all allocated op seqs must be executed even if some of volumes fail
+    std::exception_ptr error;
+    for(auto& volumeBatch:volumeBatches)
+    {
+        try
+        {
+            executeOpInSequence(*volumeBatch.mount, volumeBatch.opSeq, [&volumeBatch]() {
+                volumeBatch.mount->volume->write(volumeBatch.batch);
+            });
+        }
+        catch(...)
+        {
+            if(!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+    if(error)
+    {
+        std::rethrow_exception(error);
+    }
+}
 
-    LockGuard guard(m_cacheMtx);
-    FindResult result;
-    CacheTreeNode* node;
-    std::tie(result, node) = findInCache(path);
-    if(result == FindResult::inconsistentCache)
+void PHKVStorageImpl::storeAsync(boost::string_view keyPath, const ValueType& value, TimePointOpt expTime,
+                                 CompletionHandler handler)
+{
+    try
+    {
+        startAsyncThreads();
+        auto pathKey = splitKeyPath(keyPath);
+        auto& shard = getCacheShard(pathKey);
+        ShardLockGuard guard(shard.mtx);
+        auto mount = prepareStore(shard, keyPath, pathKey, value, expTime);
+        postVolumeOp(mount, [mount, keyPath = toString(keyPath), value, expTime]() {
+            mount->volume->store(getLocalMountPath(keyPath, *mount), value, expTime);
+        }, handler);
+    }
+    catch(...)
+    {
+        complete({{handler, std::current_exception()}});
+    }
+}
+
+void PHKVStorageImpl::lookupAsync(boost::string_view keyPath, LookupHandler handler)
+{
+    boost::optional<ValueType> rv;
+    std::exception_ptr error;
+    try
+    {
+        startAsyncThreads();
+        auto pathKey = splitKeyPath(keyPath);
+        if(!lookupInCache(pathKey, rv))
+        {
+            auto volumes = findVolumesByPath(keyPath);
+            if(!volumes.empty())
+            {
+                //executed after async ops of volume that were posted before
+                postAsyncTask(volumes.front(), [this, keyPath = toString(keyPath), handler]() {
+                    boost::optional<ValueType> rv;
+                    std::exception_ptr error;
+                    try
+                    {
+                        rv = lookup(keyPath);
+                    }
+                    catch(...)
+                    {
+                        error = std::current_exception();
+                    }
+                    complete({{[&handler, &rv](std::exception_ptr e) { handler(std::move(rv), e); },
+                               error}});
+                });
+                return;
+            }
+        }
+    }
+    catch(...)
+    {
+        error = std::current_exception();
+    }
+    complete({{[&handler, &rv](std::exception_ptr e) { handler(std::move(rv), e); }, error}});
+}
+
+void PHKVStorageImpl::eraseAsync(boost::string_view keyPath, CompletionHandler handler)
+{
+    try
+    {
+        startAsyncThreads();
+        auto pathKey = splitKeyPath(keyPath);
+        auto& shard = getCacheShard(pathKey);
+        ShardLockGuard guard(shard.mtx);
+        auto mount = prepareEraseKey(shard, pathKey);
+        if(mount)
+        {
+            postVolumeOp(mount, [mount, keyPath = toString(keyPath)]() {
+                mount->volume->eraseKey(getLocalMountPath(keyPath, *mount));
+            }, handler);
+            return;
+        }
+    }
+    catch(...)
     {
-        fillCache(path);
-        std::tie(result, node) = findInCache(path);
+        complete({{handler, std::current_exception()}});
+        return;
     }
+    complete({{handler, std::exception_ptr()}});
+}
+
+boost::optional<std::vector<PHKVStorageImpl::DirEntry>> PHKVStorageImpl::getDirEntries(boost::string_view dirPath)
+{
+    auto path = splitDirPath(dirPath);
+
     std::vector<PHKVStorageImpl::DirEntry> rv;
-    if(result == FindResult::found)
+    bool found = false;
+    auto getShardDirEntries = [this, &path, &rv, &found](CacheShard& shard) {
+        auto collect = [&rv, &found](FindResult result, CacheTreeNode* node) {
+            if(result == FindResult::found)
+            {
+                found = true;
+                auto& dir = node->getDir();
+                auto now = std::chrono::system_clock::now();
+                for(auto& childNode:dir.content)
+                {
+                    if(childNode.type == EntryType::key && isExpiredCacheNode(childNode, now))
+                    {
+                        continue;
+                    }
+                    rv.push_back({childNode.type, childNode.name});
+                }
+            }
+        };
+        FindResult result;
+        CacheTreeNode* node;
+        {
+            ShardSharedLock lock(shard.mtx);
+            std::tie(result, node) = findInCache(shard, path, false);
+            if(result != FindResult::inconsistentCache)
+            {
+                collect(result, node);
+                return;
+            }
+        }
+        ShardLockGuard guard(shard.mtx);
+        std::tie(result, node) = findInCache(shard, path);
+        if(result == FindResult::inconsistentCache)
+        {
+            fillCache(shard, path);
+            std::tie(result, node) = findInCache(shard, path);
+        }
+        collect(result, node);
+    };
+    if(!path.empty())
     {
-        auto& dir = node->getDir();
-        for(auto& childNode:dir.content)
+        getShardDirEntries(getCacheShard(path));
+        if(!found)
         {
-            rv.push_back({childNode.type, childNode.name});
+            return {};
         }
         return {rv};
     }
-    return {};
+    for(auto& shard:m_cacheShards)
+    {
+        getShardDirEntries(*shard);
+    }
+    std::sort(rv.begin(), rv.end(), [](const DirEntry& l, const DirEntry& r) {
+        return l.name < r.name;
+    });
+    return {rv};
+}
+
+PHKVStorage::DirCursor::UniquePtr PHKVStorageImpl::scanDir(boost::string_view dirPath, const ScanOptions& options)
+{
+    auto path = splitDirPath(dirPath);
+    std::string fullPath = "/";
+    for(auto& item : path)
+    {
+        fullPath.append(item.data(), item.length());
+        fullPath += '/';
+    }
+    std::vector<MountPointInfoPtr> volumes;
+    std::vector<std::string> mountSubdirs;
+    {
+        LockGuard guard(m_mountInfoMtx);
+        getVolumesFromTree(m_mountTree, path, 0, volumes);
+        const MountTree* mountNode = &m_mountTree;
+        for(auto& item : path)
+        {
+            auto it = mountNode->subdirs.find(item);
+            if(it == mountNode->subdirs.end())
+            {
+                mountNode = nullptr;
+                break;
+            }
+            mountNode = &it->second;
+        }
+        if(mountNode)
+        {
+            for(auto& p : mountNode->subdirs)
+            {
+                mountSubdirs.push_back(p.first);
+            }
+        }
+    }
+    std::sort(volumes.begin(), volumes.end(),
+              [](const MountPointInfoPtr& l, const MountPointInfoPtr& r) { return l->volumeId < r->volumeId; });
+    return std::make_unique<DirCursorImpl>(fullPath, options, volumes, mountSubdirs);
 }
 
 }
@@ -1040,6 +2620,14 @@ void PHKVStorage::deleteVolume(const boost::filesystem::path& volumePath, boost:
     boost::filesystem::remove(PHKVStorageImpl::makeMainFileFullPath(volumePath, toString(volumeName)));
     boost::filesystem::remove(PHKVStorageImpl::makeStmFileFullPath(volumePath, toString(volumeName)));
     boost::filesystem::remove(PHKVStorageImpl::makeBigFileFullPath(volumePath, toString(volumeName)));
+    boost::filesystem::remove(PHKVStorageImpl::makeWalFileFullPath(volumePath, toString(volumeName)));
+    boost::filesystem::remove(PHKVStorageImpl::makeCompactionMarkerFullPath(volumePath, toString(volumeName)));
+    for(auto& path : {PHKVStorageImpl::makeMainFileFullPath(volumePath, toString(volumeName)),
+                      PHKVStorageImpl::makeStmFileFullPath(volumePath, toString(volumeName)),
+                      PHKVStorageImpl::makeBigFileFullPath(volumePath, toString(volumeName))})
+    {
+        boost::filesystem::remove(PHKVStorageImpl::makeCompactionFilePath(path));
+    }
 }
 
 }
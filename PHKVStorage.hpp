@@ -2,6 +2,10 @@
 
 #include <string>
 #include <chrono>
+#include <functional>
+#include <future>
+#include <exception>
+#include <memory>
 
 #include <boost/variant.hpp>
 #include <boost/optional.hpp>
@@ -14,8 +18,74 @@ namespace phkvs{
 class PHKVStorage{
 public:
 
+    //How modifications of volume are made durable.
+    //All levels except none write changes through write-ahead log (.phkvswal file),
+    //so volume files are always consistent after crash.
+    enum class Durability {
+        //no fsync, changes are written by cache eviction and on unmount
+        none,
+        //changes are synced by background flusher every syncInterval
+        periodic,
+        //modifying operation returns after it was synced by background flusher,
+        //all operations that were executed within syncInterval or syncGroupSize are synced at once
+        perBatch,
+        //each modifying operation is synced before return
+        perOp
+    };
+
+    //Structure of dirs in volume
+    enum class DirStructure {
+        //randomized skip list, number of nodes read by lookup varies
+        skipList,
+        //B+tree, lookup reads one node per tree level, inner nodes are kept in node cache with priority
+        bPlusTree
+    };
+
     struct Options{
         size_t cachePoolSize{16 * 1024};
+        //Cache is split into independently locked shards by name of root dir entry,
+        //cachePoolSize is divided among shards, so every shard must fit its part of tree
+        size_t cacheShardsCount{1};
+        //Access main file of volumes via memory mapping
+        bool memoryMappedMainFile{false};
+        //Access small to medium and big data files of volumes via io_uring on Linux,
+        //so independent reads of keys and values are submitted at once
+        bool uringDataFiles{false};
+        //Max number of skip list nodes cached per volume
+        size_t volumeNodeCacheSize{1024};
+        //Default durability of mounted volumes
+        Durability durability{Durability::none};
+        //Time window of periodic and perBatch durability
+        std::chrono::milliseconds syncInterval{100};
+        //Size of unsynced changes that triggers sync before syncInterval ends
+        size_t syncGroupSize{1024 * 1024};
+        //Interval of background removal of expired keys from volumes, 0 disables it
+        std::chrono::milliseconds reaperInterval{1000};
+        //Max number of expiration index entries processed per volume in one pass,
+        //so reaper doesn't block other operations of volume for long
+        size_t reaperBatchSize{1000};
+        //Interval of background checks if mounted volumes need compaction, 0 disables it
+        std::chrono::milliseconds compactionInterval{0};
+        //Volume is compacted in background when size freed since mount exceeds this fraction of its files size
+        double compactionFreedRatio{0.5};
+        //Max number of keys copied by one compaction step, modifications of volume wait for step to finish
+        size_t compactionStepSize{1000};
+        //Pause between steps of background compaction
+        std::chrono::milliseconds compactionStepPause{10};
+        //Dir structure of created volumes, compacted volume keeps its structure
+        DirStructure volumeDirStructure{DirStructure::skipList};
+        //Nodes of created volumes are aligned to pages of this size (e.g. 4096), 0 places nodes one after another.
+        //Compacted volume keeps its node layout.
+        size_t volumeNodePageSize{0};
+        //Max number of entries in node of created volumes, 0 selects 16 or as many as fit into page
+        size_t volumeNodeEntriesCount{0};
+        //Created volumes have hash index of dir entries for point lookups, compacted volume keeps it
+        bool volumeHashIndex{false};
+        //Created volumes have Bloom filters of dirs, so lookups of missing keys rarely read volume.
+        //Filters are rebuilt when volume is compacted, compacted volume keeps them.
+        bool volumeDirFilters{false};
+        //Number of threads executing async operations, threads are started by the first async call
+        size_t asyncThreadsCount{2};
     };
 
     using ValueType = boost::variant<uint8_t, uint16_t, uint32_t, uint64_t,
@@ -25,6 +95,62 @@ public:
 
     using UniquePtr = std::unique_ptr<PHKVStorage>;
 
+    //Completion handlers of async operations, exception_ptr is null on success
+    using CompletionHandler = std::function<void(std::exception_ptr)>;
+    using LookupHandler = std::function<void(boost::optional<ValueType>, std::exception_ptr)>;
+
+    //Set of modifications applied by write
+    class WriteBatch {
+    public:
+        enum class OpType {
+            store,
+            eraseKey,
+            //change expiration time of existing key
+            expire
+        };
+
+        struct Op {
+            OpType type;
+            std::string keyPath;
+            ValueType value;
+            TimePointOpt expTime;
+        };
+
+        void store(boost::string_view keyPath, const ValueType& value, TimePointOpt expTime = {})
+        {
+            m_ops.push_back({OpType::store, std::string(keyPath.data(), keyPath.length()), value, expTime});
+        }
+
+        void eraseKey(boost::string_view keyPath)
+        {
+            m_ops.push_back({OpType::eraseKey, std::string(keyPath.data(), keyPath.length()), {}, {}});
+        }
+
+        //empty expTime removes expiration
+        void expire(boost::string_view keyPath, TimePointOpt expTime)
+        {
+            m_ops.push_back({OpType::expire, std::string(keyPath.data(), keyPath.length()), {}, expTime});
+        }
+
+        const std::vector<Op>& getOps() const
+        {
+            return m_ops;
+        }
+
+        bool empty() const
+        {
+            return m_ops.empty();
+        }
+
+        void clear()
+        {
+            m_ops.clear();
+        }
+
+    private:
+        std::vector<Op> m_ops;
+    };
+
     enum class EntryType {
         key,
         dir
@@ -35,6 +161,37 @@ public:
         std::string name;
     };
 
+    struct ScanOptions {
+        //Scan starts from the first entry with name not less than from
+        std::string from;
+        //Scan stops at the first entry with name that doesn't start with prefix
+        std::string prefix;
+        //Load values of keys
+        bool withValues{false};
+        //Max number of entries read from volume at once
+        size_t batchSize{256};
+    };
+
+    struct ScanEntry {
+        EntryType type;
+        std::string name;
+        //Set for keys if ScanOptions::withValues is true
+        boost::optional<ValueType> value;
+    };
+
+    //Forward cursor over dir entries in name order.
+    //Entries are read from volumes in batches, so dir is never loaded as a whole.
+    //Changes made during scan may or may not be seen by cursor.
+    class DirCursor {
+    public:
+        using UniquePtr = std::unique_ptr<DirCursor>;
+
+        //Return next entry or empty optional when scan is complete
+        virtual boost::optional<ScanEntry> next() = 0;
+
+        virtual ~DirCursor() = default;
+    };
+
     using VolumeId = uint32_t;
 
     struct VolumeInfo{
@@ -47,23 +204,107 @@ public:
     static UniquePtr create(const Options& options);
     static void deleteVolume(const boost::filesystem::path& volumePath, boost::string_view volumeName);
 
+    //durability overrides Options::durability for this mount
     virtual VolumeId createAndMountVolume(const boost::filesystem::path& volumePath, boost::string_view volumeName,
-                                      boost::string_view mountPointPath) = 0;
+                                      boost::string_view mountPointPath,
+                                      boost::optional<Durability> durability = {}) = 0;
     virtual VolumeId mountVolume(const boost::filesystem::path& volumePath, boost::string_view volumeName,
-                             boost::string_view mountPointPath) = 0;
+                             boost::string_view mountPointPath, boost::optional<Durability> durability = {}) = 0;
     virtual void unmountVolume(VolumeId volumeId) = 0;
     virtual std::vector<VolumeInfo> getMountVolumesInfo() const = 0;
 
+    //Rewrite live keys of volume into new densely packed files and replace volume files with them.
+    //Volume stays mounted, keys are copied in steps of Options::compactionStepSize keys.
+    //Files are replaced atomically, interrupted replacement is completed on next mount.
+    virtual void compactVolume(VolumeId volumeId) = 0;
+
     virtual void store(boost::string_view keyPath, const ValueType& value, TimePointOpt expTime = {}) = 0;
 
     virtual boost::optional<ValueType> lookup(boost::string_view keyPath) = 0;
 
+    //Lookup multiple keys, result is in order of keyPaths.
+    //Keys that are not in cache are grouped by volume and looked up with single volume call.
+    virtual std::vector<boost::optional<ValueType>> lookupMany(const std::vector<boost::string_view>& keyPaths) = 0;
+
     virtual void eraseKey(boost::string_view keyPath) = 0;
     virtual void eraseDirRecursive(boost::string_view dirPath) = 0;
 
+    //Apply all operations of batch. Operations are grouped by volume
+    //and each group is applied as a single volume operation.
+    //Operations on the same key are applied in order of addition.
+    virtual void write(const WriteBatch& batch) = 0;
+
+    //Async operations take their place in order of volume operations before call returns,
+    //so they are applied in order of calls, also relative to synchronous calls.
+    //Operations are executed by pool of Options::asyncThreadsCount threads, one at a time per volume.
+    //Handler is called from pool thread, from background flusher for perBatch durability,
+    //or from calling thread if volume isn't accessed (e.g. lookup of cached key).
+    //Handler must not wait for other async operations. Exceptions thrown by handler are ignored.
+    virtual void storeAsync(boost::string_view keyPath, const ValueType& value, TimePointOpt expTime,
+                            CompletionHandler handler) = 0;
+    virtual void lookupAsync(boost::string_view keyPath, LookupHandler handler) = 0;
+    virtual void eraseAsync(boost::string_view keyPath, CompletionHandler handler) = 0;
+
+    std::future<void> storeAsync(boost::string_view keyPath, const ValueType& value, TimePointOpt expTime = {})
+    {
+        auto promise = std::make_shared<std::promise<void>>();
+        auto rv = promise->get_future();
+        storeAsync(keyPath, value, expTime, makeCompletionHandler(promise));
+        return rv;
+    }
+
+    std::future<boost::optional<ValueType>> lookupAsync(boost::string_view keyPath)
+    {
+        auto promise = std::make_shared<std::promise<boost::optional<ValueType>>>();
+        auto rv = promise->get_future();
+        lookupAsync(keyPath, [promise](boost::optional<ValueType> value, std::exception_ptr error) {
+            if(error)
+            {
+                promise->set_exception(error);
+            }
+            else
+            {
+                promise->set_value(std::move(value));
+            }
+        });
+        return rv;
+    }
+
+    std::future<void> eraseAsync(boost::string_view keyPath)
+    {
+        auto promise = std::make_shared<std::promise<void>>();
+        auto rv = promise->get_future();
+        eraseAsync(keyPath, makeCompletionHandler(promise));
+        return rv;
+    }
+
     virtual boost::optional<std::vector<DirEntry>> getDirEntries(boost::string_view dirPath) = 0;
 
+    //Entries of dir are read directly from volumes, bypassing cache.
+    //Cursor of nonexistent dir returns no entries.
+    virtual DirCursor::UniquePtr scanDir(boost::string_view dirPath, const ScanOptions& options) = 0;
+
+    DirCursor::UniquePtr scanDir(boost::string_view dirPath)
+    {
+        return scanDir(dirPath, ScanOptions());
+    }
+
     virtual ~PHKVStorage() = default;
+
+private:
+    static CompletionHandler makeCompletionHandler(std::shared_ptr<std::promise<void>> promise)
+    {
+        return [promise](std::exception_ptr error) {
+            if(error)
+            {
+                promise->set_exception(error);
+            }
+            else
+            {
+                promise->set_value();
+            }
+        };
+    }
 };
 
 }
@@ -26,6 +26,8 @@ public:
 
     void read(OffsetType offset, boost::asio::mutable_buffer buf) override;
 
+    void readMany(const std::vector<IRandomAccessFile::ReadRequest>& requests) override;
+
     void freeSlot(OffsetType offset, size_t size) override;
 
     void openImpl();
@@ -82,19 +84,18 @@ const FileVersion SmallToMediumFileStorageImpl::s_currentVersion{0x0001, 0x0000}
 
 void SmallToMediumFileStorageImpl::openImpl()
 {
-    auto fileSize = m_file->seekEnd();
+    auto fileSize = m_file->getSize();
     if(fileSize < k_headerSize)
     {
         throw std::runtime_error(
             fmt::format("Unexpected file size of {} for SmallToMediumFileStorageImpl:{}",
                         m_file->getFilename().string(), fileSize));
     }
-    m_file->seek(0);
 
     std::array<uint8_t, k_headerSize> headerData{};
     auto buf = boost::asio::buffer(headerData);
 
-    m_file->read(buf);
+    m_file->readAt(0, buf);
 
     InputBinBuffer in(buf);
 
@@ -124,7 +125,7 @@ void SmallToMediumFileStorageImpl::openImpl()
 
 void SmallToMediumFileStorageImpl::createImpl()
 {
-    auto fileSize = m_file->seekEnd();
+    auto fileSize = m_file->getSize();
     if(fileSize != 0)
     {
         throw std::runtime_error(fmt::format("File {} must be empty for SmallToMediumFileStorageImpl:{}",
@@ -139,7 +140,7 @@ void SmallToMediumFileStorageImpl::createImpl()
     {
         out.writeU64(0);
     }
-    m_file->write(buf);
+    m_file->writeAt(0, buf);
 }
 
 SmallToMediumFileStorageImpl::OffsetType SmallToMediumFileStorageImpl::allocateAndWrite(boost::asio::const_buffer buf)
@@ -156,16 +157,20 @@ SmallToMediumFileStorageImpl::OffsetType SmallToMediumFileStorageImpl::allocateA
     }
     else
     {
-        rv = m_file->seekEnd();
+        rv = m_file->getSize();
     }
-    m_file->seek(rv);
-    m_file->write(buf);
 
-    size_t paddingSize = maxSlotSizeForIndex(index) - buf.size();
-    if(paddingSize != 0)
+    size_t slotSize = maxSlotSizeForIndex(index);
+    if(slotSize == buf.size())
+    {
+        m_file->writeAt(rv, buf);
+    }
+    else
     {
-        uint8_t padding[256] = {0,};
-        m_file->write(boost::asio::buffer(padding, paddingSize));
+        //write data and padding with a single call
+        std::array<uint8_t, maxDataSize()> slotData{};
+        memcpy(slotData.data(), buf.data(), buf.size());
+        m_file->writeAt(rv, boost::asio::buffer(slotData.data(), slotSize));
     }
 
     return rv;
@@ -178,8 +183,7 @@ SmallToMediumFileStorageImpl::overwrite(OffsetType offset, size_t oldSize, boost
     size_t newIndex = sizeToSlotIndex(buf.size());
     if(oldIndex == newIndex)
     {
-        m_file->seek(offset);
-        m_file->write(buf);
+        m_file->writeAt(offset, buf);
     }
     else
     {
@@ -191,8 +195,12 @@ SmallToMediumFileStorageImpl::overwrite(OffsetType offset, size_t oldSize, boost
 
 void SmallToMediumFileStorageImpl::read(OffsetType offset, boost::asio::mutable_buffer buf)
 {
-    m_file->seek(offset);
-    m_file->read(buf);
+    m_file->readAt(offset, buf);
+}
+
+void SmallToMediumFileStorageImpl::readMany(const std::vector<IRandomAccessFile::ReadRequest>& requests)
+{
+    m_file->readAtMany(requests);
 }
 
 void SmallToMediumFileStorageImpl::freeSlot(OffsetType offset, size_t size)
@@ -16,6 +16,8 @@ public:
     virtual OffsetType allocateAndWrite(boost::asio::const_buffer buf) = 0;
     virtual OffsetType overwrite(OffsetType offset, size_t oldSize, boost::asio::const_buffer buf) = 0;
     virtual void read(OffsetType offset, boost::asio::mutable_buffer buf) = 0;
+    //Read independent slots at once
+    virtual void readMany(const std::vector<IRandomAccessFile::ReadRequest>& requests) = 0;
 
     virtual void freeSlot(OffsetType offset, size_t size) = 0;
 
@@ -1,8 +1,11 @@
 #include "StorageVolume.hpp"
 
 #include <chrono>
+#include <map>
+#include <mutex>
 #include <random>
 #include <thread>
+#include <unordered_map>
 
 #include "UIntArrayHexFormatter.hpp"
 #include "KeyPathUtil.hpp"
@@ -10,6 +13,7 @@
 #include "StringViewFormatter.hpp"
 #include "FileMagic.hpp"
 #include "FileVersion.hpp"
+#include "LRUPriorityCachePool.hpp"
 
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/null_sink.h>
@@ -27,24 +31,77 @@ uint64_t nowInMilliseconds()
     return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
 }
 
+uint64_t expTimeToMilliseconds(const StorageVolume::TimePointOpt& expTime)
+{
+    using namespace std::chrono;
+    return expTime ? duration_cast<milliseconds>((*expTime).time_since_epoch()).count() : 0;
+}
+
+StorageVolume::TimePointOpt millisecondsToExpTime(uint64_t expTime)
+{
+    if(!expTime)
+    {
+        return {};
+    }
+    return StorageVolume::TimePoint(std::chrono::milliseconds(expTime));
+}
+
 const char* s_loggingCategory = "StorageVolume";
 
 class StorageVolumeImpl : public StorageVolume {
 public:
     StorageVolumeImpl(FileSystem::UniqueFilePtr&& mainFile,
                       SmallToMediumFileStorage::UniquePtr&& stmFileStorage,
-                      BigFileStorage::UniquePtr&& bigFileStorage);
+                      BigFileStorage::UniquePtr&& bigFileStorage,
+                      const Options& options,
+                      WriteAheadLog::UniquePtr&& log);
+
+    ~StorageVolumeImpl() override;
 
     void store(boost::string_view keyPath, const ValueType& value, TimePointOpt expTime) override;
 
     boost::optional<ValueType> lookup(boost::string_view keyPath) override;
 
+    boost::optional<ValueType> lookup(boost::string_view keyPath, TimePointOpt& expTime) override;
+
     void eraseKey(boost::string_view keyPath) override;
 
     void eraseDirRecursive(boost::string_view dirPath) override;
 
+    void write(const WriteBatch& batch) override;
+
+    std::vector<boost::optional<ValueType>> lookupMany(const std::vector<boost::string_view>& keyPaths) override;
+
     boost::optional<std::vector<DirEntry>> getDirEntries(boost::string_view dirPath) override;
 
+    boost::optional<std::vector<ScanEntry>> scanDir(boost::string_view dirPath, const ScanOptions& options) override;
+
+    void flush() override;
+
+    bool hasUnsyncedChanges() override;
+
+    bool hasExpiredKeys() override;
+
+    size_t reapExpired(size_t maxEntries) override;
+
+    DirStructure getDirStructure() override;
+
+    size_t getNodePageSize() override;
+
+    size_t getNodeEntriesCount() override;
+
+    bool hasHashIndex() override;
+
+    bool hasDirFilters() override;
+
+    uint64_t getFreedSize() override;
+
+    void startCopy(StorageVolume& target) override;
+
+    bool copyStep(size_t maxKeys) override;
+
+    void stopCopy() override;
+
     void dump(const std::function<void(const std::string&)>& out) override;
 
     void openImpl();
@@ -58,21 +115,119 @@ private:
 
     static const FileMagic s_magic;
     static const FileVersion s_currentVersion;
+    //version without dir filters
+    static const FileVersion s_noDirFiltersVersion;
+    //version without hash index
+    static const FileVersion s_noHashIndexVersion;
+    //version without node layout in header
+    static const FileVersion s_noNodeLayoutVersion;
+    //version without B+tree dirs
+    static const FileVersion s_noTreeDirsVersion;
+    //version with nexts of nodes taller than 1 in small to medium storage
+    static const FileVersion s_noInlineNextsVersion;
+    //version without key fingerprints in node entries
+    static const FileVersion s_noKeyFingerprintsVersion;
+    //version without expiration index
+    static const FileVersion s_noExpirationIndexVersion;
 
     static constexpr size_t k_headerSize = FileMagic::binSize() + FileVersion::binSize() +
                                            sizeof(OffsetType) + sizeof(OffsetType);
-    static constexpr size_t k_rootListOffset = k_headerSize;
+    //node page size and entries per node follow header since version 1.5
+    static constexpr size_t k_nodeLayoutSize = sizeof(uint32_t) + sizeof(uint32_t);
+    //offset of hash index follows node layout since version 1.6
+    static constexpr size_t k_hashIndexFieldSize = sizeof(OffsetType);
+    //offset of dir filters registry follows offset of hash index since version 1.7
+    static constexpr size_t k_dirFiltersFieldSize = sizeof(OffsetType);
     static constexpr size_t k_inplaceSize = 16;
-    static constexpr size_t k_entriesPerNode = 16;
+    static constexpr size_t k_keyPrefixSize = 8;
+    static constexpr size_t k_defaultEntriesPerNode = 16;
+    static constexpr size_t k_minEntriesPerNode = 4;
+    //number of entries is stored in one byte
+    static constexpr size_t k_maxEntriesPerNode = 255;
+    static constexpr size_t k_maxNodePageSize = 16 * 1024;
     static constexpr size_t k_maxListHeight = 16;
+    //width of expiration index bucket in milliseconds
+    static constexpr uint64_t k_expirationBucketSize = 1000;
 
+    //Modifications below are not committed
     void store(boost::string_view keyPath, const ValueType& value, uint64_t expTime);
 
+    void eraseKeyNoCommit(boost::string_view keyPath);
+
+    void expire(boost::string_view keyPath, uint64_t expTime);
+
+    //Expiration index is a list of dirs named by bucket number in hex, so buckets are sorted by time.
+    //Bucket lists keep key paths of keys with expiration time in bucket. Index entries aren't removed
+    //when key is erased or its expiration is changed, reaper checks actual expiration of key instead.
+    void addToExpirationIndex(boost::string_view keyPath, uint64_t expTime);
+
+    //Check if key path is not greater than path of the last key copied to compaction target
+    bool isCopied(boost::string_view keyPath);
+
+    //Copy keys of dir to batch, dir is scanned after position of the last copied key if resume is true.
+    //Returns false if copying was stopped, because batch has maxKeys keys.
+    bool copyDir(OffsetType headOffset, std::vector<std::string>& path, bool resume, size_t maxKeys,
+                 WriteBatch& batch);
+
+    //Return list head offset of the earliest bucket, if all keys of it are expired
+    OffsetType findExpiredBucket(uint64_t now, std::string& bucketName);
+
+    void eraseIfExpired(boost::string_view keyPath, uint64_t now);
+
+    struct DirAndKey {
+        //dir part of key path including trailing '/'
+        boost::string_view dir;
+        boost::string_view key;
+        //index of key path in source vector
+        size_t index;
+    };
+    using DirAndKeyVector = std::vector<DirAndKey>;
+
+    //Split key paths and stable sort them by dir and then by key
+    static DirAndKeyVector sortByDirAndKey(const std::vector<boost::string_view>& keyPaths);
+
+    //Return offset of list head of key's dir, missing dirs are created if create is true.
+    //0 is returned if dir doesn't exist.
+    OffsetType findKeyDir(boost::string_view keyPath, const PathAndKey& pathKey, bool create);
+
+    //Same as findKeyDir without create, but last used dir isn't updated, so it's safe for concurrent lookups
+    OffsetType lookupKeyDir(boost::string_view keyPath, const PathAndKey& pathKey);
+
+    bool isLastDir(boost::string_view keyPath, const PathAndKey& pathKey) const
+    {
+        return m_lastDirHeadOffset != 0 &&
+               keyPath.compare(0, keyPath.length() - pathKey.key.length(), m_lastDir) == 0;
+    }
+
     struct KeyInfo {
         std::string value;
         OffsetType offset{0};
+        //external key is fetched from storage only when it's needed
+        bool loaded{true};
+        size_t length{0};
+        //prefix and hash of external key, so most comparisons don't need to fetch it
+        bool hasFingerprint{false};
+        uint32_t hash{0};
+        std::array<uint8_t, k_keyPrefixSize> prefix{};
+
+        size_t size() const
+        {
+            return loaded ? value.length() : length;
+        }
+
+        boost::string_view prefixView() const
+        {
+            return boost::string_view(reinterpret_cast<const char*>(prefix.data()), prefix.size());
+        }
 
         static constexpr size_t binSize()
+        {
+            //up to 16 chars string is inplace
+            //or size + hash + offset + prefix for longer strings
+            return 4 + 4 + 8 + k_keyPrefixSize;
+        }
+
+        static constexpr size_t noFingerprintBinSize()
         {
             //up to 16 chars string is inplace
             //or size + offset for longer strings
@@ -80,10 +235,31 @@ private:
         }
     };
 
+    static uint32_t keyHash(const boost::string_view& key);
+
+    //Compare not fetched key with value using fingerprint.
+    //Returns false if fingerprint isn't enough to decide.
+    static bool compareKeyFingerprint(const KeyInfo& key, const boost::string_view& value, int& result);
+
+    //False if fingerprint proves that key isn't equal to value
+    static bool mayBeSameKey(const KeyInfo& key, const boost::string_view& value);
+
+    //Fetch key only if fingerprint isn't enough for comparison
+    int compareKey(KeyInfo& key, const boost::string_view& value);
+
+    //Found entry of findEntry is fetched, so not fetched key is never equal to value
+    static bool isSameKey(const KeyInfo& key, const boost::string_view& value)
+    {
+        return key.loaded && key.value == value;
+    }
+
     void storeKey(OutputBinBuffer& out, KeyInfo& key);
 
     void loadKey(InputBinBuffer& in, bool isInplace, KeyInfo& key);
 
+    //Fetch external key if it wasn't fetched yet
+    const std::string& loadKeyDelayed(KeyInfo& key);
+
     void loadInplaceString(InputBinBuffer& in, std::string& value);
 
     void loadInplaceVector(InputBinBuffer& in, std::vector<uint8_t>& value);
@@ -207,6 +383,9 @@ private:
 
     void loadValueDelayed(ValueInfo& value);
 
+    //Fetch external values, values from small to medium storage are read in one batch
+    void loadValuesDelayed(const std::vector<ValueInfo*>& values);
+
     static bool isInplaceLength(size_t length)
     {
         return length <= k_inplaceSize;
@@ -273,6 +452,11 @@ private:
              */
             return 1 /*flags*/ + 8 /*exp date*/ + KeyInfo::binSize() + ValueInfo::binSize();
         }
+
+        static constexpr size_t noFingerprintBinSize()
+        {
+            return 1 /*flags*/ + 8 /*exp date*/ + KeyInfo::noFingerprintBinSize() + ValueInfo::binSize();
+        }
     };
 
     struct EntryKeyComparator {
@@ -296,32 +480,94 @@ private:
 
     void loadEntry(InputBinBuffer& in, Entry& entry);
 
-    void loadEntryKey(InputBinBuffer& in, std::string& key);
+    void loadEntryKey(InputBinBuffer& in, KeyInfo& key);
 
     void freeEntry(Entry& entry);
 
     using EntriesVector = std::vector<Entry>;
     using NextsVector = std::vector<OffsetType>;
 
+    struct SkipListNode;
+
+    //Binary search of key in node, only keys of probed entries that can't be compared by fingerprint are fetched.
+    //Key of found entry is fetched if it may be equal to searched key, so isSameKey can be used for result.
+    EntriesVector::iterator findEntry(OffsetType nodeOffset, SkipListNode& node, const boost::string_view& key);
+
+    //Fetch keys of all entries of node
+    void loadNodeKeys(OffsetType nodeOffset, SkipListNode& node);
+
+    //Put keys fetched for copy of node into cached node, so they are fetched once while node is cached
+    void cacheLoadedKeys(OffsetType nodeOffset, const SkipListNode& node);
+
+    void cacheLoadedKey(OffsetType nodeOffset, size_t index, const KeyInfo& key);
+
     struct SkipListNode {
         NextsVector nexts;
         OffsetType nextOffset{0};
         EntriesVector entries;
 
-        static constexpr size_t binSize()
+        //max size of node by default
+        static constexpr size_t binSize(size_t headBinSize = binHeadSize(), size_t entryBinSize = Entry::binSize(),
+                                        size_t entriesCount = k_maxEntriesPerNode)
         {
-            return 1/*next size*/ + sizeof(OffsetType) + 1/*entries*/ + k_entriesPerNode * Entry::binSize();
+            return headBinSize + 1/*entries*/ + entriesCount * entryBinSize;
         }
 
         static constexpr size_t binHeadSize()
+        {
+            return 1/*next size*/ + k_maxListHeight * sizeof(OffsetType);
+        }
+
+        //nexts of node taller than 1 are stored in small to medium storage
+        static constexpr size_t noInlineNextsBinHeadSize()
         {
             return 1/*next size*/ + sizeof(OffsetType);
         }
     };
 
+    struct NodeCacheItem {
+        boost::intrusive::list_member_hook<> poolListNode;
+        uint8_t poolPrio;
+        OffsetType offset;
+        //only nexts of node are loaded
+        bool headOnly;
+        //number of bytes of data that must be written to main file
+        size_t dirtySize;
+        SkipListNode node;
+        std::vector<uint8_t> data;
+    };
+
+    static uint8_t nodeCachePriority(size_t listHeight);
+
+    NodeCacheItem* findCachedNode(OffsetType offset);
+
+    NodeCacheItem* allocateCachedNode(OffsetType offset, size_t listHeight, bool headOnly);
+
+    void writeCachedNode(NodeCacheItem& item);
+
+    void dropCachedNode(OffsetType offset);
+
+    void cachedNodeReuseNotify(NodeCacheItem* item);
+
+    void writeEvictedNodes();
+
+    //Read node data from main file with not yet written changes of evicted or cached node applied.
+    //File is read without node cache lock, so concurrent lookups don't wait for each other's io.
+    template<size_t N>
+    boost::asio::const_buffer readNodeData(OffsetType offset, std::array<uint8_t, N>& storage, size_t size = N);
+
+    void unloadExternalValues(EntriesVector& entries);
+
+    void writeCachedNodes();
+
+    void commitOperation();
+
+    //Set node page size and entries per node of volume, 0 selects default or derives one from another
+    void setNodeLayout(size_t pageSize, size_t entriesCount);
+
     OffsetType allocateSkipListHeadNode();
 
-    OffsetType createSkipListHeadNode();
+    OffsetType createDirHeadNode();
 
     OffsetType allocateSkipListNode();
 
@@ -355,7 +601,18 @@ private:
         last
     };
 
-    void loadNodeNextsAndEdgeKey(OffsetType offset, NextsVector& nexts, EdgeKey whichKey, std::string& key);
+    //Key of entry at index of node
+    struct NodeKey {
+        OffsetType nodeOffset{0};
+        size_t index{0};
+        KeyInfo key;
+    };
+
+    //Edge key isn't fetched, it's fetched by compareNodeKey if needed
+    void loadNodeNextsAndEdgeKey(OffsetType offset, NextsVector& nexts, EdgeKey whichKey, NodeKey& key);
+
+    //Fetched key is put into cached node
+    int compareNodeKey(NodeKey& key, const boost::string_view& value);
 
     using ListPath = std::array<OffsetType, k_maxListHeight>;
 
@@ -363,31 +620,271 @@ private:
 
     size_t generateNewLevel();
 
-    void listInsert(OffsetType headOffset, Entry&& entry);
+    //Return false if existing entry was overwritten
+    bool listInsert(OffsetType headOffset, Entry&& entry);
 
     bool listLookup(OffsetType headOffset, const boost::string_view& key, Entry& entry);
 
+    //Lookup sorted keys with single forward pass through the list, onFound is called with index of found key.
+    void listLookupSorted(OffsetType headOffset, const std::vector<boost::string_view>& keys,
+                          const std::function<void(size_t, Entry&)>& onFound);
+
     void listErase(OffsetType head, EntryType type, const boost::string_view& key);
 
+    //Return false if key wasn't found
+    bool listSetExpiration(OffsetType headOffset, const boost::string_view& key, uint64_t expTime);
+
     void listEraseRecursive(OffsetType nodeHeadOffset);
 
     void listGetContent(OffsetType nodeHeadOffset, std::vector<DirEntry>& entries);
 
+    //Read entries starting from the first one not less than from, until onEntry returns false
+    void listScan(OffsetType nodeHeadOffset, const boost::string_view& from,
+                  const std::function<bool(Entry&)>& onEntry);
+
     OffsetType followPath(const std::vector<boost::string_view>& path);
 
     void dumpList(OffsetType headOffset, size_t indent, const std::function<void(const std::string&)>& out);
 
+    //Replace value of existing entry with value of entry with the same key
+    void overwriteEntry(Entry& existing, Entry&& entry);
+
+    //B+tree dir is a list with tree instead of upper levels. Head of tree has two nexts: first leaf and root.
+    //Leaves are linked by nexts[0], so code that walks level 0 of skip list works with leaves as well.
+    //Inner nodes have no nexts, their entries are dirs with child offset as value, named by lowest key
+    //of child subtree. Name of the first entry of inner node is empty, it's never compared.
+    //Nodes are removed only when they become empty, compaction makes tree dense again.
+    static constexpr size_t k_treeHeadHeight = 2;
+
+    size_t dirHeadHeight() const
+    {
+        return isTreeDir() ? k_treeHeadHeight : k_maxListHeight;
+    }
+
+    bool isTreeDir() const
+    {
+        return m_dirStructure == DirStructure::bPlusTree;
+    }
+
+    static bool isTreeHead(const SkipListNode& head)
+    {
+        return head.nexts.size() == k_treeHeadHeight;
+    }
+
+    static bool isInnerTreeNode(const SkipListNode& node)
+    {
+        return node.nexts.empty();
+    }
+
+    struct TreePathItem {
+        OffsetType offset;
+        //index of child entry
+        size_t index;
+    };
+    //inner nodes from root to parent of leaf
+    using TreePath = std::vector<TreePathItem>;
+
+    //Index of the last child with lowest key not greater than key
+    size_t findChild(OffsetType nodeOffset, SkipListNode& node, const boost::string_view& key);
+
+    //Return offset of leaf where key is or should be, 0 if tree is empty
+    OffsetType treeFindLeaf(const SkipListNode& head, const boost::string_view& key, TreePath& path,
+                            SkipListNode& leaf);
+
+    bool treeInsert(OffsetType headOffset, Entry&& entry);
+
+    //Insert child entry after child at path[level] splitting inner nodes up to root if needed
+    void treeInsertChild(OffsetType headOffset, SkipListNode& head, TreePath& path, size_t level, Entry&& child);
+
+    bool treeLookup(OffsetType headOffset, const boost::string_view& key, Entry& entry);
+
+    void treeErase(OffsetType headOffset, EntryType type, const boost::string_view& key);
+
+    //Erase child at path[level] removing inner nodes that become empty
+    void treeEraseChild(OffsetType headOffset, SkipListNode& head, TreePath& path, size_t level);
+
+    //Leaf that precedes leaf at the end of path
+    OffsetType treeFindPrevLeaf(const TreePath& path);
+
+    bool treeSetExpiration(OffsetType headOffset, const boost::string_view& key, uint64_t expTime);
+
+    //Free inner nodes of subtree, return false if node is a leaf
+    bool treeFreeInnerNodes(OffsetType nodeOffset);
+
+    //Hash index has one record per entry of every dir: (dir head offset, key hash, offset of node with entry).
+    //Records of key are in the bucket chain addressed by hash of dir and key, so lookup reads the chain
+    //and the nodes it points to instead of descending from dir head. Missing record means missing key.
+    //Index uses linear hashing: buckets are added one by one by splitting the bucket the new one was split from.
+    //Buckets are slots of node size, bucket i is in segment of its bit length, segment s has 2^(s-1) buckets
+    //(segment 0 has one), so offsets of segments are enough to address all buckets.
+    //Bucket that is full is continued by chain of overflow buckets.
+    static constexpr size_t k_hashIndexMaxSegments = 32;
+    static constexpr size_t k_hashIndexRecordSize = sizeof(OffsetType) + sizeof(uint32_t) + sizeof(OffsetType);
+    //number of records and overflow bucket offset
+    static constexpr size_t k_hashIndexBucketHeadSize = sizeof(uint16_t) + sizeof(OffsetType);
+
+    struct HashIndexRecord {
+        OffsetType dirOffset;
+        uint32_t keyHash;
+        OffsetType nodeOffset;
+    };
+
+    struct HashIndexBucket {
+        OffsetType overflow{0};
+        std::vector<HashIndexRecord> records;
+    };
+
+    size_t hashIndexBucketCapacity() const
+    {
+        return (m_nodeSize - k_hashIndexBucketHeadSize) / k_hashIndexRecordSize;
+    }
+
+    static uint64_t hashIndexHash(OffsetType dirOffset, uint32_t keyHash);
+
+    OffsetType hashIndexBucketOffset(uint64_t bucketIndex);
+
+    OffsetType hashIndexFindBucket(OffsetType dirOffset, uint32_t keyHash);
+
+    void createHashIndex();
+
+    void loadHashIndexHeader();
+
+    void storeHashIndexHeader();
+
+    void loadHashIndexBucket(OffsetType offset, HashIndexBucket& bucket);
+
+    //Only used part of bucket is written, unless full is set
+    void storeHashIndexBucket(OffsetType offset, const HashIndexBucket& bucket, bool full = false);
+
+    void hashIndexInsert(OffsetType dirOffset, uint32_t keyHash, OffsetType nodeOffset);
+
+    void hashIndexRemove(OffsetType dirOffset, uint32_t keyHash, OffsetType nodeOffset);
+
+    //Entry was moved to another node
+    void hashIndexMove(OffsetType dirOffset, uint32_t keyHash, OffsetType fromOffset, OffsetType toOffset);
+
+    //Add bucket splitting records of its buddy bucket
+    void hashIndexSplitBucket();
+
+    bool hashIndexLookup(OffsetType headOffset, const boost::string_view& key, Entry& entry);
+
+    //Hash of key of entry loaded from node
+    uint32_t entryKeyHash(KeyInfo& key);
+
+    //Bloom filter of names of entries of dir, so lookup of missing key doesn't read dir.
+    //Filters are in main file, offsets of filters are values of hidden registry dir with hex
+    //dir head offsets as keys. Bits are set by store, erase doesn't clear them, so filter is rebuilt
+    //from dir content when it's full and compacted volume has fresh filters.
+    //Dir without filter, e.g. one created before volume got filters, is always read.
+    static constexpr size_t k_dirFilterBitsPerKey = 10;
+    static constexpr size_t k_dirFilterHashesCount = 7;
+    static constexpr size_t k_dirFilterMinSize = 64;
+    //bytes count and keys count
+    static constexpr size_t k_dirFilterHeadSize = sizeof(uint64_t) + sizeof(uint64_t);
+
+    struct DirFilter {
+        OffsetType offset;
+        uint64_t keysCount;
+        std::vector<uint8_t> bits;
+
+        size_t capacity() const
+        {
+            return bits.size() * 8 / k_dirFilterBitsPerKey;
+        }
+    };
+    using DirFilterPtr = std::shared_ptr<DirFilter>;
+
+    //Call f with index of every bit of key
+    template<class F>
+    static void dirFilterForEachBit(const DirFilter& filter, const boost::string_view& key, F f);
+
+    static std::string dirFilterKey(OffsetType dirOffset);
+
+    //Return empty pointer if dir has no filter
+    DirFilterPtr loadDirFilter(OffsetType dirOffset);
+
+    bool dirFilterMayContain(OffsetType dirOffset, const boost::string_view& key);
+
+    //Add name of new entry to filter of dir, filter is created or rebuilt if needed
+    void dirFilterAdd(OffsetType dirOffset, const boost::string_view& key);
+
+    void rebuildDirFilter(OffsetType dirOffset, size_t capacity);
+
+    void dropDirFilter(OffsetType dirOffset);
+
+    //files below are accessed through log, so it must be destroyed last
+    WriteAheadLog::UniquePtr m_wal;
     FileSystem::UniqueFilePtr m_mainFile;
+    //end of main file including allocated, but not yet written nodes
+    OffsetType m_fileEnd{0};
+    OffsetType m_rootListOffset{k_headerSize + k_nodeLayoutSize + k_hashIndexFieldSize + k_dirFiltersFieldSize};
     OffsetType m_firstFreeListNode{0};
     OffsetType m_firstFreeHeadListNode{0};
+    //0 if volume was created without expiration index
+    OffsetType m_expirationIndexOffset{0};
+    //volumes created before inline nexts have shorter node heads
+    bool m_inlineNexts{true};
+    size_t m_headSize{SkipListNode::binHeadSize()};
+    //entries of volumes created before fingerprints have shorter external keys
+    bool m_keyFingerprints{true};
+    size_t m_entrySize{Entry::binSize()};
+    size_t m_nodeSize{SkipListNode::binSize(SkipListNode::binHeadSize(), Entry::binSize(), k_defaultEntriesPerNode)};
+    //nodes of paged volume are aligned to pages, 0 if nodes are placed one after another
+    size_t m_nodePageSize{0};
+    size_t m_entriesPerNode{k_defaultEntriesPerNode};
+    //space taken by node in main file
+    size_t m_nodeAllocSize{m_nodeSize};
+    //head nodes of paged volume are much smaller than page, so they are carved from free space of page
+    OffsetType m_headPageOffset{0};
+    OffsetType m_headPageEnd{0};
+    //0 if volume has no hash index
+    OffsetType m_hashIndexOffset{0};
+    //set for created volume from options
+    bool m_createHashIndex;
+    uint64_t m_hashIndexBucketsCount{0};
+    uint64_t m_hashIndexRecordsCount{0};
+    std::vector<OffsetType> m_hashIndexSegments;
+    //head of registry of dir filters, 0 if volume has no filters
+    OffsetType m_dirFiltersOffset{0};
+    //set for created volume from options
+    bool m_createDirFilters;
+    //filters of dirs used since open, empty pointer if dir has no filter
+    std::unordered_map<OffsetType, DirFilterPtr> m_dirFilters;
+    //lookups load filters concurrently
+    std::mutex m_dirFiltersMtx;
     SmallToMediumFileStorage::UniquePtr m_stmStorage;
     BigFileStorage::UniquePtr m_bigStorage;
 
+    //dir of last modified key, lookups use it, but only modifying operations update it
     std::string m_lastDir;
     OffsetType m_lastDirHeadOffset{0};
 
+    //used by modifying operations only
     std::mt19937 m_random;
 
+    uint64_t m_freedSize{0};
+
+    //target of online compaction and path components of the last copied key
+    StorageVolume* m_copyTarget{nullptr};
+    std::vector<std::string> m_copyPosition;
+    bool m_copyComplete{false};
+
+    //head nodes, nodes of higher levels, nodes of level 0
+    using NodeCachePoolType = LRUPriorityCachePool<NodeCacheItem, &NodeCacheItem::poolListNode,
+            &NodeCacheItem::poolPrio, 3>;
+    NodeCachePoolType m_nodeCachePool;
+    bool m_nodeCacheEnabled;
+    //structure of new dirs, all dirs of volume have the same structure
+    DirStructure m_dirStructure;
+    std::unordered_map<OffsetType, NodeCacheItem*> m_nodeCacheMap;
+    //Modified nodes evicted from cache. Lookups may evict nodes concurrently with each other,
+    //so evicted nodes are written by the next modifying operation or flush.
+    std::map<OffsetType, std::vector<uint8_t>> m_evictedNodes;
+    //Guards node cache and evicted nodes. Modifying operations are never concurrent with
+    //anything else, lookups and getDirEntries may run concurrently with each other.
+    std::mutex m_nodeCacheMtx;
+    using NodeCacheLock = std::lock_guard<std::mutex>;
+
     using LoggerType = decltype(spdlog::get({}));
 
     LoggerType& getLogger();
@@ -396,14 +893,32 @@ private:
 };
 
 const FileMagic StorageVolumeImpl::s_magic = {{'P', 'H', 'V', 'L'}};
-const FileVersion StorageVolumeImpl::s_currentVersion = {0x0001, 0x0000};
+const FileVersion StorageVolumeImpl::s_currentVersion = {0x0001, 0x0007};
+const FileVersion StorageVolumeImpl::s_noDirFiltersVersion = {0x0001, 0x0006};
+const FileVersion StorageVolumeImpl::s_noHashIndexVersion = {0x0001, 0x0005};
+const FileVersion StorageVolumeImpl::s_noNodeLayoutVersion = {0x0001, 0x0004};
+const FileVersion StorageVolumeImpl::s_noTreeDirsVersion = {0x0001, 0x0003};
+const FileVersion StorageVolumeImpl::s_noInlineNextsVersion = {0x0001, 0x0002};
+const FileVersion StorageVolumeImpl::s_noKeyFingerprintsVersion = {0x0001, 0x0001};
+const FileVersion StorageVolumeImpl::s_noExpirationIndexVersion = {0x0001, 0x0000};
 
 StorageVolumeImpl::StorageVolumeImpl(FileSystem::UniqueFilePtr&& mainFile,
                                      SmallToMediumFileStorage::UniquePtr&& stmFileStorage,
-                                     BigFileStorage::UniquePtr&& bigFileStorage) :
+                                     BigFileStorage::UniquePtr&& bigFileStorage,
+                                     const Options& options,
+                                     WriteAheadLog::UniquePtr&& log) :
+        m_wal(std::move(log)),
         m_mainFile(std::move(mainFile)),
         m_stmStorage(std::move(stmFileStorage)),
-        m_bigStorage(std::move(bigFileStorage))
+        m_bigStorage(std::move(bigFileStorage)),
+        m_nodeCachePool(options.nodeCacheSize,
+                std::bind(&StorageVolumeImpl::cachedNodeReuseNotify, this, std::placeholders::_1)),
+        m_nodeCacheEnabled(options.nodeCacheSize != 0),
+        m_dirStructure(options.dirStructure),
+        m_nodePageSize(options.nodePageSize),
+        m_entriesPerNode(options.nodeEntriesCount),
+        m_createHashIndex(options.hashIndex),
+        m_createDirFilters(options.dirFilters)
 {
     std::hash<std::thread::id> hasher;
     std::seed_seq seed{
@@ -413,20 +928,35 @@ StorageVolumeImpl::StorageVolumeImpl(FileSystem::UniqueFilePtr&& mainFile,
     m_random.seed(seed);
 }
 
+StorageVolumeImpl::~StorageVolumeImpl()
+{
+    try
+    {
+        flush();
+        if(m_wal)
+        {
+            m_wal->checkpoint();
+        }
+    }
+    catch(std::exception& e)
+    {
+        getLogger()->error("Failed to flush {}: {}", m_mainFile->getFilename().string(), e.what());
+    }
+}
+
 
 void StorageVolumeImpl::openImpl()
 {
-    auto fileSize = m_mainFile->seekEnd();
+    auto fileSize = m_mainFile->getSize();
     if(fileSize < k_headerSize)
     {
         throw std::runtime_error(
                 fmt::format("StorageVolume::open: Unexpected file size of {}:{}",
                         m_mainFile->getFilename().string(), fileSize));
     }
-    std::array<uint8_t, k_headerSize> headerData{};
-    auto buf = boost::asio::buffer(headerData);
-    m_mainFile->seek(0);
-    m_mainFile->read(buf);
+    std::array<uint8_t, k_headerSize + k_nodeLayoutSize + k_hashIndexFieldSize + k_dirFiltersFieldSize> headerData{};
+    auto buf = boost::asio::buffer(headerData.data(), std::min<size_t>(headerData.size(), fileSize));
+    m_mainFile->readAt(0, buf);
     InputBinBuffer in(buf);
 
     FileMagic magic;
@@ -440,35 +970,148 @@ void StorageVolumeImpl::openImpl()
 
     FileVersion version{0, 0};
     version.deserialize(in);
-    if(version != s_currentVersion)
+    //all previous minor versions are supported
+    if(version.major != s_currentVersion.major || version.minor > s_currentVersion.minor)
     {
         throw std::runtime_error(
                 fmt::format("StorageVolume::open: invalid version of file {}. Expected {}, but found {}",
-                        m_mainFile->getFilename().string(), s_magic, magic));
+                        m_mainFile->getFilename().string(), s_currentVersion, version));
+    }
+    if(version.minor <= s_noInlineNextsVersion.minor)
+    {
+        m_inlineNexts = false;
+        m_headSize = SkipListNode::noInlineNextsBinHeadSize();
+    }
+    if(version.minor <= s_noKeyFingerprintsVersion.minor)
+    {
+        m_keyFingerprints = false;
+        m_entrySize = Entry::noFingerprintBinSize();
     }
     m_firstFreeHeadListNode = in.readU64();
     m_firstFreeListNode = in.readU64();
+    //header grew by one field per version since 1.5
+    m_rootListOffset = k_headerSize;
+    if(version.minor <= s_noNodeLayoutVersion.minor)
+    {
+        setNodeLayout(0, k_defaultEntriesPerNode);
+    }
+    else
+    {
+        size_t pageSize = in.readU32();
+        size_t entriesCount = in.readU32();
+        setNodeLayout(pageSize, entriesCount);
+        m_rootListOffset += k_nodeLayoutSize;
+    }
+    if(version.minor > s_noHashIndexVersion.minor)
+    {
+        m_hashIndexOffset = in.readU64();
+        m_rootListOffset += k_hashIndexFieldSize;
+    }
+    if(version.minor > s_noDirFiltersVersion.minor)
+    {
+        m_dirFiltersOffset = in.readU64();
+        m_rootListOffset += k_dirFiltersFieldSize;
+    }
+    if(version != s_noExpirationIndexVersion)
+    {
+        //head of expiration index follows head of root list
+        m_expirationIndexOffset = m_rootListOffset + m_headSize;
+    }
+    m_fileEnd = fileSize;
+    if(m_nodePageSize)
+    {
+        //the last page may be head page with unwritten tail, it isn't reused
+        m_fileEnd = (m_fileEnd + m_nodePageSize - 1) / m_nodePageSize * m_nodePageSize;
+    }
+    m_dirStructure = DirStructure::skipList;
+    if(version.minor > s_noTreeDirsVersion.minor)
+    {
+        SkipListNode rootHead;
+        loadHeadNode(m_rootListOffset, rootHead);
+        if(isTreeHead(rootHead))
+        {
+            m_dirStructure = DirStructure::bPlusTree;
+        }
+    }
+    if(m_hashIndexOffset)
+    {
+        loadHashIndexHeader();
+    }
 }
 
 void StorageVolumeImpl::createImpl()
 {
-    auto fileSize = m_mainFile->seekEnd();
+    auto fileSize = m_mainFile->getSize();
     if(fileSize != 0)
     {
         throw std::runtime_error(fmt::format("StorageVolume::create: file {} must be empty, but size={}",
                 m_mainFile->getFilename().string(), fileSize));
     }
-    std::array<uint8_t, k_headerSize + SkipListNode::binSize()> headerData{};
-    auto buf = boost::asio::buffer(headerData);
+    setNodeLayout(m_nodePageSize, m_entriesPerNode);
+    std::array<uint8_t, k_headerSize + k_nodeLayoutSize + k_hashIndexFieldSize + k_dirFiltersFieldSize +
+                        2 * SkipListNode::binHeadSize()> headerData{};
+    auto buf = boost::asio::buffer(headerData.data(), m_rootListOffset + 2 * m_headSize);
     OutputBinBuffer out(buf);
     s_magic.serialize(out);
     s_currentVersion.serialize(out);
     out.writeU64(0);
     out.writeU64(0);
+    out.writeU32(static_cast<uint32_t>(m_nodePageSize));
+    out.writeU32(static_cast<uint32_t>(m_entriesPerNode));
+    //offsets of hash index and dir filters are written once they are created
+    out.writeU64(0);
+    out.writeU64(0);
     SkipListNode rootNode;
-    rootNode.nexts.resize(k_maxListHeight);
+    rootNode.nexts.resize(dirHeadHeight());
     storeHeadNode(out, rootNode);
-    m_mainFile->write(buf);
+    SkipListNode expirationIndexNode;
+    expirationIndexNode.nexts.resize(dirHeadHeight());
+    storeHeadNode(out, expirationIndexNode);
+    m_mainFile->writeAt(0, buf);
+    m_expirationIndexOffset = m_rootListOffset + m_headSize;
+    m_fileEnd = m_expirationIndexOffset + m_headSize;
+    if(m_nodePageSize)
+    {
+        //the rest of the first page is used for head nodes
+        m_headPageOffset = m_fileEnd;
+        m_headPageEnd = m_nodePageSize;
+        m_fileEnd = m_nodePageSize;
+    }
+    if(m_createHashIndex)
+    {
+        createHashIndex();
+    }
+    if(m_createDirFilters)
+    {
+        m_dirFiltersOffset = createDirHeadNode();
+        writeUIntAt(*m_mainFile, k_headerSize + k_nodeLayoutSize + k_hashIndexFieldSize, m_dirFiltersOffset);
+    }
+}
+
+void StorageVolumeImpl::setNodeLayout(size_t pageSize, size_t entriesCount)
+{
+    if(pageSize && ((pageSize & (pageSize - 1)) != 0 || pageSize > k_maxNodePageSize))
+    {
+        throw std::runtime_error(fmt::format("StorageVolume:: invalid node page size {} of {}",
+                pageSize, m_mainFile->getFilename().string()));
+    }
+    if(!entriesCount)
+    {
+        entriesCount = k_defaultEntriesPerNode;
+        if(pageSize)
+        {
+            entriesCount = std::min((pageSize - m_headSize - 1/*entries*/) / m_entrySize, k_maxEntriesPerNode);
+        }
+    }
+    m_nodeSize = SkipListNode::binSize(m_headSize, m_entrySize, entriesCount);
+    if(entriesCount < k_minEntriesPerNode || entriesCount > k_maxEntriesPerNode || (pageSize && m_nodeSize > pageSize))
+    {
+        throw std::runtime_error(fmt::format("StorageVolume:: invalid number of entries per node {} of {}, page size={}",
+                entriesCount, m_mainFile->getFilename().string(), pageSize));
+    }
+    m_nodePageSize = pageSize;
+    m_entriesPerNode = entriesCount;
+    m_nodeAllocSize = pageSize ? pageSize : m_nodeSize;
 }
 
 StorageVolumeImpl::LoggerType& StorageVolumeImpl::getLogger()
@@ -485,13 +1128,76 @@ StorageVolumeImpl::LoggerType& StorageVolumeImpl::getLogger()
     return m_log;
 }
 
+uint32_t StorageVolumeImpl::keyHash(const boost::string_view& key)
+{
+    //FNV-1a, hash is stored in file, so it must not depend on platform
+    uint32_t rv = 2166136261u;
+    for(char c:key)
+    {
+        rv ^= static_cast<uint8_t>(c);
+        rv *= 16777619u;
+    }
+    return rv;
+}
+
+bool StorageVolumeImpl::compareKeyFingerprint(const KeyInfo& key, const boost::string_view& value, int& result)
+{
+    if(key.loaded)
+    {
+        result = boost::string_view(key.value).compare(value);
+        return true;
+    }
+    if(!key.hasFingerprint)
+    {
+        return false;
+    }
+    //external key is longer than prefix
+    result = key.prefixView().compare(value.substr(0, k_keyPrefixSize));
+    if(result != 0)
+    {
+        return true;
+    }
+    if(value.length() <= k_keyPrefixSize)
+    {
+        result = 1;
+        return true;
+    }
+    return false;
+}
+
+bool StorageVolumeImpl::mayBeSameKey(const KeyInfo& key, const boost::string_view& value)
+{
+    if(key.loaded)
+    {
+        return key.value == value;
+    }
+    if(!key.hasFingerprint)
+    {
+        return true;
+    }
+    return key.length == value.length() && key.hash == keyHash(value) &&
+           key.prefixView() == value.substr(0, k_keyPrefixSize);
+}
+
+int StorageVolumeImpl::compareKey(KeyInfo& key, const boost::string_view& value)
+{
+    int rv;
+    if(compareKeyFingerprint(key, value, rv))
+    {
+        return rv;
+    }
+    return boost::string_view(loadKeyDelayed(key)).compare(value);
+}
+
 void StorageVolumeImpl::storeKey(OutputBinBuffer& out, KeyInfo& key)
 {
-    if(isInplaceLength(key.value.length()))
+    size_t keyBinSize = m_keyFingerprints ? KeyInfo::binSize() : KeyInfo::noFingerprintBinSize();
+    if(isInplaceLength(key.size()))
     {
         std::array<uint8_t, k_inplaceSize> data{};
         std::copy(key.value.begin(), key.value.end(), data.begin());
         out.writeArray(data);
+        out.fill(keyBinSize - k_inplaceSize);
         return;
     }
 
@@ -509,8 +1215,26 @@ void StorageVolumeImpl::storeKey(OutputBinBuffer& out, KeyInfo& key)
             key.offset = m_bigStorage->allocateAndWrite(boost::asio::buffer(key.value));
         }
     }
-    out.writeU64(key.value.length());
+    if(!m_keyFingerprints)
+    {
+        out.writeU64(key.size());
+        out.writeU64(key.offset);
+        return;
+    }
+    if(key.loaded)
+    {
+        if(key.value.length() > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::runtime_error(fmt::format("StorageVolume:: key is too long, length={}", key.value.length()));
+        }
+        key.hasFingerprint = true;
+        key.hash = keyHash(key.value);
+        std::copy(key.value.begin(), key.value.begin() + k_keyPrefixSize, key.prefix.begin());
+    }
+    out.writeU32(static_cast<uint32_t>(key.size()));
+    out.writeU32(key.hash);
     out.writeU64(key.offset);
+    out.writeArray(key.prefix);
 }
 
 void StorageVolumeImpl::loadKey(InputBinBuffer& in, bool isInplace, KeyInfo& key)
@@ -518,29 +1242,58 @@ void StorageVolumeImpl::loadKey(InputBinBuffer& in, bool isInplace, KeyInfo& key
     if(isInplace)
     {
         loadInplaceString(in, key.value);
+        key.loaded = true;
+        key.offset = 0;
+        key.hasFingerprint = false;
+        if(m_keyFingerprints)
+        {
+            in.skip(KeyInfo::binSize() - k_inplaceSize);
+        }
         return;
     }
-    auto keyLength = static_cast<size_t>(in.readU64());
     //some sane key length limit check?
-    key.value.resize(keyLength);
-
-    key.offset = in.readU64();
-    if(isSmallToMediumLenght(keyLength))
+    if(m_keyFingerprints)
     {
-        m_stmStorage->read(key.offset, boost::asio::buffer(key.value));
+        key.length = in.readU32();
+        key.hash = in.readU32();
+        key.offset = in.readU64();
+        in.readArray(key.prefix);
+        key.hasFingerprint = true;
     }
     else
     {
-        m_bigStorage->read(key.offset, boost::asio::buffer(key.value));
+        key.length = static_cast<size_t>(in.readU64());
+        key.offset = in.readU64();
     }
+    key.loaded = false;
+    key.value.clear();
 }
 
-void StorageVolumeImpl::loadInplaceString(InputBinBuffer& in, std::string& value)
+const std::string& StorageVolumeImpl::loadKeyDelayed(KeyInfo& key)
 {
-    std::array<uint8_t, k_inplaceSize> data{};
-    in.readArray(data);
-    //If there is no zero, all 16 bytes are used, find
-    //will return end, end - begin = 16, all 16 bytes will be assigned to string.
+    if(key.loaded)
+    {
+        return key.value;
+    }
+    key.value.resize(key.length);
+    if(isSmallToMediumLenght(key.length))
+    {
+        m_stmStorage->read(key.offset, boost::asio::buffer(key.value));
+    }
+    else
+    {
+        m_bigStorage->read(key.offset, boost::asio::buffer(key.value));
+    }
+    key.loaded = true;
+    return key.value;
+}
+
+void StorageVolumeImpl::loadInplaceString(InputBinBuffer& in, std::string& value)
+{
+    std::array<uint8_t, k_inplaceSize> data{};
+    in.readArray(data);
+    //If there is no zero, all 16 bytes are used, find
+    //will return end, end - begin = 16, all 16 bytes will be assigned to string.
     auto zeroPos = std::find(data.begin(), data.end(), 0) - data.begin();
     value.assign(reinterpret_cast<const char*>(data.data()), zeroPos);
 }
@@ -622,12 +1375,15 @@ void StorageVolumeImpl::storeValueType(OutputBinBuffer& out, ValueInfo& info, co
         else if(isSmallToMediumLenght(oldSize))
         {
             m_stmStorage->freeSlot(info.offset, oldSize);
+            m_freedSize += oldSize;
         }
         else
         {
             m_bigStorage->free(info.offset);
+            m_freedSize += oldSize;
         }
         info.offset = 0;
+        info.previousSize = 0;
     }
     if(isInplaceValueLength(newSize))
     {
@@ -676,12 +1432,15 @@ void StorageVolumeImpl::storeValueType(OutputBinBuffer& out, ValueInfo& info, co
         else if(isSmallToMediumLenght(oldSize))
         {
             m_stmStorage->freeSlot(info.offset, oldSize);
+            m_freedSize += oldSize;
         }
         else
         {
             m_bigStorage->free(info.offset);
+            m_freedSize += oldSize;
         }
         info.offset = 0;
+        info.previousSize = 0;
     }
     if(isInplaceValueLength(newSize))
     {
@@ -839,6 +1598,30 @@ void StorageVolumeImpl::loadValueDelayed(ValueInfo& value)
     }
 }
 
+void StorageVolumeImpl::loadValuesDelayed(const std::vector<ValueInfo*>& values)
+{
+    std::vector<IRandomAccessFile::ReadRequest> requests;
+    for(auto value : values)
+    {
+        if(!isSmallToMediumLenght(value->previousSize))
+        {
+            loadValueDelayed(*value);
+        }
+        else if(value->typeIdx == ValueTypeIndex::idx_string)
+        {
+            value->value = std::string(value->previousSize, ' ');
+            requests.push_back({value->offset, boost::asio::buffer(boost::get<std::string&>(value->value))});
+        }
+        else if(value->typeIdx == ValueTypeIndex::idx_vector)
+        {
+            value->value = std::vector<uint8_t>(value->previousSize, 0);
+            requests.push_back(
+                {value->offset, boost::asio::buffer(boost::get<std::vector<uint8_t>&>(value->value))});
+        }
+    }
+    m_stmStorage->readMany(requests);
+}
+
 void StorageVolumeImpl::storeEntry(OutputBinBuffer& out, Entry& entry)
 {
     uint8_t flags = 0;
@@ -846,7 +1629,7 @@ void StorageVolumeImpl::storeEntry(OutputBinBuffer& out, Entry& entry)
     {
         flags |= static_cast<uint8_t>(EntryFlags::dir);
     }
-    if(isInplaceLength(entry.key.value.length()))
+    if(isInplaceLength(entry.key.size()))
     {
         flags |= static_cast<uint8_t>(EntryFlags::inplaceKey);
     }
@@ -892,20 +1675,18 @@ void StorageVolumeImpl::loadEntry(InputBinBuffer& in, Entry& entry)
     loadValue(in, typeIndex, inplaceValue, entry.value);
 }
 
-void StorageVolumeImpl::loadEntryKey(InputBinBuffer& in, std::string& key)
+void StorageVolumeImpl::loadEntryKey(InputBinBuffer& in, KeyInfo& key)
 {
     uint8_t flags = in.readU8();
     in.skip(8);//expiration date
     bool inplaceKey = (flags & static_cast<uint8_t>(EntryFlags::inplaceKey)) != 0;
-    KeyInfo info;
-    loadKey(in, inplaceKey, info);
-    key = std::move(info.value);
-    in.skip(16);//value
+    loadKey(in, inplaceKey, key);
+    in.skip(ValueInfo::binSize());
 }
 
 void StorageVolumeImpl::freeEntry(Entry& entry)
 {
-    size_t keyLength = entry.key.value.length();
+    size_t keyLength = entry.key.size();
     if(isInplaceLength(keyLength))
     {
         //do nothing
@@ -913,10 +1694,12 @@ void StorageVolumeImpl::freeEntry(Entry& entry)
     else if(isSmallToMediumLenght(keyLength))
     {
         m_stmStorage->freeSlot(entry.key.offset, keyLength);
+        m_freedSize += keyLength;
     }
     else //big
     {
         m_bigStorage->free(entry.key.offset);
+        m_freedSize += keyLength;
     }
     if(entry.type == EntryType::key)
     {
@@ -928,14 +1711,108 @@ void StorageVolumeImpl::freeEntry(Entry& entry)
         else if(isSmallToMediumLenght(valueLength))
         {
             m_stmStorage->freeSlot(entry.value.offset, valueLength);
+            m_freedSize += valueLength;
         }
         else //big
         {
             m_bigStorage->free(entry.value.offset);
+            m_freedSize += valueLength;
+        }
+    }
+}
+
+StorageVolumeImpl::EntriesVector::iterator
+StorageVolumeImpl::findEntry(OffsetType nodeOffset, SkipListNode& node, const boost::string_view& key)
+{
+    bool fetched = false;
+    auto isLess = [this, &fetched](Entry& entry, const boost::string_view& value) {
+        bool loaded = entry.key.loaded;
+        bool rv = compareKey(entry.key, value) < 0;
+        fetched = fetched || loaded != entry.key.loaded;
+        return rv;
+    };
+    auto it = std::lower_bound(node.entries.begin(), node.entries.end(), key, isLess);
+    if(it != node.entries.end() && !it->key.loaded && mayBeSameKey(it->key, key))
+    {
+        loadKeyDelayed(it->key);
+        fetched = true;
+    }
+    if(fetched)
+    {
+        cacheLoadedKeys(nodeOffset, node);
+    }
+    return it;
+}
+
+void StorageVolumeImpl::loadNodeKeys(OffsetType nodeOffset, SkipListNode& node)
+{
+    bool fetched = false;
+    //keys from small to medium storage are read in one batch
+    std::vector<IRandomAccessFile::ReadRequest> requests;
+    for(auto& entry:node.entries)
+    {
+        auto& key = entry.key;
+        if(key.loaded)
+        {
+            continue;
+        }
+        fetched = true;
+        if(isSmallToMediumLenght(key.length))
+        {
+            key.value.resize(key.length);
+            requests.push_back({key.offset, boost::asio::buffer(key.value)});
+        }
+        else
+        {
+            loadKeyDelayed(key);
+        }
+    }
+    if(!fetched)
+    {
+        return;
+    }
+    m_stmStorage->readMany(requests);
+    for(auto& entry:node.entries)
+    {
+        entry.key.loaded = true;
+    }
+    cacheLoadedKeys(nodeOffset, node);
+}
+
+void StorageVolumeImpl::cacheLoadedKeys(OffsetType nodeOffset, const SkipListNode& node)
+{
+    NodeCacheLock lock(m_nodeCacheMtx);
+    auto item = findCachedNode(nodeOffset);
+    if(!item || item->headOnly || item->node.entries.size() != node.entries.size())
+    {
+        return;
+    }
+    for(size_t i = 0; i < node.entries.size(); ++i)
+    {
+        auto& cachedKey = item->node.entries[i].key;
+        auto& key = node.entries[i].key;
+        if(!cachedKey.loaded && key.loaded && cachedKey.offset == key.offset)
+        {
+            cachedKey = key;
         }
     }
 }
 
+void StorageVolumeImpl::cacheLoadedKey(OffsetType nodeOffset, size_t index, const KeyInfo& key)
+{
+    NodeCacheLock lock(m_nodeCacheMtx);
+    auto item = findCachedNode(nodeOffset);
+    if(!item || item->headOnly || index >= item->node.entries.size())
+    {
+        return;
+    }
+    auto& cachedKey = item->node.entries[index].key;
+    if(!cachedKey.loaded && cachedKey.offset == key.offset)
+    {
+        cachedKey = key;
+    }
+}
+
 StorageVolumeImpl::OffsetType StorageVolumeImpl::allocateSkipListHeadNode()
 {
     if(m_firstFreeHeadListNode)
@@ -944,14 +1821,28 @@ StorageVolumeImpl::OffsetType StorageVolumeImpl::allocateSkipListHeadNode()
         readUIntAt(*m_mainFile, m_firstFreeHeadListNode, m_firstFreeHeadListNode);
         return rv;
     }
-    return m_mainFile->seekEnd();
+    if(m_nodePageSize)
+    {
+        if(m_headPageEnd - m_headPageOffset < m_headSize)
+        {
+            m_headPageOffset = m_fileEnd;
+            m_fileEnd += m_nodePageSize;
+            m_headPageEnd = m_fileEnd;
+        }
+        OffsetType rv = m_headPageOffset;
+        m_headPageOffset += m_headSize;
+        return rv;
+    }
+    OffsetType rv = m_fileEnd;
+    m_fileEnd += m_headSize;
+    return rv;
 }
 
-StorageVolumeImpl::OffsetType StorageVolumeImpl::createSkipListHeadNode()
+StorageVolumeImpl::OffsetType StorageVolumeImpl::createDirHeadNode()
 {
     OffsetType offset = allocateSkipListHeadNode();
     SkipListNode headNode;
-    headNode.nexts.resize(k_maxListHeight, 0);
+    headNode.nexts.resize(dirHeadHeight(), 0);
     storeHeadNode(offset, headNode);
     return offset;
 }
@@ -965,30 +1856,266 @@ StorageVolumeImpl::OffsetType StorageVolumeImpl::allocateSkipListNode()
         readUIntAt(*m_mainFile, m_firstFreeListNode, m_firstFreeListNode);
         return rv;
     }
-    return m_mainFile->seekEnd();
+    OffsetType rv = m_fileEnd;
+    m_fileEnd += m_nodeAllocSize;
+    return rv;
 }
 
 void StorageVolumeImpl::freeSkipListHeadNode(OffsetType offset)
 {
+    dropCachedNode(offset);
     writeUIntAt(*m_mainFile, offset, m_firstFreeHeadListNode);
     m_firstFreeHeadListNode = offset;
+    m_freedSize += m_headSize;
 }
 
 void StorageVolumeImpl::freeSkipListNode(OffsetType offset)
 {
+    dropCachedNode(offset);
     writeUIntAt(*m_mainFile, offset, m_firstFreeListNode);
     m_firstFreeListNode = offset;
+    m_freedSize += m_nodeAllocSize;
+}
+
+
+uint8_t StorageVolumeImpl::nodeCachePriority(size_t listHeight)
+{
+    //list heads and inner nodes of trees
+    if(listHeight == k_maxListHeight || listHeight == 0)
+    {
+        return 0;
+    }
+    return listHeight > 1 ? 1 : 2;
+}
+
+StorageVolumeImpl::NodeCacheItem* StorageVolumeImpl::findCachedNode(OffsetType offset)
+{
+    auto it = m_nodeCacheMap.find(offset);
+    if(it == m_nodeCacheMap.end())
+    {
+        return nullptr;
+    }
+    m_nodeCachePool.touch(it->second);
+    return it->second;
+}
+
+StorageVolumeImpl::NodeCacheItem*
+StorageVolumeImpl::allocateCachedNode(OffsetType offset, size_t listHeight, bool headOnly)
+{
+    auto item = m_nodeCachePool.allocate(nodeCachePriority(listHeight));
+    if(!item)
+    {
+        return nullptr;
+    }
+    item->offset = offset;
+    item->data.resize(m_nodeSize);
+    item->headOnly = headOnly;
+    item->dirtySize = 0;
+    item->node.entries.clear();
+    m_nodeCacheMap[offset] = item;
+    return item;
+}
+
+void StorageVolumeImpl::writeCachedNode(NodeCacheItem& item)
+{
+    if(!item.dirtySize)
+    {
+        return;
+    }
+    m_mainFile->writeAt(item.offset, boost::asio::buffer(item.data.data(), item.dirtySize));
+    item.dirtySize = 0;
+}
+
+void StorageVolumeImpl::dropCachedNode(OffsetType offset)
+{
+    NodeCacheLock lock(m_nodeCacheMtx);
+    m_evictedNodes.erase(offset);
+    auto it = m_nodeCacheMap.find(offset);
+    if(it == m_nodeCacheMap.end())
+    {
+        return;
+    }
+    m_nodeCachePool.free(it->second);
+    m_nodeCacheMap.erase(it);
+}
+
+void StorageVolumeImpl::cachedNodeReuseNotify(NodeCacheItem* item)
+{
+    if(item->dirtySize)
+    {
+        //head only node is merged with previously evicted full node, if any
+        auto& data = m_evictedNodes[item->offset];
+        data.resize(std::max(data.size(), item->dirtySize));
+        std::copy(item->data.begin(), item->data.begin() + item->dirtySize, data.begin());
+        item->dirtySize = 0;
+    }
+    m_nodeCacheMap.erase(item->offset);
+}
+
+void StorageVolumeImpl::writeEvictedNodes()
+{
+    for(auto& p:m_evictedNodes)
+    {
+        m_mainFile->writeAt(p.first, boost::asio::buffer(p.second));
+    }
+    m_evictedNodes.clear();
+}
+
+template<size_t N>
+boost::asio::const_buffer StorageVolumeImpl::readNodeData(OffsetType offset, std::array<uint8_t, N>& storage,
+                                                          size_t size)
+{
+    std::vector<uint8_t> pending;
+    {
+        NodeCacheLock lock(m_nodeCacheMtx);
+        auto evictedIt = m_evictedNodes.find(offset);
+        if(evictedIt != m_evictedNodes.end())
+        {
+            pending = evictedIt->second;
+        }
+        auto cachedIt = m_nodeCacheMap.find(offset);
+        if(cachedIt != m_nodeCacheMap.end() && cachedIt->second->dirtySize)
+        {
+            auto& item = *cachedIt->second;
+            pending.resize(std::max(pending.size(), item.dirtySize));
+            std::copy(item.data.begin(), item.data.begin() + item.dirtySize, pending.begin());
+        }
+    }
+    if(pending.size() >= size)
+    {
+        //node might have never been written to file
+        std::copy(pending.begin(), pending.begin() + size, storage.begin());
+        return boost::asio::buffer(storage.data(), size);
+    }
+    auto buf = readAtOrView(*m_mainFile, offset, storage, size);
+    if(pending.empty())
+    {
+        return buf;
+    }
+    if(buf.data() != storage.data())
+    {
+        memcpy(storage.data(), buf.data(), size);
+    }
+    std::copy(pending.begin(), pending.end(), storage.begin());
+    return boost::asio::buffer(storage.data(), size);
+}
+
+void StorageVolumeImpl::unloadExternalValues(EntriesVector& entries)
+{
+    //keep cached nodes in the same state as freshly loaded ones,
+    //so big values aren't held in memory
+    for(auto& entry:entries)
+    {
+        if(entry.type != EntryType::key || !entry.value.loaded)
+        {
+            continue;
+        }
+        auto typeIdx = boost::apply_visitor(ValueTypeIndexVisitor(), entry.value.value);
+        if(typeIdx != ValueTypeIndex::idx_string && typeIdx != ValueTypeIndex::idx_vector)
+        {
+            continue;
+        }
+        size_t length = calcValueLength(entry.value);
+        if(isInplaceValueLength(length))
+        {
+            continue;
+        }
+        entry.value.typeIdx = typeIdx;
+        entry.value.previousSize = length;
+        entry.value.loaded = false;
+        entry.value.value = ValueType{};
+    }
+}
+
+void StorageVolumeImpl::flush()
+{
+    writeCachedNodes();
+    if(m_wal)
+    {
+        m_wal->sync();
+    }
+}
+
+bool StorageVolumeImpl::hasUnsyncedChanges()
+{
+    if(m_wal)
+    {
+        //cached nodes are written to log on each commit
+        return m_wal->hasPendingChanges();
+    }
+    NodeCacheLock lock(m_nodeCacheMtx);
+    if(!m_evictedNodes.empty())
+    {
+        return true;
+    }
+    for(auto& p : m_nodeCacheMap)
+    {
+        if(p.second->dirtySize)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void StorageVolumeImpl::commitOperation()
+{
+    if(!m_wal)
+    {
+        //nodes evicted by operation itself are written right away
+        NodeCacheLock lock(m_nodeCacheMtx);
+        writeEvictedNodes();
+        return;
+    }
+    //modified nodes must get into the same log group as the rest of operation changes
+    writeCachedNodes();
+    m_wal->commit();
 }
 
+void StorageVolumeImpl::writeCachedNodes()
+{
+    NodeCacheLock lock(m_nodeCacheMtx);
+    //cached head of evicted node is newer than evicted data
+    writeEvictedNodes();
+    std::vector<NodeCacheItem*> dirtyItems;
+    for(auto& p:m_nodeCacheMap)
+    {
+        if(p.second->dirtySize)
+        {
+            dirtyItems.push_back(p.second);
+        }
+    }
+    std::sort(dirtyItems.begin(), dirtyItems.end(), [](const NodeCacheItem* l, const NodeCacheItem* r) {
+        return l->offset < r->offset;
+    });
+    for(auto item:dirtyItems)
+    {
+        writeCachedNode(*item);
+    }
+}
 
 void StorageVolumeImpl::storeNode(OffsetType offset, StorageVolumeImpl::SkipListNode& node)
 {
     std::array<uint8_t, SkipListNode::binSize()> data{};
-    auto buf = boost::asio::buffer(data);
+    auto buf = boost::asio::buffer(data.data(), m_nodeSize);
     OutputBinBuffer out(buf);
     storeNode(out, node);
-    m_mainFile->seek(offset);
-    m_mainFile->write(buf);
+    NodeCacheLock lock(m_nodeCacheMtx);
+    auto item = findCachedNode(offset);
+    if(!item)
+    {
+        item = allocateCachedNode(offset, node.nexts.size(), false);
+    }
+    if(!item)
+    {
+        m_mainFile->writeAt(offset, buf);
+        return;
+    }
+    item->headOnly = false;
+    item->node = node;
+    unloadExternalValues(item->node.entries);
+    std::copy(data.begin(), data.begin() + m_nodeSize, item->data.begin());
+    item->dirtySize = m_nodeSize;
 }
 
 void StorageVolumeImpl::storeNode(OutputBinBuffer& out, SkipListNode& node)
@@ -1000,27 +2127,48 @@ void StorageVolumeImpl::storeNode(OutputBinBuffer& out, SkipListNode& node)
     {
         storeEntry(out, entry);
     }
-    if(node.entries.size() < k_entriesPerNode)
+    if(node.entries.size() < m_entriesPerNode)
     {
-        out.fill((k_entriesPerNode - node.entries.size()) * Entry::binSize());
+        out.fill((m_entriesPerNode - node.entries.size()) * m_entrySize);
     }
 }
 
 void
 StorageVolumeImpl::store(boost::string_view keyPath, const StorageVolumeImpl::ValueType& value, TimePointOpt expTime)
 {
-    uint64_t expTimeMs = expTime ? std::chrono::duration_cast<std::chrono::milliseconds>(
-            (*expTime).time_since_epoch()).count() : 0;
-    store(keyPath, value, expTimeMs);
+    store(keyPath, value, expTimeToMilliseconds(expTime));
+    commitOperation();
+    if(isCopied(keyPath))
+    {
+        m_copyTarget->store(keyPath, value, expTime);
+    }
 }
 
-void StorageVolumeImpl::store(boost::string_view keyPath, const StorageVolumeImpl::ValueType& value, uint64_t expTime)
+StorageVolumeImpl::OffsetType
+StorageVolumeImpl::lookupKeyDir(boost::string_view keyPath, const PathAndKey& pathKey)
 {
-    auto pathKey = splitKeyPath(keyPath);
-    OffsetType offset = k_rootListOffset;
-    if(m_lastDirHeadOffset != 0 && keyPath.compare(0, keyPath.length() - pathKey.key.length(), m_lastDir) == 0)
+    if(isLastDir(keyPath, pathKey))
+    {
+        return m_lastDirHeadOffset;
+    }
+    return followPath(pathKey.path);
+}
+
+StorageVolumeImpl::OffsetType
+StorageVolumeImpl::findKeyDir(boost::string_view keyPath, const PathAndKey& pathKey, bool create)
+{
+    if(isLastDir(keyPath, pathKey))
     {
-        offset = m_lastDirHeadOffset;
+        return m_lastDirHeadOffset;
+    }
+    OffsetType offset = m_rootListOffset;
+    if(!create)
+    {
+        offset = followPath(pathKey.path);
+        if(!offset)
+        {
+            return 0;
+        }
     }
     else
     {
@@ -1029,9 +2177,10 @@ void StorageVolumeImpl::store(boost::string_view keyPath, const StorageVolumeImp
             Entry entry;
             if(!listLookup(offset, dir, entry))
             {
-                OffsetType newDirOffset = createSkipListHeadNode();
+                OffsetType newDirOffset = createDirHeadNode();
                 entry.setDir(std::string(dir.data(), dir.length()), newDirOffset);
                 listInsert(offset, std::move(entry));
+                dirFilterAdd(offset, dir);
                 offset = newDirOffset;
             }
             else
@@ -1044,32 +2193,43 @@ void StorageVolumeImpl::store(boost::string_view keyPath, const StorageVolumeImp
                 offset = boost::get<uint64_t>(entry.value.value);
             }
         }
-        m_lastDir.assign(keyPath.data(), 0, keyPath.length() - pathKey.key.length());
-        m_lastDirHeadOffset = offset;
     }
+    m_lastDir.assign(keyPath.data(), 0, keyPath.length() - pathKey.key.length());
+    m_lastDirHeadOffset = offset;
+    return offset;
+}
+
+void StorageVolumeImpl::store(boost::string_view keyPath, const StorageVolumeImpl::ValueType& value, uint64_t expTime)
+{
+    auto pathKey = splitKeyPath(keyPath);
+    OffsetType offset = findKeyDir(keyPath, pathKey, true);
     Entry keyEntry;
     keyEntry.setValue(std::string(pathKey.key.data(), pathKey.key.length()), value);
     keyEntry.expirationDateTime = expTime;
-    listInsert(offset, std::move(keyEntry));
+    if(listInsert(offset, std::move(keyEntry)))
+    {
+        dirFilterAdd(offset, pathKey.key);
+    }
+    if(expTime)
+    {
+        addToExpirationIndex(keyPath, expTime);
+    }
 }
 
 boost::optional<StorageVolumeImpl::ValueType> StorageVolumeImpl::lookup(boost::string_view keyPath)
+{
+    TimePointOpt expTime;
+    return lookup(keyPath, expTime);
+}
+
+boost::optional<StorageVolumeImpl::ValueType>
+StorageVolumeImpl::lookup(boost::string_view keyPath, TimePointOpt& expTime)
 {
     auto pathKey = splitKeyPath(keyPath);
-    OffsetType offset;
-    if(m_lastDirHeadOffset != 0 && keyPath.compare(0, keyPath.length() - pathKey.key.length(), m_lastDir) == 0)
-    {
-        offset = m_lastDirHeadOffset;
-    }
-    else
+    OffsetType offset = lookupKeyDir(keyPath, pathKey);
+    if(!offset || !dirFilterMayContain(offset, pathKey.key))
     {
-        offset = followPath(pathKey.path);
-        if(!offset)
-        {
-            return {};
-        }
-        m_lastDir.assign(keyPath.data(), 0, keyPath.length() - pathKey.key.length());
-        m_lastDirHeadOffset = offset;
+        return {};
     }
     Entry keyEntry;
     if(!listLookup(offset, pathKey.key, keyEntry))
@@ -1084,13 +2244,84 @@ boost::optional<StorageVolumeImpl::ValueType> StorageVolumeImpl::lookup(boost::s
     {
         loadValueDelayed(keyEntry.value);
     }
+    expTime = millisecondsToExpTime(keyEntry.expirationDateTime);
     return {keyEntry.value.value};
 }
 
+std::vector<boost::optional<StorageVolumeImpl::ValueType>>
+StorageVolumeImpl::lookupMany(const std::vector<boost::string_view>& keyPaths)
+{
+    std::vector<boost::optional<ValueType>> rv(keyPaths.size());
+    auto items = sortByDirAndKey(keyPaths);
+    auto now = nowInMilliseconds();
+    std::vector<boost::string_view> dirKeys;
+    //index in keyPaths of each of dirKeys
+    std::vector<size_t> dirKeyItems;
+    //index in keyPaths and value of found keys with external values
+    std::vector<std::pair<size_t, ValueInfo>> delayedValues;
+    for(auto groupBegin = items.begin(); groupBegin != items.end();)
+    {
+        auto groupEnd = std::find_if(groupBegin, items.end(), [groupBegin](const DirAndKey& item) {
+            return item.dir != groupBegin->dir;
+        });
+        auto keyPath = keyPaths[groupBegin->index];
+        OffsetType offset = lookupKeyDir(keyPath, splitKeyPath(keyPath));
+        if(offset)
+        {
+            dirKeys.clear();
+            dirKeyItems.clear();
+            for(auto it = groupBegin; it != groupEnd; ++it)
+            {
+                if(dirFilterMayContain(offset, it->key))
+                {
+                    dirKeys.push_back(it->key);
+                    dirKeyItems.push_back(it->index);
+                }
+            }
+            listLookupSorted(offset, dirKeys, [&rv, &dirKeyItems, &delayedValues, now](size_t idx, Entry& entry) {
+                if(entry.type != EntryType::key ||
+                   (entry.expirationDateTime != 0 && entry.expirationDateTime < now))
+                {
+                    return;
+                }
+                if(!entry.value.loaded)
+                {
+                    delayedValues.emplace_back(dirKeyItems[idx], std::move(entry.value));
+                    return;
+                }
+                rv[dirKeyItems[idx]] = std::move(entry.value.value);
+            });
+        }
+        groupBegin = groupEnd;
+    }
+    //external values of all found keys are fetched at once
+    std::vector<ValueInfo*> values;
+    for(auto& item : delayedValues)
+    {
+        values.push_back(&item.second);
+    }
+    loadValuesDelayed(values);
+    for(auto& item : delayedValues)
+    {
+        rv[item.first] = std::move(item.second.value);
+    }
+    return rv;
+}
+
 void StorageVolumeImpl::eraseKey(boost::string_view keyPath)
+{
+    eraseKeyNoCommit(keyPath);
+    commitOperation();
+    if(isCopied(keyPath))
+    {
+        m_copyTarget->eraseKey(keyPath);
+    }
+}
+
+void StorageVolumeImpl::eraseKeyNoCommit(boost::string_view keyPath)
 {
     auto pathKey = splitKeyPath(keyPath);
-    OffsetType offset = followPath(pathKey.path);
+    OffsetType offset = findKeyDir(keyPath, pathKey, false);
     if(!offset)
     {
         return;
@@ -1098,16 +2329,359 @@ void StorageVolumeImpl::eraseKey(boost::string_view keyPath)
     listErase(offset, EntryType::key, pathKey.key);
 }
 
-void StorageVolumeImpl::eraseDirRecursive(boost::string_view dirPath)
+void StorageVolumeImpl::expire(boost::string_view keyPath, uint64_t expTime)
 {
-    auto path = splitDirPath(dirPath);
-    if(path.empty() || path.back().length() == 0)
+    auto pathKey = splitKeyPath(keyPath);
+    OffsetType offset = findKeyDir(keyPath, pathKey, false);
+    if(!offset)
     {
         return;
     }
-    m_lastDir.clear();
-    m_lastDirHeadOffset = 0;
-    auto dir = path.back();
+    if(listSetExpiration(offset, pathKey.key, expTime) && expTime)
+    {
+        addToExpirationIndex(keyPath, expTime);
+    }
+}
+
+void StorageVolumeImpl::addToExpirationIndex(boost::string_view keyPath, uint64_t expTime)
+{
+    if(!m_expirationIndexOffset)
+    {
+        return;
+    }
+    std::string bucketName = fmt::format("{:016x}", expTime / k_expirationBucketSize);
+    OffsetType bucketOffset;
+    Entry bucketEntry;
+    if(listLookup(m_expirationIndexOffset, bucketName, bucketEntry))
+    {
+        bucketOffset = boost::get<uint64_t>(bucketEntry.value.value);
+    }
+    else
+    {
+        bucketOffset = createDirHeadNode();
+        bucketEntry.setDir(std::move(bucketName), bucketOffset);
+        listInsert(m_expirationIndexOffset, std::move(bucketEntry));
+    }
+    Entry keyEntry;
+    keyEntry.setValue(std::string(keyPath.data(), keyPath.length()), expTime);
+    listInsert(bucketOffset, std::move(keyEntry));
+}
+
+StorageVolumeImpl::OffsetType StorageVolumeImpl::findExpiredBucket(uint64_t now, std::string& bucketName)
+{
+    if(!m_expirationIndexOffset)
+    {
+        return 0;
+    }
+    SkipListNode node;
+    loadHeadNode(m_expirationIndexOffset, node);
+    if(!node.nexts[0])
+    {
+        return 0;
+    }
+    loadNode(node.nexts[0], node);
+    auto& entry = node.entries.front();
+    loadKeyDelayed(entry.key);
+    uint64_t bucket = std::stoull(entry.key.value, nullptr, 16);
+    if((bucket + 1) * k_expirationBucketSize > now)
+    {
+        return 0;
+    }
+    bucketName = entry.key.value;
+    return boost::get<uint64_t>(entry.value.value);
+}
+
+void StorageVolumeImpl::eraseIfExpired(boost::string_view keyPath, uint64_t now)
+{
+    auto pathKey = splitKeyPath(keyPath);
+    //unlike followPath, changed type of path entry isn't an error here
+    OffsetType offset = m_rootListOffset;
+    Entry entry;
+    for(auto& dir:pathKey.path)
+    {
+        if(!listLookup(offset, dir, entry) || entry.type != EntryType::dir)
+        {
+            return;
+        }
+        offset = boost::get<uint64_t>(entry.value.value);
+    }
+    //key could be overwritten or its expiration changed after it was indexed
+    if(!listLookup(offset, pathKey.key, entry) || entry.type != EntryType::key ||
+       entry.expirationDateTime == 0 || entry.expirationDateTime >= now)
+    {
+        return;
+    }
+    listErase(offset, EntryType::key, pathKey.key);
+}
+
+bool StorageVolumeImpl::hasExpiredKeys()
+{
+    std::string bucketName;
+    return findExpiredBucket(nowInMilliseconds(), bucketName) != 0;
+}
+
+size_t StorageVolumeImpl::reapExpired(size_t maxEntries)
+{
+    auto now = nowInMilliseconds();
+    size_t processed = 0;
+    bool modified = false;
+    std::string bucketName;
+    SkipListNode node;
+    while(processed < maxEntries)
+    {
+        OffsetType bucketOffset = findExpiredBucket(now, bucketName);
+        if(!bucketOffset)
+        {
+            break;
+        }
+        modified = true;
+        loadHeadNode(bucketOffset, node);
+        if(!node.nexts[0])
+        {
+            listEraseRecursive(bucketOffset);
+            listErase(m_expirationIndexOffset, EntryType::dir, bucketName);
+            continue;
+        }
+        OffsetType nodeOffset = node.nexts[0];
+        loadNode(nodeOffset, node);
+        loadNodeKeys(nodeOffset, node);
+        for(auto& entry:node.entries)
+        {
+            if(processed == maxEntries)
+            {
+                break;
+            }
+            eraseIfExpired(entry.key.value, now);
+            listErase(bucketOffset, EntryType::key, entry.key.value);
+            ++processed;
+        }
+    }
+    if(modified)
+    {
+        commitOperation();
+    }
+    return processed;
+}
+
+StorageVolumeImpl::DirStructure StorageVolumeImpl::getDirStructure()
+{
+    return m_dirStructure;
+}
+
+size_t StorageVolumeImpl::getNodePageSize()
+{
+    return m_nodePageSize;
+}
+
+size_t StorageVolumeImpl::getNodeEntriesCount()
+{
+    return m_entriesPerNode;
+}
+
+bool StorageVolumeImpl::hasHashIndex()
+{
+    return m_hashIndexOffset != 0;
+}
+
+bool StorageVolumeImpl::hasDirFilters()
+{
+    return m_dirFiltersOffset != 0;
+}
+
+uint64_t StorageVolumeImpl::getFreedSize()
+{
+    return m_freedSize;
+}
+
+void StorageVolumeImpl::startCopy(StorageVolume& target)
+{
+    m_copyTarget = &target;
+    m_copyPosition.clear();
+    m_copyComplete = false;
+}
+
+bool StorageVolumeImpl::copyStep(size_t maxKeys)
+{
+    if(!m_copyTarget)
+    {
+        throw std::runtime_error("StorageVolume::copyStep: copy wasn't started.");
+    }
+    if(m_copyComplete)
+    {
+        return false;
+    }
+    WriteBatch batch;
+    std::vector<std::string> path;
+    m_copyComplete = copyDir(m_rootListOffset, path, !m_copyPosition.empty(), maxKeys, batch);
+    if(!batch.empty())
+    {
+        m_copyTarget->write(batch);
+    }
+    return !m_copyComplete;
+}
+
+void StorageVolumeImpl::stopCopy()
+{
+    m_copyTarget = nullptr;
+    m_copyPosition.clear();
+    m_copyComplete = false;
+}
+
+bool StorageVolumeImpl::isCopied(boost::string_view keyPath)
+{
+    if(!m_copyTarget)
+    {
+        return false;
+    }
+    if(m_copyComplete)
+    {
+        return true;
+    }
+    auto path = splitDirPath(keyPath);
+    //dir is visited before its entries that follow it in name order, so path order is order of copying
+    return !std::lexicographical_compare(m_copyPosition.begin(), m_copyPosition.end(), path.begin(), path.end(),
+            [](boost::string_view l, boost::string_view r) { return l < r; });
+}
+
+bool StorageVolumeImpl::copyDir(OffsetType headOffset, std::vector<std::string>& path, bool resume,
+                                size_t maxKeys, WriteBatch& batch)
+{
+    size_t depth = path.size();
+    std::string from = resume ? m_copyPosition[depth] : std::string();
+    auto now = nowInMilliseconds();
+    bool complete = true;
+    listScan(headOffset, from, [&](Entry& entry) {
+        bool resumeEntry = resume && entry.key.value == m_copyPosition[depth];
+        if(entry.type == EntryType::dir)
+        {
+            path.push_back(entry.key.value);
+            //entry of last copied key could be replaced by dir
+            complete = copyDir(boost::get<uint64_t>(entry.value.value), path,
+                    resumeEntry && m_copyPosition.size() > depth + 1, maxKeys, batch);
+            path.pop_back();
+            return complete;
+        }
+        if(resumeEntry || (entry.expirationDateTime != 0 && entry.expirationDateTime < now))
+        {
+            return true;
+        }
+        if(batch.getOps().size() == maxKeys)
+        {
+            complete = false;
+            return false;
+        }
+        if(!entry.value.loaded)
+        {
+            loadValueDelayed(entry.value);
+        }
+        std::string keyPath;
+        for(auto& dir:path)
+        {
+            keyPath += '/';
+            keyPath += dir;
+        }
+        keyPath += '/';
+        keyPath += entry.key.value;
+        batch.store(keyPath, entry.value.value, millisecondsToExpTime(entry.expirationDateTime));
+        m_copyPosition = path;
+        m_copyPosition.push_back(entry.key.value);
+        return true;
+    });
+    return complete;
+}
+
+StorageVolumeImpl::DirAndKeyVector
+StorageVolumeImpl::sortByDirAndKey(const std::vector<boost::string_view>& keyPaths)
+{
+    DirAndKeyVector rv;
+    rv.reserve(keyPaths.size());
+    for(size_t i = 0; i < keyPaths.size(); ++i)
+    {
+        auto keyPath = keyPaths[i];
+        auto keyPos = keyPath.rfind('/');
+        keyPos = keyPos == boost::string_view::npos ? 0 : keyPos + 1;
+        rv.push_back({keyPath.substr(0, keyPos), keyPath.substr(keyPos), i});
+    }
+    std::stable_sort(rv.begin(), rv.end(), [](const DirAndKey& l, const DirAndKey& r) {
+        int cmp = l.dir.compare(r.dir);
+        return cmp < 0 || (cmp == 0 && l.key < r.key);
+    });
+    return rv;
+}
+
+void StorageVolumeImpl::write(const WriteBatch& batch)
+{
+    auto& ops = batch.getOps();
+    std::vector<boost::string_view> keyPaths;
+    keyPaths.reserve(ops.size());
+    for(auto& op:ops)
+    {
+        keyPaths.emplace_back(op.keyPath);
+    }
+    //keys of the same dir are applied together in key order, so dir is looked up once
+    //and skip list nodes are visited sequentially while they are in node cache
+    auto items = sortByDirAndKey(keyPaths);
+    for(auto& item:items)
+    {
+        auto& op = ops[item.index];
+        switch(op.type)
+        {
+            case WriteBatch::OpType::store:
+                store(op.keyPath, op.value, expTimeToMilliseconds(op.expTime));
+                break;
+            case WriteBatch::OpType::eraseKey:
+                eraseKeyNoCommit(op.keyPath);
+                break;
+            case WriteBatch::OpType::expire:
+                expire(op.keyPath, expTimeToMilliseconds(op.expTime));
+                break;
+        }
+    }
+    //modified nodes are written to main file once for the whole batch
+    commitOperation();
+    if(m_copyTarget)
+    {
+        WriteBatch targetBatch;
+        for(auto& op:ops)
+        {
+            if(isCopied(op.keyPath))
+            {
+                switch(op.type)
+                {
+                    case WriteBatch::OpType::store:
+                        targetBatch.store(op.keyPath, op.value, op.expTime);
+                        break;
+                    case WriteBatch::OpType::eraseKey:
+                        targetBatch.eraseKey(op.keyPath);
+                        break;
+                    case WriteBatch::OpType::expire:
+                        targetBatch.expire(op.keyPath, op.expTime);
+                        break;
+                }
+            }
+        }
+        if(!targetBatch.empty())
+        {
+            m_copyTarget->write(targetBatch);
+        }
+    }
+}
+
+void StorageVolumeImpl::eraseDirRecursive(boost::string_view dirPath)
+{
+    //copied part of dir, if any, is erased from target
+    if(m_copyTarget)
+    {
+        m_copyTarget->eraseDirRecursive(dirPath);
+    }
+    auto path = splitDirPath(dirPath);
+    if(path.empty() || path.back().length() == 0)
+    {
+        return;
+    }
+    m_lastDir.clear();
+    m_lastDirHeadOffset = 0;
+    auto dir = path.back();
     path.pop_back();
     OffsetType offset = followPath(path);
     if(!offset)
@@ -1121,6 +2695,7 @@ void StorageVolumeImpl::eraseDirRecursive(boost::string_view dirPath)
     }
     listEraseRecursive(boost::get<uint64_t>(entry.value.value));
     listErase(offset, EntryType::dir, dir);
+    commitOperation();
 }
 
 boost::optional<std::vector<StorageVolumeImpl::DirEntry>> StorageVolumeImpl::getDirEntries(boost::string_view dirPath)
@@ -1136,34 +2711,129 @@ boost::optional<std::vector<StorageVolumeImpl::DirEntry>> StorageVolumeImpl::get
     return {std::move(rv)};
 }
 
+boost::optional<std::vector<StorageVolumeImpl::ScanEntry>>
+StorageVolumeImpl::scanDir(boost::string_view dirPath, const ScanOptions& options)
+{
+    auto path = splitDirPath(dirPath);
+    OffsetType offset = followPath(path);
+    if(!offset)
+    {
+        return {};
+    }
+    std::vector<ScanEntry> rv;
+    if(options.batchSize == 0)
+    {
+        return {std::move(rv)};
+    }
+    boost::string_view prefix = options.prefix;
+    boost::string_view from = std::max(boost::string_view(options.from), prefix);
+    auto now = nowInMilliseconds();
+    listScan(offset, from, [this, &rv, &options, prefix, now](Entry& entry) {
+        if(entry.key.value.compare(0, prefix.length(), prefix.data(), prefix.length()) != 0)
+        {
+            return false;
+        }
+        if(entry.expirationDateTime != 0 && entry.expirationDateTime < now)
+        {
+            return true;
+        }
+        rv.push_back({entry.type, std::move(entry.key.value), {}});
+        if(options.withValues && entry.type == EntryType::key)
+        {
+            if(!entry.value.loaded)
+            {
+                loadValueDelayed(entry.value);
+            }
+            rv.back().value = std::move(entry.value.value);
+        }
+        return rv.size() < options.batchSize;
+    });
+    return {std::move(rv)};
+}
+
 void StorageVolumeImpl::loadNode(OffsetType offset, SkipListNode& node)
 {
-    std::array<uint8_t, SkipListNode::binSize()> data{};
-    m_mainFile->seek(offset);
-    auto buf = boost::asio::buffer(data);
-    m_mainFile->read(buf);
-    InputBinBuffer in(buf);
+    {
+        NodeCacheLock lock(m_nodeCacheMtx);
+        auto item = findCachedNode(offset);
+        if(item && !item->headOnly)
+        {
+            node = item->node;
+            return;
+        }
+    }
+    //if only nexts are cached, entries are loaded from file and modified head is applied by readNodeData
+    std::array<uint8_t, SkipListNode::binSize()> data;
+    InputBinBuffer in(readNodeData(offset, data, m_nodeSize));
     loadNode(in, node);
+    NodeCacheLock lock(m_nodeCacheMtx);
+    auto item = findCachedNode(offset);
+    if(item && !item->headOnly)
+    {
+        //loaded by concurrent lookup
+        return;
+    }
+    if(!item)
+    {
+        item = allocateCachedNode(offset, node.nexts.size(), false);
+    }
+    if(item)
+    {
+        item->headOnly = false;
+        item->node = node;
+    }
 }
 
 void StorageVolumeImpl::loadHeadNode(OffsetType offset, SkipListNode& node)
 {
-    std::array<uint8_t, SkipListNode::binHeadSize()> data{};
-    m_mainFile->seek(offset);
-    auto buf = boost::asio::buffer(data);
-    m_mainFile->read(buf);
-    InputBinBuffer in(buf);
+    {
+        NodeCacheLock lock(m_nodeCacheMtx);
+        auto item = findCachedNode(offset);
+        if(item)
+        {
+            node.nexts = item->node.nexts;
+            node.nextOffset = item->node.nextOffset;
+            return;
+        }
+    }
+    std::array<uint8_t, SkipListNode::binHeadSize()> data;
+    InputBinBuffer in(readNodeData(offset, data, m_headSize));
     loadHeadNode(in, node);
+    NodeCacheLock lock(m_nodeCacheMtx);
+    if(m_nodeCacheMap.find(offset) != m_nodeCacheMap.end())
+    {
+        return;
+    }
+    auto item = allocateCachedNode(offset, node.nexts.size(), true);
+    if(item)
+    {
+        item->node.nexts = node.nexts;
+        item->node.nextOffset = node.nextOffset;
+    }
 }
 
 void StorageVolumeImpl::storeHeadNode(OffsetType offset, SkipListNode& node)
 {
     std::array<uint8_t, SkipListNode::binHeadSize()> data{};
-    auto buf = boost::asio::buffer(data);
+    auto buf = boost::asio::buffer(data.data(), m_headSize);
     OutputBinBuffer out(buf);
     storeHeadNode(out, node);
-    m_mainFile->seek(offset);
-    m_mainFile->write(buf);
+    NodeCacheLock lock(m_nodeCacheMtx);
+    auto item = findCachedNode(offset);
+    if(!item)
+    {
+        item = allocateCachedNode(offset, node.nexts.size(), true);
+    }
+    if(!item)
+    {
+        m_mainFile->writeAt(offset, buf);
+        return;
+    }
+    item->node.nexts = node.nexts;
+    item->node.nextOffset = node.nextOffset;
+    //head is the same for full and head only node, so full node stays valid with updated head
+    std::copy(data.begin(), data.begin() + m_headSize, item->data.begin());
+    item->dirtySize = std::max(item->dirtySize, m_headSize);
 }
 
 void StorageVolumeImpl::loadNode(InputBinBuffer& in, SkipListNode& node)
@@ -1175,7 +2845,7 @@ void StorageVolumeImpl::loadNode(InputBinBuffer& in, SkipListNode& node)
     {
         loadEntry(in, node.entries[i]);
     }
-    in.skip((k_entriesPerNode - entries) * Entry::binSize());
+    in.skip((m_entriesPerNode - entries) * m_entrySize);
 }
 
 void StorageVolumeImpl::loadHeadNode(InputBinBuffer& in, SkipListNode& node)
@@ -1194,6 +2864,15 @@ StorageVolumeImpl::OffsetType
 StorageVolumeImpl::loadNodeNexts(InputBinBuffer& in, uint8_t nextsCount, NextsVector& nexts)
 {
     nexts.resize(nextsCount);
+    if(m_inlineNexts)
+    {
+        for(size_t i = 0; i < nextsCount; ++i)
+        {
+            nexts[i] = in.readU64();
+        }
+        in.skip((k_maxListHeight - nextsCount) * sizeof(OffsetType));
+        return 0;
+    }
     if(nextsCount == 1)
     {
         nexts[0] = in.readU64();
@@ -1215,6 +2894,15 @@ StorageVolumeImpl::loadNodeNexts(InputBinBuffer& in, uint8_t nextsCount, NextsVe
 StorageVolumeImpl::OffsetType
 StorageVolumeImpl::storeNodeNexts(OutputBinBuffer& out, OffsetType offset, const NextsVector& nexts)
 {
+    if(m_inlineNexts)
+    {
+        for(auto nextOffset:nexts)
+        {
+            out.writeU64(nextOffset);
+        }
+        out.fill((k_maxListHeight - nexts.size()) * sizeof(OffsetType));
+        return 0;
+    }
     if(nexts.size() == 1)
     {
         out.writeU64(nexts[0]);
@@ -1245,31 +2933,63 @@ StorageVolumeImpl::storeNodeNexts(OutputBinBuffer& out, OffsetType offset, const
 }
 
 void
-StorageVolumeImpl::loadNodeNextsAndEdgeKey(OffsetType offset, NextsVector& nexts, EdgeKey whichKey, std::string& key)
+StorageVolumeImpl::loadNodeNextsAndEdgeKey(OffsetType offset, NextsVector& nexts, EdgeKey whichKey, NodeKey& key)
 {
-    std::array<uint8_t, SkipListNode::binSize()> data{};
-    m_mainFile->seek(offset);
-    auto buf = boost::asio::buffer(data);
-    m_mainFile->read(buf);
-    InputBinBuffer in(buf);
+    key.nodeOffset = offset;
+    if(m_nodeCacheEnabled)
+    {
+        auto copyNextsAndKey = [&nexts, whichKey, &key](const SkipListNode& node) {
+            nexts = node.nexts;
+            if(whichKey != EdgeKey::none)
+            {
+                key.index = whichKey == EdgeKey::first ? 0 : node.entries.size() - 1;
+                key.key = node.entries[key.index].key;
+            }
+        };
+        {
+            NodeCacheLock lock(m_nodeCacheMtx);
+            auto item = findCachedNode(offset);
+            if(item && !item->headOnly)
+            {
+                copyNextsAndKey(item->node);
+                return;
+            }
+        }
+        SkipListNode loadedNode;
+        loadNode(offset, loadedNode);
+        copyNextsAndKey(loadedNode);
+        return;
+    }
+    //without cache only required key is loaded
+    std::array<uint8_t, SkipListNode::binSize()> data;
+    InputBinBuffer in(readAtOrView(*m_mainFile, offset, data, m_nodeSize));
     uint8_t nextsCount = in.readU8();
     loadNodeNexts(in, nextsCount, nexts);
     uint8_t entries = in.readU8();
     if(whichKey == EdgeKey::first)
     {
-        loadEntryKey(in, key);
-        in.skip((k_entriesPerNode - 1) * Entry::binSize());
+        key.index = 0;
+        loadEntryKey(in, key.key);
     }
     else if(whichKey == EdgeKey::last)
     {
-        in.skip((entries - 1) * Entry::binSize());
-        loadEntryKey(in, key);
-        in.skip((k_entriesPerNode - entries) * Entry::binSize());
+        key.index = entries - 1;
+        in.skip(key.index * m_entrySize);
+        loadEntryKey(in, key.key);
     }
-    else // none
+}
+
+int StorageVolumeImpl::compareNodeKey(NodeKey& key, const boost::string_view& value)
+{
+    int rv;
+    if(compareKeyFingerprint(key.key, value, rv))
     {
-        in.skip(k_entriesPerNode * Entry::binSize());
+        return rv;
     }
+    //key is fetched without cache lock
+    loadKeyDelayed(key.key);
+    cacheLoadedKey(key.nodeOffset, key.index, key.key);
+    return boost::string_view(key.key.value).compare(value);
 }
 
 void StorageVolumeImpl::findPath(OffsetType headOffset, ListPath& path, const boost::string_view& key)
@@ -1283,13 +3003,13 @@ void StorageVolumeImpl::findPath(OffsetType headOffset, ListPath& path, const bo
     OffsetType offset = headOffset;
 
     NextsVector nextNexts;
-    std::string nextLastKey;
+    NodeKey nextLastKey;
     for(size_t level = currentNexts.size(); level-- > 0;)
     {
         while(currentNexts[level] != 0)
         {
             loadNodeNextsAndEdgeKey(currentNexts[level], nextNexts, EdgeKey::last, nextLastKey);
-            if(key > nextLastKey)
+            if(compareNodeKey(nextLastKey, key) < 0)
             {
                 offset = currentNexts[level];
                 currentNexts = nextNexts;
@@ -1315,8 +3035,29 @@ size_t StorageVolumeImpl::generateNewLevel()
     return newLevel;
 }
 
-void StorageVolumeImpl::listInsert(OffsetType headOffset, Entry&& entry)
+void StorageVolumeImpl::overwriteEntry(Entry& existing, Entry&& entry)
+{
+    if(existing.type != entry.type)
+    {
+        throw std::runtime_error(
+                fmt::format(
+                        "StorageVolume::store: entry type cannot be changed (was {}, trying to overwrite with {}",
+                        existing.type == EntryType::dir ? "dir" : "key", entry.type == EntryType::dir ? "dir" : "key"));
+    }
+    //key is the same, so its storage is kept
+    existing.value.previousSize = calcValueLength(existing.value);
+    existing.value.value = std::move(entry.value.value);
+    //old value could be not loaded from storage
+    existing.value.loaded = true;
+    existing.expirationDateTime = entry.expirationDateTime;
+}
+
+bool StorageVolumeImpl::listInsert(OffsetType headOffset, Entry&& entry)
 {
+    if(isTreeDir())
+    {
+        return treeInsert(headOffset, std::move(entry));
+    }
     ListPath path;
     findPath(headOffset, path, entry.key.value);
 
@@ -1345,7 +3086,8 @@ void StorageVolumeImpl::listInsert(OffsetType headOffset, Entry&& entry)
         }
         newNode.entries.push_back(entry);
         storeNode(newNodeOffset, newNode);
-        return;
+        hashIndexInsert(headOffset, keyHash(entry.key.value), newNodeOffset);
+        return true;
     }
 
     loadNode(nodeOffset, node);
@@ -1355,27 +3097,20 @@ void StorageVolumeImpl::listInsert(OffsetType headOffset, Entry&& entry)
             node.entries.back().key.value, nodeOffset);
 
 
-    auto it = std::lower_bound(node.entries.begin(), node.entries.end(), entry, EntryKeyComparator{});
-    if(it != node.entries.end() && it->key.value == entry.key.value)
+    auto it = findEntry(nodeOffset, node, entry.key.value);
+    if(it != node.entries.end() && isSameKey(it->key, entry.key.value))
     {
-        if(it->type != entry.type)
-        {
-            throw std::runtime_error(
-                    fmt::format(
-                            "StorageVolume::store: entry type cannot be changed (was {}, trying to overwrite with {}",
-                            it->type == EntryType::dir ? "dir" : "key", entry.type == EntryType::dir ? "dir" : "key"));
-        }
-        it->key = std::move(entry.key);
-        it->value.previousSize = calcValueLength(it->value);
-        it->value.value = std::move(entry.value.value);
+        overwriteEntry(*it, std::move(entry));
         storeNode(nodeOffset, node);
-        return;
+        return false;
     }
-    if(node.entries.size() < k_entriesPerNode)
+    uint32_t entryHash = keyHash(entry.key.value);
+    if(node.entries.size() < m_entriesPerNode)
     {
         node.entries.insert(it, std::move(entry));
         storeNode(nodeOffset, node);
-        return;
+        hashIndexInsert(headOffset, entryHash, nodeOffset);
+        return true;
     }
     SkipListNode newNode;
     OffsetType newNodeOffset = allocateSkipListNode();
@@ -1394,6 +3129,10 @@ void StorageVolumeImpl::listInsert(OffsetType headOffset, Entry&& entry)
 
         std::move(middle, node.entries.end(), std::back_inserter(newNode.entries));
         node.entries.erase(middle, node.entries.end());
+        for(auto& moved:newNode.entries)
+        {
+            hashIndexMove(headOffset, entryKeyHash(moved.key), nodeOffset, newNodeOffset);
+        }
 
         if(isInNewNode)
         {
@@ -1404,10 +3143,12 @@ void StorageVolumeImpl::listInsert(OffsetType headOffset, Entry&& entry)
         {
             node.entries.insert(it, std::move(entry));
         }
+        hashIndexInsert(headOffset, entryHash, isInNewNode ? newNodeOffset : nodeOffset);
     }
     else
     {
         newNode.entries.push_back(std::move(entry));
+        hashIndexInsert(headOffset, entryHash, newNodeOffset);
     }
 
     size_t newLevel = generateNewLevel();
@@ -1449,22 +3190,31 @@ void StorageVolumeImpl::listInsert(OffsetType headOffset, Entry&& entry)
     }
     storeNode(nodeOffset, node);
     storeNode(newNodeOffset, newNode);
+    return true;
 }
 
 bool StorageVolumeImpl::listLookup(OffsetType headOffset, const boost::string_view& key, Entry& entry)
 {
-    SkipListNode node;
-    loadHeadNode(headOffset, node);
+    if(m_hashIndexOffset)
+    {
+        return hashIndexLookup(headOffset, key, entry);
+    }
+    if(isTreeDir())
+    {
+        return treeLookup(headOffset, key, entry);
+    }
+    SkipListNode node;
+    loadHeadNode(headOffset, node);
     NextsVector currentNexts = std::move(node.nexts);
     NextsVector nextNexts;
-    std::string nextFirstKey;
+    NodeKey nextFirstKey;
     OffsetType nodeOffset = currentNexts[0];
     for(size_t level = currentNexts.size(); level-- > 0;)
     {
         while(currentNexts[level])
         {
             loadNodeNextsAndEdgeKey(currentNexts[level], nextNexts, EdgeKey::first, nextFirstKey);
-            if(key >= nextFirstKey)
+            if(compareNodeKey(nextFirstKey, key) <= 0)
             {
                 nodeOffset = currentNexts[level];
                 currentNexts = nextNexts;
@@ -1480,8 +3230,8 @@ bool StorageVolumeImpl::listLookup(OffsetType headOffset, const boost::string_vi
         return false;
     }
     loadNode(nodeOffset, node);
-    auto it = std::lower_bound(node.entries.begin(), node.entries.end(), key, EntryKeyComparator{});
-    if(it == node.entries.end() || it->key.value != key)
+    auto it = findEntry(nodeOffset, node, key);
+    if(it == node.entries.end() || !isSameKey(it->key, key))
     {
         return false;
     }
@@ -1489,8 +3239,91 @@ bool StorageVolumeImpl::listLookup(OffsetType headOffset, const boost::string_vi
     return true;
 }
 
+void StorageVolumeImpl::listLookupSorted(OffsetType headOffset, const std::vector<boost::string_view>& keys,
+                                         const std::function<void(size_t, Entry&)>& onFound)
+{
+    if(isTreeDir())
+    {
+        //inner nodes are cached, so each key is looked up from root
+        Entry entry;
+        for(size_t i = 0; i < keys.size(); ++i)
+        {
+            if(treeLookup(headOffset, keys[i], entry))
+            {
+                onFound(i, entry);
+            }
+        }
+        return;
+    }
+    //For each level: next node after the last node at this level which first key isn't greater than current key.
+    //Keys are sorted, so search of each key continues from where search of previous key stopped.
+    struct LevelNext {
+        OffsetType offset;
+        bool loaded;
+        NextsVector nexts;
+        NodeKey firstKey;
+    };
+    SkipListNode node;
+    loadHeadNode(headOffset, node);
+    std::vector<LevelNext> levelNexts(node.nexts.size());
+    for(size_t level = 0; level < node.nexts.size(); ++level)
+    {
+        levelNexts[level].offset = node.nexts[level];
+        levelNexts[level].loaded = false;
+    }
+    OffsetType nodeOffset = node.nexts[0];
+    OffsetType loadedNodeOffset = 0;
+    for(size_t i = 0; i < keys.size(); ++i)
+    {
+        auto& key = keys[i];
+        for(size_t level = levelNexts.size(); level-- > 0;)
+        {
+            while(levelNexts[level].offset)
+            {
+                auto& next = levelNexts[level];
+                if(!next.loaded)
+                {
+                    loadNodeNextsAndEdgeKey(next.offset, next.nexts, EdgeKey::first, next.firstKey);
+                    next.loaded = true;
+                }
+                if(compareNodeKey(next.firstKey, key) > 0)
+                {
+                    break;
+                }
+                nodeOffset = next.offset;
+                NextsVector nexts = std::move(next.nexts);
+                for(size_t l = 0; l <= level; ++l)
+                {
+                    levelNexts[l].offset = nexts[l];
+                    levelNexts[l].loaded = false;
+                }
+            }
+        }
+        if(!nodeOffset)
+        {
+            return;
+        }
+        if(nodeOffset != loadedNodeOffset)
+        {
+            loadNode(nodeOffset, node);
+            loadedNodeOffset = nodeOffset;
+        }
+        auto it = findEntry(nodeOffset, node, key);
+        if(it != node.entries.end() && isSameKey(it->key, key))
+        {
+            Entry entry = *it;
+            onFound(i, entry);
+        }
+    }
+}
+
 void StorageVolumeImpl::listErase(OffsetType headOffset, EntryType type, const boost::string_view& key)
 {
+    if(isTreeDir())
+    {
+        treeErase(headOffset, type, key);
+        return;
+    }
     SkipListNode node;
     ListPath path;
     findPath(headOffset, path, key);
@@ -1501,8 +3334,8 @@ void StorageVolumeImpl::listErase(OffsetType headOffset, EntryType type, const b
         return;
     }
     loadNode(nodeOffset, node);
-    auto it = std::lower_bound(node.entries.begin(), node.entries.end(), key, EntryKeyComparator());
-    if(it == node.entries.end() || it->key.value != key)
+    auto it = findEntry(nodeOffset, node, key);
+    if(it == node.entries.end() || !isSameKey(it->key, key))
     {
         return;
     }
@@ -1510,6 +3343,7 @@ void StorageVolumeImpl::listErase(OffsetType headOffset, EntryType type, const b
     {
         throw std::runtime_error(fmt::format("StorageVolume::erase attempt to erase key {} of invalid type", key));
     }
+    hashIndexRemove(headOffset, keyHash(key), nodeOffset);
     freeEntry(*it);
     node.entries.erase(it);
     if(node.entries.empty())
@@ -1521,7 +3355,7 @@ void StorageVolumeImpl::listErase(OffsetType headOffset, EntryType type, const b
             tmpNode.nexts[i] = node.nexts[i];
             storeHeadNode(path[i], tmpNode);
         }
-        if(node.nexts.size() > 1)
+        if(node.nextOffset)
         {
             m_stmStorage->freeSlot(node.nextOffset, node.nexts.size() * sizeof(OffsetType));
         }
@@ -1533,26 +3367,62 @@ void StorageVolumeImpl::listErase(OffsetType headOffset, EntryType type, const b
     }
 }
 
+bool StorageVolumeImpl::listSetExpiration(OffsetType headOffset, const boost::string_view& key, uint64_t expTime)
+{
+    if(isTreeDir())
+    {
+        return treeSetExpiration(headOffset, key, expTime);
+    }
+    SkipListNode node;
+    ListPath path;
+    findPath(headOffset, path, key);
+    loadHeadNode(path[0], node);
+    OffsetType nodeOffset = node.nexts[0];
+    if(!nodeOffset)
+    {
+        return false;
+    }
+    loadNode(nodeOffset, node);
+    auto it = findEntry(nodeOffset, node, key);
+    if(it == node.entries.end() || !isSameKey(it->key, key) || it->type != EntryType::key)
+    {
+        return false;
+    }
+    it->expirationDateTime = expTime;
+    storeNode(nodeOffset, node);
+    return true;
+}
+
 void StorageVolumeImpl::listEraseRecursive(OffsetType nodeHeadOffset)
 {
+    dropDirFilter(nodeHeadOffset);
     SkipListNode node;
     loadHeadNode(nodeHeadOffset, node);
     OffsetType offset = node.nexts[0];
-    m_stmStorage->freeSlot(node.nextOffset, node.nexts.size() * sizeof(OffsetType));
+    if(node.nextOffset)
+    {
+        m_stmStorage->freeSlot(node.nextOffset, node.nexts.size() * sizeof(OffsetType));
+    }
+    if(isTreeDir() && node.nexts[1])
+    {
+        treeFreeInnerNodes(node.nexts[1]);
+    }
+    //leaves of tree are walked the same way as skip list nodes
     while(offset)
     {
         loadNode(offset, node);
+        loadNodeKeys(offset, node);
         for(auto& entry:node.entries)
         {
             if(entry.type == EntryType::dir)
             {
                 listEraseRecursive(boost::get<uint64_t>(entry.value.value));
-                listErase(offset, EntryType::dir, entry.key.value);
             }
+            hashIndexRemove(nodeHeadOffset, keyHash(entry.key.value), offset);
             freeEntry(entry);
         }
         freeSkipListHeadNode(offset);
-        if(node.nexts.size() > 1)
+        if(node.nextOffset)
         {
             m_stmStorage->freeSlot(node.nextOffset, node.nexts.size() * sizeof(OffsetType));
         }
@@ -1570,6 +3440,7 @@ void StorageVolumeImpl::listGetContent(OffsetType nodeHeadOffset, std::vector<Di
     while(offset)
     {
         loadNode(offset, node);
+        loadNodeKeys(offset, node);
         for(auto& entry:node.entries)
         {
             if(entry.expirationDateTime != 0 && entry.expirationDateTime < now)
@@ -1582,13 +3453,827 @@ void StorageVolumeImpl::listGetContent(OffsetType nodeHeadOffset, std::vector<Di
     }
 }
 
+void StorageVolumeImpl::listScan(OffsetType nodeHeadOffset, const boost::string_view& from,
+                                 const std::function<bool(Entry&)>& onEntry)
+{
+    SkipListNode node;
+    OffsetType offset;
+    if(isTreeDir())
+    {
+        SkipListNode head;
+        TreePath treePath;
+        loadHeadNode(nodeHeadOffset, head);
+        offset = treeFindLeaf(head, from, treePath, node);
+    }
+    else
+    {
+        ListPath path;
+        findPath(nodeHeadOffset, path, from);
+        if(path[0] == nodeHeadOffset)
+        {
+            loadHeadNode(nodeHeadOffset, node);
+        }
+        else
+        {
+            loadNode(path[0], node);
+        }
+        offset = node.nexts[0];
+    }
+    while(offset)
+    {
+        loadNode(offset, node);
+        loadNodeKeys(offset, node);
+        auto it = std::lower_bound(node.entries.begin(), node.entries.end(), from, EntryKeyComparator{});
+        for(; it != node.entries.end(); ++it)
+        {
+            if(!onEntry(*it))
+            {
+                return;
+            }
+        }
+        offset = node.nexts[0];
+    }
+}
+
+size_t StorageVolumeImpl::findChild(OffsetType nodeOffset, SkipListNode& node, const boost::string_view& key)
+{
+    bool fetched = false;
+    auto isGreater = [this, &fetched](const boost::string_view& value, Entry& entry) {
+        bool loaded = entry.key.loaded;
+        bool rv = compareKey(entry.key, value) > 0;
+        fetched = fetched || loaded != entry.key.loaded;
+        return rv;
+    };
+    //name of the first child isn't compared
+    auto it = std::upper_bound(node.entries.begin() + 1, node.entries.end(), key, isGreater);
+    if(fetched)
+    {
+        cacheLoadedKeys(nodeOffset, node);
+    }
+    return (it - node.entries.begin()) - 1;
+}
+
+StorageVolumeImpl::OffsetType StorageVolumeImpl::treeFindLeaf(const SkipListNode& head, const boost::string_view& key,
+                                                              TreePath& path, SkipListNode& leaf)
+{
+    path.clear();
+    OffsetType offset = head.nexts[1];
+    while(offset)
+    {
+        loadNode(offset, leaf);
+        if(!isInnerTreeNode(leaf))
+        {
+            break;
+        }
+        size_t index = findChild(offset, leaf, key);
+        path.push_back({offset, index});
+        offset = boost::get<uint64_t>(leaf.entries[index].value.value);
+    }
+    return offset;
+}
+
+bool StorageVolumeImpl::treeInsert(OffsetType headOffset, Entry&& entry)
+{
+    SkipListNode head;
+    loadHeadNode(headOffset, head);
+    TreePath path;
+    SkipListNode leaf;
+    OffsetType leafOffset = treeFindLeaf(head, entry.key.value, path, leaf);
+    if(!leafOffset)//empty tree
+    {
+        leafOffset = allocateSkipListNode();
+        leaf.nexts.assign(1, 0);
+        leaf.entries.clear();
+        leaf.entries.push_back(std::move(entry));
+        storeNode(leafOffset, leaf);
+        head.nexts[0] = leafOffset;
+        head.nexts[1] = leafOffset;
+        storeHeadNode(headOffset, head);
+        hashIndexInsert(headOffset, keyHash(leaf.entries.front().key.value), leafOffset);
+        return true;
+    }
+    auto it = findEntry(leafOffset, leaf, entry.key.value);
+    if(it != leaf.entries.end() && isSameKey(it->key, entry.key.value))
+    {
+        overwriteEntry(*it, std::move(entry));
+        storeNode(leafOffset, leaf);
+        return false;
+    }
+    hashIndexInsert(headOffset, keyHash(entry.key.value), leafOffset);
+    leaf.entries.insert(it, std::move(entry));
+    if(leaf.entries.size() <= m_entriesPerNode)
+    {
+        storeNode(leafOffset, leaf);
+        return true;
+    }
+    SkipListNode newLeaf;
+    OffsetType newLeafOffset = allocateSkipListNode();
+    getLogger()->debug("newLeafOffset={}", newLeafOffset);
+    auto middle = leaf.entries.begin() + leaf.entries.size() / 2;
+    std::move(middle, leaf.entries.end(), std::back_inserter(newLeaf.entries));
+    leaf.entries.erase(middle, leaf.entries.end());
+    for(auto& moved:newLeaf.entries)
+    {
+        hashIndexMove(headOffset, entryKeyHash(moved.key), leafOffset, newLeafOffset);
+    }
+    newLeaf.nexts.assign(1, leaf.nexts[0]);
+    leaf.nexts[0] = newLeafOffset;
+    //parent entry has its own copy of key
+    Entry child;
+    child.setDir(loadKeyDelayed(newLeaf.entries.front().key), newLeafOffset);
+    storeNode(leafOffset, leaf);
+    storeNode(newLeafOffset, newLeaf);
+    treeInsertChild(headOffset, head, path, path.size(), std::move(child));
+    return true;
+}
+
+void StorageVolumeImpl::treeInsertChild(OffsetType headOffset, SkipListNode& head, TreePath& path, size_t level,
+                                        Entry&& child)
+{
+    if(level == 0)
+    {
+        //root was split, tree grows by one level
+        SkipListNode root;
+        OffsetType rootOffset = allocateSkipListNode();
+        Entry first;
+        first.setDir(std::string(), head.nexts[1]);
+        root.entries.push_back(std::move(first));
+        root.entries.push_back(std::move(child));
+        storeNode(rootOffset, root);
+        head.nexts[1] = rootOffset;
+        storeHeadNode(headOffset, head);
+        return;
+    }
+    auto& parent = path[level - 1];
+    SkipListNode node;
+    loadNode(parent.offset, node);
+    node.entries.insert(node.entries.begin() + parent.index + 1, std::move(child));
+    if(node.entries.size() <= m_entriesPerNode)
+    {
+        storeNode(parent.offset, node);
+        return;
+    }
+    SkipListNode newNode;
+    OffsetType newNodeOffset = allocateSkipListNode();
+    auto middle = node.entries.begin() + node.entries.size() / 2;
+    std::move(middle, node.entries.end(), std::back_inserter(newNode.entries));
+    node.entries.erase(middle, node.entries.end());
+    //name of the first child of new node moves to parent
+    Entry newChild;
+    newChild.setDir(std::string(), newNodeOffset);
+    std::swap(newChild.key, newNode.entries.front().key);
+    storeNode(parent.offset, node);
+    storeNode(newNodeOffset, newNode);
+    treeInsertChild(headOffset, head, path, level - 1, std::move(newChild));
+}
+
+bool StorageVolumeImpl::treeLookup(OffsetType headOffset, const boost::string_view& key, Entry& entry)
+{
+    SkipListNode head;
+    loadHeadNode(headOffset, head);
+    TreePath path;
+    SkipListNode leaf;
+    OffsetType leafOffset = treeFindLeaf(head, key, path, leaf);
+    if(!leafOffset)
+    {
+        return false;
+    }
+    auto it = findEntry(leafOffset, leaf, key);
+    if(it == leaf.entries.end() || !isSameKey(it->key, key))
+    {
+        return false;
+    }
+    entry = std::move(*it);
+    return true;
+}
+
+void StorageVolumeImpl::treeErase(OffsetType headOffset, EntryType type, const boost::string_view& key)
+{
+    SkipListNode head;
+    loadHeadNode(headOffset, head);
+    TreePath path;
+    SkipListNode leaf;
+    OffsetType leafOffset = treeFindLeaf(head, key, path, leaf);
+    if(!leafOffset)
+    {
+        return;
+    }
+    auto it = findEntry(leafOffset, leaf, key);
+    if(it == leaf.entries.end() || !isSameKey(it->key, key))
+    {
+        return;
+    }
+    if(it->type != type)
+    {
+        throw std::runtime_error(fmt::format("StorageVolume::erase attempt to erase key {} of invalid type", key));
+    }
+    hashIndexRemove(headOffset, keyHash(key), leafOffset);
+    freeEntry(*it);
+    leaf.entries.erase(it);
+    if(!leaf.entries.empty())
+    {
+        storeNode(leafOffset, leaf);
+        return;
+    }
+    if(head.nexts[0] == leafOffset)
+    {
+        head.nexts[0] = leaf.nexts[0];
+        storeHeadNode(headOffset, head);
+    }
+    else
+    {
+        OffsetType prevOffset = treeFindPrevLeaf(path);
+        SkipListNode prev;
+        loadNode(prevOffset, prev);
+        prev.nexts[0] = leaf.nexts[0];
+        storeNode(prevOffset, prev);
+    }
+    freeSkipListNode(leafOffset);
+    treeEraseChild(headOffset, head, path, path.size());
+}
+
+void StorageVolumeImpl::treeEraseChild(OffsetType headOffset, SkipListNode& head, TreePath& path, size_t level)
+{
+    if(level == 0)
+    {
+        //the last node of tree was removed
+        head.nexts[0] = 0;
+        head.nexts[1] = 0;
+        storeHeadNode(headOffset, head);
+        return;
+    }
+    auto& parent = path[level - 1];
+    SkipListNode node;
+    loadNode(parent.offset, node);
+    freeEntry(node.entries[parent.index]);
+    node.entries.erase(node.entries.begin() + parent.index);
+    if(node.entries.empty())
+    {
+        freeSkipListNode(parent.offset);
+        treeEraseChild(headOffset, head, path, level - 1);
+        return;
+    }
+    if(parent.index == 0)
+    {
+        freeEntry(node.entries.front());
+        node.entries.front().key = KeyInfo();
+    }
+    if(level == 1 && node.entries.size() == 1)
+    {
+        //root with single child is replaced by child
+        head.nexts[1] = boost::get<uint64_t>(node.entries.front().value.value);
+        storeHeadNode(headOffset, head);
+        freeSkipListNode(parent.offset);
+        return;
+    }
+    storeNode(parent.offset, node);
+}
+
+StorageVolumeImpl::OffsetType StorageVolumeImpl::treeFindPrevLeaf(const TreePath& path)
+{
+    //the deepest inner node where path doesn't go through the first child,
+    //it exists, because leaf isn't the first one
+    size_t level = path.size();
+    while(path[level - 1].index == 0)
+    {
+        --level;
+    }
+    auto& item = path[level - 1];
+    SkipListNode node;
+    loadNode(item.offset, node);
+    OffsetType offset = boost::get<uint64_t>(node.entries[item.index - 1].value.value);
+    for(;;)
+    {
+        loadNode(offset, node);
+        if(!isInnerTreeNode(node))
+        {
+            return offset;
+        }
+        offset = boost::get<uint64_t>(node.entries.back().value.value);
+    }
+}
+
+bool StorageVolumeImpl::treeSetExpiration(OffsetType headOffset, const boost::string_view& key, uint64_t expTime)
+{
+    SkipListNode head;
+    loadHeadNode(headOffset, head);
+    TreePath path;
+    SkipListNode leaf;
+    OffsetType leafOffset = treeFindLeaf(head, key, path, leaf);
+    if(!leafOffset)
+    {
+        return false;
+    }
+    auto it = findEntry(leafOffset, leaf, key);
+    if(it == leaf.entries.end() || !isSameKey(it->key, key) || it->type != EntryType::key)
+    {
+        return false;
+    }
+    it->expirationDateTime = expTime;
+    storeNode(leafOffset, leaf);
+    return true;
+}
+
+bool StorageVolumeImpl::treeFreeInnerNodes(OffsetType nodeOffset)
+{
+    SkipListNode node;
+    loadNode(nodeOffset, node);
+    if(!isInnerTreeNode(node))
+    {
+        return false;
+    }
+    //all leaves are at the same depth, so if the first child is a leaf, the rest are leaves too
+    bool innerChildren = true;
+    for(auto& entry:node.entries)
+    {
+        if(innerChildren)
+        {
+            innerChildren = treeFreeInnerNodes(boost::get<uint64_t>(entry.value.value));
+        }
+        freeEntry(entry);
+    }
+    freeSkipListNode(nodeOffset);
+    return true;
+}
+
+uint64_t StorageVolumeImpl::hashIndexHash(OffsetType dirOffset, uint32_t keyHash)
+{
+    //splitmix64 finalizer, buckets are addressed by low bits
+    uint64_t rv = dirOffset * 0x9e3779b97f4a7c15ull ^ keyHash;
+    rv = (rv ^ (rv >> 30)) * 0xbf58476d1ce4e5b9ull;
+    rv = (rv ^ (rv >> 27)) * 0x94d049bb133111ebull;
+    return rv ^ (rv >> 31);
+}
+
+StorageVolumeImpl::OffsetType StorageVolumeImpl::hashIndexBucketOffset(uint64_t bucketIndex)
+{
+    size_t segment = 0;
+    uint64_t segmentStart = 0;
+    if(bucketIndex)
+    {
+        segmentStart = 1;
+        segment = 1;
+        while(segmentStart * 2 <= bucketIndex)
+        {
+            segmentStart *= 2;
+            ++segment;
+        }
+    }
+    return m_hashIndexSegments[segment] + (bucketIndex - segmentStart) * m_nodeAllocSize;
+}
+
+StorageVolumeImpl::OffsetType StorageVolumeImpl::hashIndexFindBucket(OffsetType dirOffset, uint32_t keyHash)
+{
+    uint64_t hash = hashIndexHash(dirOffset, keyHash);
+    uint64_t mask = 1;
+    while(mask < m_hashIndexBucketsCount)
+    {
+        mask *= 2;
+    }
+    uint64_t bucketIndex = hash & (mask - 1);
+    if(bucketIndex >= m_hashIndexBucketsCount)
+    {
+        //bucket isn't split yet
+        bucketIndex = hash & (mask / 2 - 1);
+    }
+    return hashIndexBucketOffset(bucketIndex);
+}
+
+void StorageVolumeImpl::createHashIndex()
+{
+    m_hashIndexOffset = allocateSkipListNode();
+    m_hashIndexSegments.assign(1, allocateSkipListNode());
+    m_hashIndexBucketsCount = 1;
+    m_hashIndexRecordsCount = 0;
+    storeHashIndexBucket(m_hashIndexSegments[0], HashIndexBucket(), true);
+    storeHashIndexHeader();
+    writeUIntAt(*m_mainFile, k_headerSize + k_nodeLayoutSize, m_hashIndexOffset);
+}
+
+void StorageVolumeImpl::loadHashIndexHeader()
+{
+    std::array<uint8_t, sizeof(uint64_t) * 2 + k_hashIndexMaxSegments * sizeof(OffsetType)> data;
+    InputBinBuffer in(readAtOrView(*m_mainFile, m_hashIndexOffset, data));
+    m_hashIndexBucketsCount = in.readU64();
+    m_hashIndexRecordsCount = in.readU64();
+    m_hashIndexSegments.clear();
+    for(uint64_t segmentEnd = 1; m_hashIndexSegments.empty() || segmentEnd / 2 < m_hashIndexBucketsCount;
+        segmentEnd *= 2)
+    {
+        m_hashIndexSegments.push_back(in.readU64());
+    }
+}
+
+void StorageVolumeImpl::storeHashIndexHeader()
+{
+    std::array<uint8_t, sizeof(uint64_t) * 2 + k_hashIndexMaxSegments * sizeof(OffsetType)> data{};
+    auto buf = boost::asio::buffer(data.data(), sizeof(uint64_t) * 2 + m_hashIndexSegments.size() * sizeof(OffsetType));
+    OutputBinBuffer out(buf);
+    out.writeU64(m_hashIndexBucketsCount);
+    out.writeU64(m_hashIndexRecordsCount);
+    for(auto offset:m_hashIndexSegments)
+    {
+        out.writeU64(offset);
+    }
+    m_mainFile->writeAt(m_hashIndexOffset, buf);
+}
+
+void StorageVolumeImpl::loadHashIndexBucket(OffsetType offset, HashIndexBucket& bucket)
+{
+    std::array<uint8_t, SkipListNode::binSize()> data;
+    InputBinBuffer in(readAtOrView(*m_mainFile, offset, data, m_nodeSize));
+    uint16_t count = in.readU16();
+    bucket.overflow = in.readU64();
+    bucket.records.resize(count);
+    for(auto& record:bucket.records)
+    {
+        record.dirOffset = in.readU64();
+        record.keyHash = in.readU32();
+        record.nodeOffset = in.readU64();
+    }
+}
+
+void StorageVolumeImpl::storeHashIndexBucket(OffsetType offset, const HashIndexBucket& bucket, bool full)
+{
+    std::array<uint8_t, SkipListNode::binSize()> data{};
+    size_t size = full ? m_nodeSize : k_hashIndexBucketHeadSize + bucket.records.size() * k_hashIndexRecordSize;
+    auto buf = boost::asio::buffer(data.data(), size);
+    OutputBinBuffer out(buf);
+    out.writeU16(static_cast<uint16_t>(bucket.records.size()));
+    out.writeU64(bucket.overflow);
+    for(auto& record:bucket.records)
+    {
+        out.writeU64(record.dirOffset);
+        out.writeU32(record.keyHash);
+        out.writeU64(record.nodeOffset);
+    }
+    m_mainFile->writeAt(offset, buf);
+}
+
+void StorageVolumeImpl::hashIndexInsert(OffsetType dirOffset, uint32_t keyHash, OffsetType nodeOffset)
+{
+    if(!m_hashIndexOffset)
+    {
+        return;
+    }
+    OffsetType offset = hashIndexFindBucket(dirOffset, keyHash);
+    HashIndexBucket bucket;
+    for(;;)
+    {
+        loadHashIndexBucket(offset, bucket);
+        if(bucket.records.size() < hashIndexBucketCapacity())
+        {
+            bucket.records.push_back({dirOffset, keyHash, nodeOffset});
+            storeHashIndexBucket(offset, bucket);
+            break;
+        }
+        if(!bucket.overflow)
+        {
+            HashIndexBucket overflow;
+            overflow.records.push_back({dirOffset, keyHash, nodeOffset});
+            bucket.overflow = allocateSkipListNode();
+            storeHashIndexBucket(bucket.overflow, overflow, true);
+            storeHashIndexBucket(offset, bucket);
+            break;
+        }
+        offset = bucket.overflow;
+    }
+    ++m_hashIndexRecordsCount;
+    //buckets are kept 3/4 full on average
+    if(m_hashIndexRecordsCount * 4 > m_hashIndexBucketsCount * hashIndexBucketCapacity() * 3)
+    {
+        hashIndexSplitBucket();
+    }
+    storeHashIndexHeader();
+}
+
+void StorageVolumeImpl::hashIndexRemove(OffsetType dirOffset, uint32_t keyHash, OffsetType nodeOffset)
+{
+    if(!m_hashIndexOffset)
+    {
+        return;
+    }
+    OffsetType prevOffset = 0;
+    OffsetType offset = hashIndexFindBucket(dirOffset, keyHash);
+    HashIndexBucket bucket;
+    while(offset)
+    {
+        loadHashIndexBucket(offset, bucket);
+        auto it = std::find_if(bucket.records.begin(), bucket.records.end(), [&](const HashIndexRecord& record) {
+            return record.dirOffset == dirOffset && record.keyHash == keyHash && record.nodeOffset == nodeOffset;
+        });
+        if(it == bucket.records.end())
+        {
+            prevOffset = offset;
+            offset = bucket.overflow;
+            continue;
+        }
+        *it = bucket.records.back();
+        bucket.records.pop_back();
+        if(bucket.records.empty() && prevOffset)
+        {
+            //empty overflow bucket is unlinked from chain
+            HashIndexBucket prev;
+            loadHashIndexBucket(prevOffset, prev);
+            prev.overflow = bucket.overflow;
+            storeHashIndexBucket(prevOffset, prev);
+            freeSkipListNode(offset);
+        }
+        else
+        {
+            storeHashIndexBucket(offset, bucket);
+        }
+        --m_hashIndexRecordsCount;
+        storeHashIndexHeader();
+        return;
+    }
+}
+
+void StorageVolumeImpl::hashIndexMove(OffsetType dirOffset, uint32_t keyHash, OffsetType fromOffset,
+                                      OffsetType toOffset)
+{
+    if(!m_hashIndexOffset)
+    {
+        return;
+    }
+    OffsetType offset = hashIndexFindBucket(dirOffset, keyHash);
+    HashIndexBucket bucket;
+    while(offset)
+    {
+        loadHashIndexBucket(offset, bucket);
+        for(auto& record:bucket.records)
+        {
+            if(record.dirOffset == dirOffset && record.keyHash == keyHash && record.nodeOffset == fromOffset)
+            {
+                record.nodeOffset = toOffset;
+                storeHashIndexBucket(offset, bucket);
+                return;
+            }
+        }
+        offset = bucket.overflow;
+    }
+}
+
+void StorageVolumeImpl::hashIndexSplitBucket()
+{
+    uint64_t newIndex = m_hashIndexBucketsCount;
+    uint64_t segmentStart = 1;
+    while(segmentStart * 2 <= newIndex)
+    {
+        segmentStart *= 2;
+    }
+    if(newIndex == segmentStart)
+    {
+        if(m_hashIndexSegments.size() == k_hashIndexMaxSegments)
+        {
+            return;
+        }
+        //buckets of segment are written when they are split into, the last byte is written now,
+        //so space of segment isn't taken by other nodes after reopen
+        OffsetType segmentOffset = m_fileEnd;
+        m_fileEnd += segmentStart * m_nodeAllocSize;
+        writeUIntAt(*m_mainFile, m_fileEnd - 1, uint8_t(0));
+        m_hashIndexSegments.push_back(segmentOffset);
+    }
+    uint64_t buddyIndex = newIndex - segmentStart;
+    ++m_hashIndexBucketsCount;
+
+    //records of buddy chain are divided between buddy and new bucket by one more bit of hash
+    std::vector<OffsetType> buddyChain;
+    std::vector<HashIndexRecord> buddyRecords;
+    std::vector<HashIndexRecord> newRecords;
+    HashIndexBucket bucket;
+    for(OffsetType offset = hashIndexBucketOffset(buddyIndex); offset; offset = bucket.overflow)
+    {
+        buddyChain.push_back(offset);
+        loadHashIndexBucket(offset, bucket);
+        for(auto& record:bucket.records)
+        {
+            uint64_t hash = hashIndexHash(record.dirOffset, record.keyHash);
+            if((hash & (segmentStart * 2 - 1)) == newIndex)
+            {
+                newRecords.push_back(record);
+            }
+            else
+            {
+                buddyRecords.push_back(record);
+            }
+        }
+    }
+    std::vector<OffsetType> newChain{hashIndexBucketOffset(newIndex)};
+    size_t capacity = hashIndexBucketCapacity();
+    for(auto chainRecords:{std::make_pair(&buddyChain, &buddyRecords), std::make_pair(&newChain, &newRecords)})
+    {
+        auto& chain = *chainRecords.first;
+        auto& records = *chainRecords.second;
+        size_t bucketsCount = std::max<size_t>(1, (records.size() + capacity - 1) / capacity);
+        while(chain.size() > bucketsCount)
+        {
+            freeSkipListNode(chain.back());
+            chain.pop_back();
+        }
+        while(chain.size() < bucketsCount)
+        {
+            chain.push_back(allocateSkipListNode());
+        }
+        for(size_t i = 0; i < chain.size(); ++i)
+        {
+            bucket.overflow = i + 1 < chain.size() ? chain[i + 1] : 0;
+            auto begin = records.begin() + std::min(records.size(), i * capacity);
+            auto end = records.begin() + std::min(records.size(), (i + 1) * capacity);
+            bucket.records.assign(begin, end);
+            storeHashIndexBucket(chain[i], bucket, true);
+        }
+    }
+}
+
+bool StorageVolumeImpl::hashIndexLookup(OffsetType headOffset, const boost::string_view& key, Entry& entry)
+{
+    uint32_t hash = keyHash(key);
+    OffsetType offset = hashIndexFindBucket(headOffset, hash);
+    HashIndexBucket bucket;
+    SkipListNode node;
+    while(offset)
+    {
+        loadHashIndexBucket(offset, bucket);
+        for(auto& record:bucket.records)
+        {
+            if(record.dirOffset != headOffset || record.keyHash != hash)
+            {
+                continue;
+            }
+            //records of other keys with the same hash point to nodes without key
+            loadNode(record.nodeOffset, node);
+            auto it = findEntry(record.nodeOffset, node, key);
+            if(it != node.entries.end() && isSameKey(it->key, key))
+            {
+                entry = std::move(*it);
+                return true;
+            }
+        }
+        offset = bucket.overflow;
+    }
+    return false;
+}
+
+uint32_t StorageVolumeImpl::entryKeyHash(KeyInfo& key)
+{
+    return key.hasFingerprint ? key.hash : keyHash(loadKeyDelayed(key));
+}
+
+template<class F>
+void StorageVolumeImpl::dirFilterForEachBit(const DirFilter& filter, const boost::string_view& key, F f)
+{
+    //double hashing with two halves of 64 bit hash
+    uint64_t hash = hashIndexHash(0, keyHash(key));
+    uint64_t h1 = hash & 0xffffffffu;
+    uint64_t h2 = (hash >> 32) | 1;
+    uint64_t bitsCount = filter.bits.size() * 8;
+    for(size_t i = 0; i < k_dirFilterHashesCount; ++i)
+    {
+        f((h1 + i * h2) % bitsCount);
+    }
+}
+
+std::string StorageVolumeImpl::dirFilterKey(OffsetType dirOffset)
+{
+    //fixed width, so keys are inplace and ordered as offsets
+    return fmt::format("{:016x}", dirOffset);
+}
+
+StorageVolumeImpl::DirFilterPtr StorageVolumeImpl::loadDirFilter(OffsetType dirOffset)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_dirFiltersMtx);
+        auto it = m_dirFilters.find(dirOffset);
+        if(it != m_dirFilters.end())
+        {
+            return it->second;
+        }
+    }
+    DirFilterPtr filter;
+    Entry entry;
+    if(listLookup(m_dirFiltersOffset, dirFilterKey(dirOffset), entry))
+    {
+        filter = std::make_shared<DirFilter>();
+        filter->offset = boost::get<uint64_t>(entry.value.value);
+        std::array<uint8_t, k_dirFilterHeadSize> head;
+        InputBinBuffer in(readAtOrView(*m_mainFile, filter->offset, head));
+        filter->bits.resize(in.readU64());
+        filter->keysCount = in.readU64();
+        m_mainFile->readAt(filter->offset + k_dirFilterHeadSize, boost::asio::buffer(filter->bits));
+    }
+    std::lock_guard<std::mutex> lock(m_dirFiltersMtx);
+    //concurrent lookup could load it first
+    return m_dirFilters.emplace(dirOffset, filter).first->second;
+}
+
+bool StorageVolumeImpl::dirFilterMayContain(OffsetType dirOffset, const boost::string_view& key)
+{
+    if(!m_dirFiltersOffset)
+    {
+        return true;
+    }
+    auto filter = loadDirFilter(dirOffset);
+    if(!filter)
+    {
+        return true;
+    }
+    bool rv = true;
+    dirFilterForEachBit(*filter, key, [&rv, &filter](uint64_t bit) {
+        rv = rv && (filter->bits[bit / 8] & (1 << (bit % 8)));
+    });
+    return rv;
+}
+
+void StorageVolumeImpl::dirFilterAdd(OffsetType dirOffset, const boost::string_view& key)
+{
+    if(!m_dirFiltersOffset)
+    {
+        return;
+    }
+    auto filter = loadDirFilter(dirOffset);
+    if(!filter || filter->keysCount >= filter->capacity())
+    {
+        //rebuilt filter already has new entry
+        rebuildDirFilter(dirOffset, filter ? filter->keysCount * 2 : 0);
+        return;
+    }
+    dirFilterForEachBit(*filter, key, [this, &filter](uint64_t bit) {
+        uint8_t& byte = filter->bits[bit / 8];
+        uint8_t mask = 1 << (bit % 8);
+        if(!(byte & mask))
+        {
+            byte |= mask;
+            writeUIntAt(*m_mainFile, filter->offset + k_dirFilterHeadSize + bit / 8, byte);
+        }
+    });
+    ++filter->keysCount;
+    writeUIntAt(*m_mainFile, filter->offset + sizeof(uint64_t), filter->keysCount);
+}
+
+void StorageVolumeImpl::rebuildDirFilter(OffsetType dirOffset, size_t capacity)
+{
+    std::vector<std::string> names;
+    listScan(dirOffset, {}, [&names](Entry& entry) {
+        names.push_back(entry.key.value);
+        return true;
+    });
+    auto filter = std::make_shared<DirFilter>();
+    capacity = std::max(capacity, names.size() * 2);
+    filter->bits.resize(std::max(k_dirFilterMinSize, (capacity * k_dirFilterBitsPerKey + 7) / 8));
+    filter->keysCount = names.size();
+    for(auto& name:names)
+    {
+        dirFilterForEachBit(*filter, name, [&filter](uint64_t bit) {
+            filter->bits[bit / 8] |= 1 << (bit % 8);
+        });
+    }
+    dropDirFilter(dirOffset);
+    size_t size = k_dirFilterHeadSize + filter->bits.size();
+    if(m_nodePageSize)
+    {
+        size = (size + m_nodePageSize - 1) / m_nodePageSize * m_nodePageSize;
+    }
+    filter->offset = m_fileEnd;
+    m_fileEnd += size;
+    std::vector<uint8_t> data(k_dirFilterHeadSize);
+    OutputBinBuffer out(boost::asio::buffer(data));
+    out.writeU64(filter->bits.size());
+    out.writeU64(filter->keysCount);
+    data.insert(data.end(), filter->bits.begin(), filter->bits.end());
+    m_mainFile->writeAt(filter->offset, boost::asio::buffer(data));
+    Entry entry;
+    entry.setValue(dirFilterKey(dirOffset), static_cast<uint64_t>(filter->offset));
+    listInsert(m_dirFiltersOffset, std::move(entry));
+    std::lock_guard<std::mutex> lock(m_dirFiltersMtx);
+    m_dirFilters[dirOffset] = filter;
+}
+
+void StorageVolumeImpl::dropDirFilter(OffsetType dirOffset)
+{
+    if(!m_dirFiltersOffset)
+    {
+        return;
+    }
+    auto filter = loadDirFilter(dirOffset);
+    if(filter)
+    {
+        //space of filter is reclaimed by compaction
+        m_freedSize += k_dirFilterHeadSize + filter->bits.size();
+        listErase(m_dirFiltersOffset, EntryType::key, dirFilterKey(dirOffset));
+    }
+    std::lock_guard<std::mutex> lock(m_dirFiltersMtx);
+    m_dirFilters.erase(dirOffset);
+}
+
 StorageVolumeImpl::OffsetType StorageVolumeImpl::followPath(const std::vector<boost::string_view>& path)
 {
-    OffsetType offset = k_rootListOffset;
+    OffsetType offset = m_rootListOffset;
     for(auto& dir:path)
     {
         Entry entry;
-        if(!listLookup(offset, dir, entry))
+        if(!dirFilterMayContain(offset, dir) || !listLookup(offset, dir, entry))
         {
             return 0;
         }
@@ -1607,7 +4292,7 @@ StorageVolumeImpl::OffsetType StorageVolumeImpl::followPath(const std::vector<bo
 
 void StorageVolumeImpl::dump(const std::function<void(const std::string&)>& out)
 {
-    dumpList(k_rootListOffset, 0, out);
+    dumpList(m_rootListOffset, 0, out);
 }
 
 void
@@ -1619,6 +4304,7 @@ StorageVolumeImpl::dumpList(OffsetType headOffset, size_t indent, const std::fun
     while(offset)
     {
         loadNode(offset, node);
+        loadNodeKeys(offset, node);
         out(fmt::format("node@{}, height:{}:[\n", offset, node.nexts.size()));
         for(auto& e:node.entries)
         {
@@ -1643,9 +4329,17 @@ StorageVolumeImpl::dumpList(OffsetType headOffset, size_t indent, const std::fun
 StorageVolume::UniquePtr StorageVolume::open(FileSystem::UniqueFilePtr&& mainFile,
                                              SmallToMediumFileStorage::UniquePtr&& stmFileStorage,
                                              BigFileStorage::UniquePtr&& bigFileStorage)
+{
+    return open(std::move(mainFile), std::move(stmFileStorage), std::move(bigFileStorage), Options{});
+}
+
+StorageVolume::UniquePtr StorageVolume::open(FileSystem::UniqueFilePtr&& mainFile,
+                                             SmallToMediumFileStorage::UniquePtr&& stmFileStorage,
+                                             BigFileStorage::UniquePtr&& bigFileStorage,
+                                             const Options& options)
 {
     auto rv = std::make_unique<StorageVolumeImpl>(std::move(mainFile), std::move(stmFileStorage),
-            std::move(bigFileStorage));
+            std::move(bigFileStorage), options, nullptr);
 
     rv->openImpl();
 
@@ -1657,10 +4351,46 @@ StorageVolume::create(FileSystem::UniqueFilePtr&& mainFile,
                       SmallToMediumFileStorage::UniquePtr&& stmFileStorage,
                       BigFileStorage::UniquePtr&& bigFileStorage)
 {
+    return create(std::move(mainFile), std::move(stmFileStorage), std::move(bigFileStorage), Options{});
+}
+
+std::unique_ptr<StorageVolume>
+StorageVolume::create(FileSystem::UniqueFilePtr&& mainFile,
+                      SmallToMediumFileStorage::UniquePtr&& stmFileStorage,
+                      BigFileStorage::UniquePtr&& bigFileStorage,
+                      const Options& options)
+{
+    auto rv = std::make_unique<StorageVolumeImpl>(std::move(mainFile), std::move(stmFileStorage),
+            std::move(bigFileStorage), options, nullptr);
+
+    rv->createImpl();
+
+    return rv;
+}
+
+StorageVolume::UniquePtr StorageVolume::open(WriteAheadLog::UniquePtr&& log, const Options& options)
+{
+    auto mainFile = log->getFile(0);
+    auto stmFileStorage = SmallToMediumFileStorage::open(log->getFile(1));
+    auto bigFileStorage = BigFileStorage::open(log->getFile(2));
+    auto rv = std::make_unique<StorageVolumeImpl>(std::move(mainFile), std::move(stmFileStorage),
+            std::move(bigFileStorage), options, std::move(log));
+
+    rv->openImpl();
+
+    return rv;
+}
+
+StorageVolume::UniquePtr StorageVolume::create(WriteAheadLog::UniquePtr&& log, const Options& options)
+{
+    auto mainFile = log->getFile(0);
+    auto stmFileStorage = SmallToMediumFileStorage::create(log->getFile(1));
+    auto bigFileStorage = BigFileStorage::create(log->getFile(2));
     auto rv = std::make_unique<StorageVolumeImpl>(std::move(mainFile), std::move(stmFileStorage),
-            std::move(bigFileStorage));
+            std::move(bigFileStorage), options, std::move(log));
 
     rv->createImpl();
+    rv->flush();
 
     return rv;
 }
@@ -3,6 +3,7 @@
 #include "FileSystem.hpp"
 #include "SmallToMediumFileStorage.hpp"
 #include "BigFileStorage.hpp"
+#include "WriteAheadLog.hpp"
 #include "PHKVStorage.hpp"
 
 
@@ -17,26 +18,121 @@ public:
     using TimePoint = PHKVStorage::TimePoint;
     using TimePointOpt = PHKVStorage::TimePointOpt;
     using DirEntry = PHKVStorage::DirEntry;
+    using ScanOptions = PHKVStorage::ScanOptions;
+    using ScanEntry = PHKVStorage::ScanEntry;
+    using WriteBatch = PHKVStorage::WriteBatch;
+    using DirStructure = PHKVStorage::DirStructure;
+
+    struct Options{
+        //Max number of skip list nodes kept in memory. Modified nodes are written
+        //to main file on eviction or flush. 0 disables cache.
+        size_t nodeCacheSize{1024};
+        //Dir structure of created volume, structure of opened volume is read from its file
+        DirStructure dirStructure{DirStructure::skipList};
+        //Nodes of created volume are aligned to pages of this size, so reading node touches one page.
+        //Must be power of 2 not greater than 16384, 0 places nodes one after another.
+        size_t nodePageSize{0};
+        //Max number of entries in node of created volume.
+        //0 selects 16 or, if nodePageSize is set, as many entries as fit into page.
+        size_t nodeEntriesCount{0};
+        //Maintain hash index of entries of all dirs of created volume, so lookup reads nodes of key
+        //directly instead of descending through dir structure. Every insert and erase updates index as well.
+        bool hashIndex{false};
+        //Maintain Bloom filter of entry names of every dir of created volume,
+        //filters of used dirs are kept in memory, so most lookups of missing keys don't read volume
+        bool dirFilters{false};
+    };
 
     static UniquePtr open(FileSystem::UniqueFilePtr&& mainFile,
                                                SmallToMediumFileStorage::UniquePtr&& stmFileStorage,
                                                BigFileStorage::UniquePtr&& bigFileStorage);
+    static UniquePtr open(FileSystem::UniqueFilePtr&& mainFile,
+                          SmallToMediumFileStorage::UniquePtr&& stmFileStorage,
+                          BigFileStorage::UniquePtr&& bigFileStorage,
+                          const Options& options);
     static UniquePtr create(FileSystem::UniqueFilePtr&& mainFile,
                                                  SmallToMediumFileStorage::UniquePtr&& stmFileStorage,
                                                  BigFileStorage::UniquePtr&& bigFileStorage);
+    static UniquePtr create(FileSystem::UniqueFilePtr&& mainFile,
+                            SmallToMediumFileStorage::UniquePtr&& stmFileStorage,
+                            BigFileStorage::UniquePtr&& bigFileStorage,
+                            const Options& options);
+
+    //Files of volume are accessed through write-ahead log.
+    //Data files of log must be main, small to medium and big storage files in this order.
+    //Each modifying operation is committed to the log as a whole.
+    static UniquePtr open(WriteAheadLog::UniquePtr&& log, const Options& options);
+    static UniquePtr create(WriteAheadLog::UniquePtr&& log, const Options& options);
 
     static void initFileLogger(const boost::filesystem::path& filePath, size_t maxSize, size_t maxFiles);
     static void initStdoutLogger();
 
+    //lookup, lookupMany, getDirEntries, scanDir, hasExpiredKeys and dump can be called concurrently with each other,
+    //but not with modifying operations and flush.
+
     virtual void store(boost::string_view keyPath, const ValueType& value, TimePointOpt expTime = {}) = 0;
 
     virtual boost::optional<ValueType> lookup(boost::string_view keyPath) = 0;
 
+    //Same as lookup, expTime is set to expiration time of found key
+    virtual boost::optional<ValueType> lookup(boost::string_view keyPath, TimePointOpt& expTime) = 0;
+
+    //Lookup multiple keys, result is in order of keyPaths.
+    //Keys of the same dir are looked up with single pass through dir list.
+    virtual std::vector<boost::optional<ValueType>> lookupMany(const std::vector<boost::string_view>& keyPaths) = 0;
+
     virtual void eraseKey(boost::string_view keyPath) = 0;
     virtual void eraseDirRecursive(boost::string_view dirPath) = 0;
 
+    //Apply batch with volume local key paths as a single operation.
+    //Operations are applied in key order, each modified node is written once.
+    virtual void write(const WriteBatch& batch) = 0;
+
     virtual boost::optional<std::vector<DirEntry>> getDirEntries(boost::string_view dirPath) = 0;
 
+    //Read up to options.batchSize entries of dir in name order, starting from options.from.
+    //List is positioned via upper levels and then walked node by node at level 0.
+    //Scan is continued by calling it again with from set to name of last entry + '\0'.
+    //Returns empty optional if dir doesn't exist.
+    virtual boost::optional<std::vector<ScanEntry>> scanDir(boost::string_view dirPath, const ScanOptions& options) = 0;
+
+    //Write all modified cached nodes to main file and sync write-ahead log, if any
+    virtual void flush() = 0;
+
+    //Check if there are changes that would be written by flush
+    virtual bool hasUnsyncedChanges() = 0;
+
+    //Check if expiration index has keys that are due for removal
+    virtual bool hasExpiredKeys() = 0;
+
+    //Erase expired keys with their key and value storage. Up to maxEntries entries of
+    //expiration index are processed, returns number of processed entries.
+    virtual size_t reapExpired(size_t maxEntries) = 0;
+
+    virtual DirStructure getDirStructure() = 0;
+
+    //Node layout of volume, page size is 0 if nodes aren't aligned
+    virtual size_t getNodePageSize() = 0;
+    virtual size_t getNodeEntriesCount() = 0;
+
+    virtual bool hasHashIndex() = 0;
+
+    virtual bool hasDirFilters() = 0;
+
+    //Approximate size of nodes, keys and values freed since volume was opened
+    virtual uint64_t getFreedSize() = 0;
+
+    //Online compaction. Live keys are copied to target, volume created on empty files,
+    //in path order by copyStep calls. Modifications of already copied keys made between steps
+    //are applied to target as well, so once copying is complete target has the same content.
+    virtual void startCopy(StorageVolume& target) = 0;
+
+    //Copy up to maxKeys next keys, returns false when all keys were copied
+    virtual bool copyStep(size_t maxKeys) = 0;
+
+    //Stop applying modifications to target
+    virtual void stopCopy() = 0;
+
     virtual void dump(const std::function<void(const std::string&)>& out) = 0;
 
     virtual ~StorageVolume() = default;
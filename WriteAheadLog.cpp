@@ -0,0 +1,758 @@
+#include "WriteAheadLog.hpp"
+
+#include <array>
+#include <map>
+#include <stdexcept>
+#include <string.h>
+
+#include <boost/crc.hpp>
+#include <fmt/format.h>
+
+#include "FileVersion.hpp"
+#include "FileMagic.hpp"
+#include "UIntArrayHexFormatter.hpp"
+#include "InputBinBuffer.hpp"
+#include "OutputBinBuffer.hpp"
+
+namespace phkvs {
+namespace {
+
+class WriteAheadLogImpl : public WriteAheadLog {
+public:
+    WriteAheadLogImpl(FileSystem::UniqueFilePtr&& logFile, std::vector<FileSystem::UniqueFilePtr>&& dataFiles,
+                      const Options& options);
+
+    FileSystem::UniqueFilePtr getFile(size_t index) override;
+
+    void commit() override;
+
+    void sync() override;
+
+    bool hasPendingChanges() const override;
+
+    void checkpoint() override;
+
+    void openImpl();
+
+    void createImpl();
+
+    static void replayImpl(IRandomAccessFile& logFile, const std::vector<IRandomAccessFile*>& dataFiles);
+
+    void readAt(size_t index, OffsetType offset, boost::asio::mutable_buffer buf);
+
+    void readAtMany(size_t index, const std::vector<IRandomAccessFile::ReadRequest>& requests);
+
+    void readAtVectored(size_t index, OffsetType offset, const std::vector<boost::asio::mutable_buffer>& bufs);
+
+    void writeAt(size_t index, OffsetType offset, boost::asio::const_buffer buf);
+
+    OffsetType getSize(size_t index);
+
+    boost::asio::const_buffer viewAt(size_t index, OffsetType offset, size_t size);
+
+    void truncate(size_t index, OffsetType size);
+
+    const boost::filesystem::path& getFilename(size_t index) const;
+
+private:
+    static const FileMagic s_magic;
+    static const FileVersion s_currentVersion;
+    static constexpr size_t k_headerSize = FileMagic::binSize() + FileVersion::binSize();
+    static constexpr size_t k_pageSize = 4096;
+    static constexpr size_t k_recordHeaderSize = sizeof(uint64_t) /*seq*/ + sizeof(uint32_t) /*payload size*/;
+    static constexpr size_t k_recordCrcSize = sizeof(uint32_t);
+    static constexpr size_t k_maxExtentSize = 16 * 1024 * 1024;
+
+    struct Page {
+        std::array<uint8_t, k_pageSize> data;
+        size_t dirtyBegin{k_pageSize};
+        size_t dirtyEnd{0};
+
+        bool isDirty() const
+        {
+            return dirtyBegin < dirtyEnd;
+        }
+    };
+
+    struct DataFile {
+        FileSystem::UniqueFilePtr file;
+        //size of underlying file
+        OffsetType fileSize{0};
+        //size of file with pending changes
+        OffsetType size{0};
+        //data of underlying file beyond this size was truncated by pending changes
+        OffsetType validSize{0};
+        std::map<OffsetType, Page> pages;
+
+        bool isModified() const
+        {
+            return !pages.empty() || validSize != fileSize || size != fileSize;
+        }
+    };
+
+    static uint32_t calcCrc(boost::asio::const_buffer buf);
+
+    static void applyRecord(InputBinBuffer& in, const std::vector<IRandomAccessFile*>& dataFiles);
+
+    void readUnderlying(DataFile& dataFile, OffsetType offset, uint8_t* data, size_t size);
+
+    Page& getPageForWrite(DataFile& dataFile, OffsetType pageIndex, bool fullOverwrite);
+
+    size_t calcRecordPayloadSize();
+
+    void serializeRecordPayload(OutputBinBuffer& out);
+
+    std::vector<IRandomAccessFile*> getDataFilesPtrs();
+
+    FileSystem::UniqueFilePtr m_logFile;
+    std::vector<DataFile> m_dataFiles;
+    Options m_options;
+    OffsetType m_logEnd{0};
+    uint64_t m_lastSeq{0};
+    size_t m_pendingSize{0};
+};
+
+const FileMagic WriteAheadLogImpl::s_magic{{'P', 'H', 'W', 'L'}};
+const FileVersion WriteAheadLogImpl::s_currentVersion{0x0001, 0x0000};
+
+class LoggedFile : public IRandomAccessFile {
+public:
+    LoggedFile(WriteAheadLogImpl& log, size_t index) : m_log(log), m_index(index)
+    {
+    }
+
+    void read(boost::asio::mutable_buffer buf) override
+    {
+        m_log.readAt(m_index, m_position, buf);
+        m_position += buf.size();
+    }
+
+    void write(boost::asio::const_buffer buf) override
+    {
+        m_log.writeAt(m_index, m_position, buf);
+        m_position += buf.size();
+    }
+
+    void seek(OffsetType offset) override
+    {
+        auto fileSize = m_log.getSize(m_index);
+        if(offset > fileSize)
+        {
+            throw std::runtime_error(
+                fmt::format("[{}]seek attempt to set file position to {}, beyond file size {}",
+                            getFilename().string(), offset, fileSize));
+        }
+        m_position = offset;
+    }
+
+    OffsetType seekEnd() override
+    {
+        m_position = m_log.getSize(m_index);
+        return m_position;
+    }
+
+    void readAt(OffsetType offset, boost::asio::mutable_buffer buf) override
+    {
+        m_log.readAt(m_index, offset, buf);
+    }
+
+    void readAtMany(const std::vector<ReadRequest>& requests) override
+    {
+        m_log.readAtMany(m_index, requests);
+    }
+
+    void readAtVectored(OffsetType offset, const std::vector<boost::asio::mutable_buffer>& bufs) override
+    {
+        m_log.readAtVectored(m_index, offset, bufs);
+    }
+
+    void writeAt(OffsetType offset, boost::asio::const_buffer buf) override
+    {
+        m_log.writeAt(m_index, offset, buf);
+    }
+
+    OffsetType getSize() override
+    {
+        return m_log.getSize(m_index);
+    }
+
+    boost::asio::const_buffer viewAt(OffsetType offset, size_t size) override
+    {
+        return m_log.viewAt(m_index, offset, size);
+    }
+
+    void sync() override
+    {
+        m_log.sync();
+    }
+
+    void truncate(OffsetType size) override
+    {
+        m_log.truncate(m_index, size);
+    }
+
+    const boost::filesystem::path& getFilename() const override
+    {
+        return m_log.getFilename(m_index);
+    }
+
+private:
+    WriteAheadLogImpl& m_log;
+    size_t m_index;
+    OffsetType m_position{0};
+};
+
+WriteAheadLogImpl::WriteAheadLogImpl(FileSystem::UniqueFilePtr&& logFile,
+                                     std::vector<FileSystem::UniqueFilePtr>&& dataFiles,
+                                     const Options& options) :
+    m_logFile(std::move(logFile)), m_options(options)
+{
+    m_dataFiles.resize(dataFiles.size());
+    for(size_t i = 0; i < dataFiles.size(); ++i)
+    {
+        m_dataFiles[i].file = std::move(dataFiles[i]);
+    }
+}
+
+void WriteAheadLogImpl::openImpl()
+{
+    auto fileSize = m_logFile->getSize();
+    if(fileSize < k_headerSize)
+    {
+        throw std::runtime_error(
+            fmt::format("WriteAheadLog::open: Unexpected file size of {}:{}",
+                        m_logFile->getFilename().string(), fileSize));
+    }
+    replayImpl(*m_logFile, getDataFilesPtrs());
+    m_logEnd = k_headerSize;
+    for(auto& dataFile:m_dataFiles)
+    {
+        dataFile.fileSize = dataFile.file->getSize();
+        dataFile.size = dataFile.fileSize;
+        dataFile.validSize = dataFile.fileSize;
+    }
+}
+
+void WriteAheadLogImpl::createImpl()
+{
+    auto fileSize = m_logFile->getSize();
+    if(fileSize != 0)
+    {
+        throw std::runtime_error(fmt::format("WriteAheadLog::create: file {} must be empty, but size={}",
+                                             m_logFile->getFilename().string(), fileSize));
+    }
+    std::array<uint8_t, k_headerSize> headerData{};
+    auto buf = boost::asio::buffer(headerData);
+    OutputBinBuffer out(buf);
+    s_magic.serialize(out);
+    s_currentVersion.serialize(out);
+    m_logFile->writeAt(0, buf);
+    m_logFile->sync();
+    m_logEnd = k_headerSize;
+    for(auto& dataFile:m_dataFiles)
+    {
+        dataFile.fileSize = dataFile.file->getSize();
+        dataFile.size = dataFile.fileSize;
+        dataFile.validSize = dataFile.fileSize;
+    }
+}
+
+void WriteAheadLogImpl::replayImpl(IRandomAccessFile& logFile, const std::vector<IRandomAccessFile*>& dataFiles)
+{
+    auto fileSize = logFile.getSize();
+    std::array<uint8_t, k_headerSize> headerData{};
+    auto headerBuf = boost::asio::buffer(headerData);
+    logFile.readAt(0, headerBuf);
+    InputBinBuffer headerIn(headerBuf);
+    FileMagic magic;
+    magic.deserialize(headerIn);
+    if(magic != s_magic)
+    {
+        throw std::runtime_error(
+            fmt::format("WriteAheadLog::replay: invalid magic in file {}. Expected {}, but found {}",
+                        logFile.getFilename().string(), s_magic, magic));
+    }
+    FileVersion version{0, 0};
+    version.deserialize(headerIn);
+    if(version != s_currentVersion)
+    {
+        throw std::runtime_error(
+            fmt::format("WriteAheadLog::replay: invalid version of file {}. Expected {}, but found {}",
+                        logFile.getFilename().string(), s_currentVersion, version));
+    }
+
+    OffsetType offset = k_headerSize;
+    uint64_t lastSeq = 0;
+    std::vector<uint8_t> record;
+    //Records are applied until the first incomplete or corrupted one,
+    //which is the one that was being written during crash.
+    while(offset + k_recordHeaderSize + k_recordCrcSize <= fileSize)
+    {
+        std::array<uint8_t, k_recordHeaderSize> recordHeader{};
+        auto recordHeaderBuf = boost::asio::buffer(recordHeader);
+        logFile.readAt(offset, recordHeaderBuf);
+        InputBinBuffer in(recordHeaderBuf);
+        uint64_t seq = in.readU64();
+        size_t payloadSize = in.readU32();
+        size_t recordSize = k_recordHeaderSize + payloadSize + k_recordCrcSize;
+        if(offset + recordSize > fileSize || (lastSeq != 0 && seq != lastSeq + 1))
+        {
+            break;
+        }
+        record.resize(recordSize);
+        logFile.readAt(offset, boost::asio::buffer(record));
+        InputBinBuffer crcIn(boost::asio::buffer(record.data() + recordSize - k_recordCrcSize, k_recordCrcSize));
+        if(crcIn.readU32() != calcCrc(boost::asio::buffer(record.data(), recordSize - k_recordCrcSize)))
+        {
+            break;
+        }
+        InputBinBuffer payloadIn(boost::asio::buffer(record.data() + k_recordHeaderSize, payloadSize));
+        applyRecord(payloadIn, dataFiles);
+        lastSeq = seq;
+        offset += recordSize;
+    }
+    for(auto dataFile:dataFiles)
+    {
+        dataFile->sync();
+    }
+    logFile.truncate(k_headerSize);
+    logFile.sync();
+}
+
+uint32_t WriteAheadLogImpl::calcCrc(boost::asio::const_buffer buf)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(buf.data(), buf.size());
+    return crc.checksum();
+}
+
+void WriteAheadLogImpl::applyRecord(InputBinBuffer& in, const std::vector<IRandomAccessFile*>& dataFiles)
+{
+    size_t filesCount = in.readU8();
+    for(size_t i = 0; i < filesCount; ++i)
+    {
+        size_t index = in.readU8();
+        if(index >= dataFiles.size())
+        {
+            throw std::runtime_error(fmt::format("WriteAheadLog: invalid data file index {} in log record", index));
+        }
+        auto& file = *dataFiles[index];
+        OffsetType validSize = in.readU64();
+        OffsetType size = in.readU64();
+        uint32_t extentsCount = in.readU32();
+        if(validSize < file.getSize())
+        {
+            file.truncate(validSize);
+        }
+        for(uint32_t j = 0; j < extentsCount; ++j)
+        {
+            OffsetType offset = in.readU64();
+            size_t length = in.readU32();
+            file.writeAt(offset, in.viewAndAdvance(length));
+        }
+        if(file.getSize() != size)
+        {
+            file.truncate(size);
+        }
+    }
+}
+
+std::vector<IRandomAccessFile*> WriteAheadLogImpl::getDataFilesPtrs()
+{
+    std::vector<IRandomAccessFile*> rv;
+    for(auto& dataFile:m_dataFiles)
+    {
+        rv.push_back(dataFile.file.get());
+    }
+    return rv;
+}
+
+FileSystem::UniqueFilePtr WriteAheadLogImpl::getFile(size_t index)
+{
+    if(index >= m_dataFiles.size())
+    {
+        throw std::out_of_range(fmt::format("WriteAheadLog::getFile: invalid index {}", index));
+    }
+    return std::make_unique<LoggedFile>(*this, index);
+}
+
+void WriteAheadLogImpl::commit()
+{
+    if(m_pendingSize >= m_options.groupCommitSize)
+    {
+        sync();
+    }
+}
+
+size_t WriteAheadLogImpl::calcRecordPayloadSize()
+{
+    size_t rv = 1;//files count
+    for(auto& dataFile:m_dataFiles)
+    {
+        if(!dataFile.isModified())
+        {
+            continue;
+        }
+        rv += 1 + sizeof(uint64_t) * 2 + sizeof(uint32_t);
+        OffsetType extentEnd = 0;
+        size_t extentSize = 0;
+        for(auto& p:dataFile.pages)
+        {
+            auto& page = p.second;
+            if(!page.isDirty())
+            {
+                continue;
+            }
+            OffsetType pageOffset = p.first * k_pageSize;
+            size_t dirtySize = page.dirtyEnd - page.dirtyBegin;
+            if(extentSize == 0 || extentEnd != pageOffset + page.dirtyBegin ||
+               extentSize + dirtySize > k_maxExtentSize)
+            {
+                rv += sizeof(uint64_t) + sizeof(uint32_t);
+                extentSize = 0;
+            }
+            rv += dirtySize;
+            extentSize += dirtySize;
+            extentEnd = pageOffset + page.dirtyEnd;
+        }
+    }
+    return rv;
+}
+
+void WriteAheadLogImpl::serializeRecordPayload(OutputBinBuffer& out)
+{
+    size_t filesCount = 0;
+    for(auto& dataFile:m_dataFiles)
+    {
+        if(dataFile.isModified())
+        {
+            ++filesCount;
+        }
+    }
+    out.writeU8(static_cast<uint8_t>(filesCount));
+    for(size_t i = 0; i < m_dataFiles.size(); ++i)
+    {
+        auto& dataFile = m_dataFiles[i];
+        if(!dataFile.isModified())
+        {
+            continue;
+        }
+        out.writeU8(static_cast<uint8_t>(i));
+        out.writeU64(dataFile.validSize);
+        out.writeU64(dataFile.size);
+
+        //adjacent dirty ranges of consecutive pages are merged into a single extent
+        struct Extent {
+            OffsetType offset;
+            size_t size;
+            std::vector<boost::asio::const_buffer> parts;
+        };
+        std::vector<Extent> extents;
+        for(auto& p:dataFile.pages)
+        {
+            auto& page = p.second;
+            if(!page.isDirty())
+            {
+                continue;
+            }
+            OffsetType pageOffset = p.first * k_pageSize;
+            size_t dirtySize = page.dirtyEnd - page.dirtyBegin;
+            if(extents.empty() || extents.back().offset + extents.back().size != pageOffset + page.dirtyBegin ||
+               extents.back().size + dirtySize > k_maxExtentSize)
+            {
+                extents.push_back({pageOffset + page.dirtyBegin, 0, {}});
+            }
+            extents.back().size += dirtySize;
+            extents.back().parts.emplace_back(page.data.data() + page.dirtyBegin, dirtySize);
+        }
+        out.writeU32(static_cast<uint32_t>(extents.size()));
+        for(auto& extent:extents)
+        {
+            out.writeU64(extent.offset);
+            out.writeU32(static_cast<uint32_t>(extent.size));
+            for(auto part:extent.parts)
+            {
+                out.writeBufAndAdvance(part, part.size());
+            }
+        }
+    }
+}
+
+bool WriteAheadLogImpl::hasPendingChanges() const
+{
+    for(auto& dataFile:m_dataFiles)
+    {
+        if(dataFile.isModified())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WriteAheadLogImpl::sync()
+{
+    if(!hasPendingChanges())
+    {
+        return;
+    }
+    size_t payloadSize = calcRecordPayloadSize();
+    std::vector<uint8_t> record(k_recordHeaderSize + payloadSize + k_recordCrcSize);
+    OutputBinBuffer out(boost::asio::buffer(record));
+    out.writeU64(m_lastSeq + 1);
+    out.writeU32(static_cast<uint32_t>(payloadSize));
+    serializeRecordPayload(out);
+    out.writeU32(calcCrc(boost::asio::buffer(record.data(), record.size() - k_recordCrcSize)));
+
+    m_logFile->writeAt(m_logEnd, boost::asio::buffer(record));
+    m_logFile->sync();
+    m_logEnd += record.size();
+    ++m_lastSeq;
+
+    InputBinBuffer in(boost::asio::buffer(record.data() + k_recordHeaderSize, payloadSize));
+    applyRecord(in, getDataFilesPtrs());
+    for(auto& dataFile:m_dataFiles)
+    {
+        dataFile.pages.clear();
+        dataFile.fileSize = dataFile.size;
+        dataFile.validSize = dataFile.size;
+    }
+    m_pendingSize = 0;
+
+    if(m_logEnd >= m_options.checkpointSize)
+    {
+        checkpoint();
+    }
+}
+
+void WriteAheadLogImpl::checkpoint()
+{
+    sync();
+    if(m_logEnd == k_headerSize)
+    {
+        return;
+    }
+    for(auto& dataFile:m_dataFiles)
+    {
+        dataFile.file->sync();
+    }
+    m_logFile->truncate(k_headerSize);
+    m_logFile->sync();
+    m_logEnd = k_headerSize;
+}
+
+void WriteAheadLogImpl::readUnderlying(DataFile& dataFile, OffsetType offset, uint8_t* data, size_t size)
+{
+    size_t fromFile = 0;
+    if(offset < dataFile.validSize)
+    {
+        fromFile = static_cast<size_t>(std::min<OffsetType>(size, dataFile.validSize - offset));
+        dataFile.file->readAt(offset, boost::asio::buffer(data, fromFile));
+    }
+    //data beyond the end of underlying file is not written yet
+    memset(data + fromFile, 0, size - fromFile);
+}
+
+WriteAheadLogImpl::Page&
+WriteAheadLogImpl::getPageForWrite(DataFile& dataFile, OffsetType pageIndex, bool fullOverwrite)
+{
+    auto it = dataFile.pages.find(pageIndex);
+    if(it != dataFile.pages.end())
+    {
+        return it->second;
+    }
+    auto& page = dataFile.pages[pageIndex];
+    if(!fullOverwrite)
+    {
+        readUnderlying(dataFile, pageIndex * k_pageSize, page.data.data(), k_pageSize);
+    }
+    return page;
+}
+
+void WriteAheadLogImpl::readAt(size_t index, OffsetType offset, boost::asio::mutable_buffer buf)
+{
+    auto& dataFile = m_dataFiles[index];
+    if(offset + buf.size() > dataFile.size)
+    {
+        throw std::runtime_error(
+            fmt::format("[{}]readAt {} requested {} bytes beyond file size {}",
+                        getFilename(index).string(), offset, buf.size(), dataFile.size));
+    }
+    auto data = static_cast<uint8_t*>(buf.data());
+    size_t remaining = buf.size();
+    auto it = dataFile.pages.lower_bound(offset / k_pageSize);
+    while(remaining)
+    {
+        OffsetType pageIndex = offset / k_pageSize;
+        size_t inPageOffset = offset % k_pageSize;
+        size_t amount;
+        if(it != dataFile.pages.end() && it->first == pageIndex)
+        {
+            amount = std::min(remaining, k_pageSize - inPageOffset);
+            memcpy(data, it->second.data.data() + inPageOffset, amount);
+            ++it;
+        }
+        else
+        {
+            //read everything up to the next modified page from underlying file at once
+            OffsetType end = offset + remaining;
+            if(it != dataFile.pages.end())
+            {
+                end = std::min(end, it->first * k_pageSize);
+            }
+            amount = static_cast<size_t>(end - offset);
+            readUnderlying(dataFile, offset, data, amount);
+        }
+        offset += amount;
+        data += amount;
+        remaining -= amount;
+    }
+}
+
+void WriteAheadLogImpl::readAtMany(size_t index, const std::vector<IRandomAccessFile::ReadRequest>& requests)
+{
+    auto& dataFile = m_dataFiles[index];
+    //requests that don't touch modified pages are read from underlying file at once
+    std::vector<IRandomAccessFile::ReadRequest> underlying;
+    for(auto& request : requests)
+    {
+        size_t size = request.buf.size();
+        if(size && request.offset + size <= dataFile.validSize)
+        {
+            auto it = dataFile.pages.lower_bound(request.offset / k_pageSize);
+            if(it == dataFile.pages.end() || it->first > (request.offset + size - 1) / k_pageSize)
+            {
+                underlying.push_back(request);
+                continue;
+            }
+        }
+        readAt(index, request.offset, request.buf);
+    }
+    dataFile.file->readAtMany(underlying);
+}
+
+void WriteAheadLogImpl::readAtVectored(size_t index, OffsetType offset,
+                                       const std::vector<boost::asio::mutable_buffer>& bufs)
+{
+    auto& dataFile = m_dataFiles[index];
+    size_t size = boost::asio::buffer_size(bufs);
+    if(size && offset + size <= dataFile.validSize)
+    {
+        auto it = dataFile.pages.lower_bound(offset / k_pageSize);
+        if(it == dataFile.pages.end() || it->first > (offset + size - 1) / k_pageSize)
+        {
+            dataFile.file->readAtVectored(offset, bufs);
+            return;
+        }
+    }
+    for(auto& buf : bufs)
+    {
+        readAt(index, offset, buf);
+        offset += buf.size();
+    }
+}
+
+void WriteAheadLogImpl::writeAt(size_t index, OffsetType offset, boost::asio::const_buffer buf)
+{
+    auto& dataFile = m_dataFiles[index];
+    auto data = static_cast<const uint8_t*>(buf.data());
+    size_t remaining = buf.size();
+    dataFile.size = std::max(dataFile.size, offset + buf.size());
+    m_pendingSize += buf.size();
+    while(remaining)
+    {
+        OffsetType pageIndex = offset / k_pageSize;
+        size_t inPageOffset = offset % k_pageSize;
+        size_t amount = std::min(remaining, k_pageSize - inPageOffset);
+        auto& page = getPageForWrite(dataFile, pageIndex, amount == k_pageSize);
+        memcpy(page.data.data() + inPageOffset, data, amount);
+        page.dirtyBegin = std::min(page.dirtyBegin, inPageOffset);
+        page.dirtyEnd = std::max(page.dirtyEnd, inPageOffset + amount);
+        offset += amount;
+        data += amount;
+        remaining -= amount;
+    }
+}
+
+WriteAheadLogImpl::OffsetType WriteAheadLogImpl::getSize(size_t index)
+{
+    return m_dataFiles[index].size;
+}
+
+boost::asio::const_buffer WriteAheadLogImpl::viewAt(size_t index, OffsetType offset, size_t size)
+{
+    auto& dataFile = m_dataFiles[index];
+    if(size == 0 || offset + size > dataFile.size)
+    {
+        return {};
+    }
+    OffsetType firstPage = offset / k_pageSize;
+    OffsetType lastPage = (offset + size - 1) / k_pageSize;
+    auto it = dataFile.pages.lower_bound(firstPage);
+    if(it == dataFile.pages.end() || it->first > lastPage)
+    {
+        if(offset + size > dataFile.validSize)
+        {
+            return {};
+        }
+        return dataFile.file->viewAt(offset, size);
+    }
+    if(firstPage == lastPage)
+    {
+        return {it->second.data.data() + offset % k_pageSize, size};
+    }
+    return {};
+}
+
+void WriteAheadLogImpl::truncate(size_t index, OffsetType size)
+{
+    auto& dataFile = m_dataFiles[index];
+    if(size < dataFile.size)
+    {
+        OffsetType firstRemovedPage = (size + k_pageSize - 1) / k_pageSize;
+        dataFile.pages.erase(dataFile.pages.lower_bound(firstRemovedPage), dataFile.pages.end());
+        size_t inPageSize = size % k_pageSize;
+        auto it = dataFile.pages.find(size / k_pageSize);
+        if(inPageSize && it != dataFile.pages.end())
+        {
+            auto& page = it->second;
+            memset(page.data.data() + inPageSize, 0, k_pageSize - inPageSize);
+            page.dirtyEnd = std::min(page.dirtyEnd, inPageSize);
+        }
+        dataFile.validSize = std::min(dataFile.validSize, size);
+    }
+    dataFile.size = size;
+    ++m_pendingSize;
+}
+
+const boost::filesystem::path& WriteAheadLogImpl::getFilename(size_t index) const
+{
+    return m_dataFiles[index].file->getFilename();
+}
+
+}
+
+WriteAheadLog::UniquePtr WriteAheadLog::open(FileSystem::UniqueFilePtr&& logFile,
+                                             std::vector<FileSystem::UniqueFilePtr>&& dataFiles,
+                                             const Options& options)
+{
+    auto rv = std::make_unique<WriteAheadLogImpl>(std::move(logFile), std::move(dataFiles), options);
+    rv->openImpl();
+    return rv;
+}
+
+WriteAheadLog::UniquePtr WriteAheadLog::create(FileSystem::UniqueFilePtr&& logFile,
+                                               std::vector<FileSystem::UniqueFilePtr>&& dataFiles,
+                                               const Options& options)
+{
+    auto rv = std::make_unique<WriteAheadLogImpl>(std::move(logFile), std::move(dataFiles), options);
+    rv->createImpl();
+    return rv;
+}
+
+void WriteAheadLog::replay(IRandomAccessFile& logFile, const std::vector<IRandomAccessFile*>& dataFiles)
+{
+    WriteAheadLogImpl::replayImpl(logFile, dataFiles);
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+
+#include "FileSystem.hpp"
+
+namespace phkvs{
+
+//Redo log for a set of data files.
+//Writes made through files returned by getFile are kept in memory until sync.
+//sync appends all of them as a single checksummed record to the log file,
+//flushes the log file and only then applies the record to the data files.
+//Record that wasn't completely written is ignored on replay, so data files
+//either get all changes of a group or none of them.
+class WriteAheadLog{
+public:
+
+    using UniquePtr = std::unique_ptr<WriteAheadLog>;
+    using OffsetType = IRandomAccessFile::OffsetType;
+
+    struct Options{
+        //Size of pending changes that triggers sync on commit
+        size_t groupCommitSize{1024 * 1024};
+        //Size of log that triggers checkpoint, i.e. sync of data files and truncation of log
+        size_t checkpointSize{16 * 1024 * 1024};
+    };
+
+    //Replay log into data files, data files are synced and log is truncated.
+    static UniquePtr open(FileSystem::UniqueFilePtr&& logFile, std::vector<FileSystem::UniqueFilePtr>&& dataFiles,
+                          const Options& options);
+    static UniquePtr create(FileSystem::UniqueFilePtr&& logFile, std::vector<FileSystem::UniqueFilePtr>&& dataFiles,
+                            const Options& options);
+
+    //Replay log into data files without creating WriteAheadLog object.
+    static void replay(IRandomAccessFile& logFile, const std::vector<IRandomAccessFile*>& dataFiles);
+
+    //Return file which writes go through log.
+    //WriteAheadLog object must outlive returned file.
+    virtual FileSystem::UniqueFilePtr getFile(size_t index) = 0;
+
+    //Mark the end of atomic operation.
+    //Sync is performed if size of pending changes exceeds groupCommitSize.
+    virtual void commit() = 0;
+
+    //Write pending changes into log, flush log and apply changes to data files.
+    //Must be called between operations.
+    virtual void sync() = 0;
+
+    //Check if there are changes that weren't synced yet.
+    virtual bool hasPendingChanges() const = 0;
+
+    //Flush data files and truncate log.
+    virtual void checkpoint() = 0;
+
+    //Changes that weren't synced are discarded on destruction.
+    virtual ~WriteAheadLog() = default;
+};
+
+}
@@ -31,6 +31,7 @@ int main()
             {
                 PHKVStorage::Options opt;
                 opt.cachePoolSize = 200000;
+                opt.cacheShardsCount = 16;
                 auto storage = phkvs::PHKVStorage::create(opt);
                 executeBenchmark(fmt::format("create {} volumes", NVolumes), [&storage, NVolumes]() {
                     for(size_t i = 0; i < NVolumes; ++i)
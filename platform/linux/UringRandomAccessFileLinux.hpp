@@ -0,0 +1,255 @@
+#pragma once
+
+#include "../posix/RandomAccessFilePosix.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+
+namespace phkvs{
+
+//File with batched reads submitted via io_uring.
+//Single reads and writes use pread/pwrite, ring is used by readAtMany only,
+//so independent reads of batch are served in parallel with one syscall.
+//If ring can't be created (old kernel, seccomp), readAtMany falls back to pread.
+class UringRandomAccessFile : public RandomAccessFile {
+    friend class FileSystem;
+
+public:
+
+    UringRandomAccessFile(boost::filesystem::path filename, Handle&& handle) :
+        RandomAccessFile(std::move(filename), std::move(handle))
+    {
+        setupRing();
+    }
+
+    ~UringRandomAccessFile() override
+    {
+        closeRing();
+    }
+
+    void readAtMany(const std::vector<ReadRequest>& requests) override
+    {
+        if(requests.size() > 1)
+        {
+            std::lock_guard<std::mutex> guard(m_ringMtx);
+            if(m_ringFd != -1)
+            {
+                for(size_t begin = 0; begin < requests.size(); begin += m_sqEntries)
+                {
+                    size_t count = std::min<size_t>(m_sqEntries, requests.size() - begin);
+                    submitAndWait(&requests[begin], count);
+                }
+                return;
+            }
+        }
+        RandomAccessFile::readAtMany(requests);
+    }
+
+private:
+    static constexpr unsigned k_ringEntries = 64;
+
+    static int ioUringSetup(unsigned entries, io_uring_params* params)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    void setupRing()
+    {
+        io_uring_params params{};
+        int fd = ioUringSetup(k_ringEntries, &params);
+        if(fd == -1)
+        {
+            return;
+        }
+        m_ringFd = fd;
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+        singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+        if(singleMmap)
+        {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+        m_sqRing = mapRing(m_sqRingSize, IORING_OFF_SQ_RING);
+        m_cqRing = singleMmap ? m_sqRing : mapRing(m_cqRingSize, IORING_OFF_CQ_RING);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe*>(mapRing(m_sqesSize, IORING_OFF_SQES));
+        if(!m_sqRing || !m_cqRing || !m_sqes)
+        {
+            closeRing();
+            return;
+        }
+        auto sqRing = static_cast<uint8_t*>(m_sqRing);
+        m_sqTail = reinterpret_cast<unsigned*>(sqRing + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned*>(sqRing + params.sq_off.ring_mask);
+        m_sqEntries = params.sq_entries;
+        //sqes are always submitted in order, so array is identity
+        auto sqArray = reinterpret_cast<unsigned*>(sqRing + params.sq_off.array);
+        for(unsigned i = 0; i < m_sqEntries; ++i)
+        {
+            sqArray[i] = i;
+        }
+        auto cqRing = static_cast<uint8_t*>(m_cqRing);
+        m_cqHead = reinterpret_cast<unsigned*>(cqRing + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(cqRing + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned*>(cqRing + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+        m_iovecs.resize(m_sqEntries);
+    }
+
+    void* mapRing(size_t size, off_t offset)
+    {
+        void* rv = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, offset);
+        return rv == MAP_FAILED ? nullptr : rv;
+    }
+
+    void closeRing()
+    {
+        if(m_sqes)
+        {
+            munmap(m_sqes, m_sqesSize);
+            m_sqes = nullptr;
+        }
+        if(m_cqRing && m_cqRing != m_sqRing)
+        {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        m_cqRing = nullptr;
+        if(m_sqRing)
+        {
+            munmap(m_sqRing, m_sqRingSize);
+            m_sqRing = nullptr;
+        }
+        if(m_ringFd != -1)
+        {
+            ::close(m_ringFd);
+            m_ringFd = -1;
+        }
+    }
+
+    void submitAndWait(const ReadRequest* requests, size_t count)
+    {
+        unsigned tail = *m_sqTail;
+        for(size_t i = 0; i < count; ++i)
+        {
+            auto& iov = m_iovecs[i];
+            iov.iov_base = requests[i].buf.data();
+            iov.iov_len = requests[i].buf.size();
+            auto& sqe = m_sqes[(tail + i) & m_sqMask];
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READV;
+            sqe.fd = m_handle.get();
+            sqe.off = requests[i].offset;
+            sqe.addr = reinterpret_cast<uint64_t>(&iov);
+            sqe.len = 1;
+            sqe.user_data = i;
+        }
+        __atomic_store_n(m_sqTail, tail + static_cast<unsigned>(count), __ATOMIC_RELEASE);
+
+        size_t submitted = 0;
+        size_t completed = 0;
+        int submitError = 0;
+        //errors are reported after all submitted reads are completed,
+        //so kernel doesn't write into buffers of the caller after return
+        std::exception_ptr error;
+        while(completed < submitted || (!submitError && submitted < count))
+        {
+            unsigned toSubmit = submitError ? 0 : static_cast<unsigned>(count - submitted);
+            int ret = ioUringEnter(m_ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS);
+            if(ret == -1)
+            {
+                int err = errno;
+                if(err != EINTR && err != EAGAIN && err != EBUSY)
+                {
+                    if(submitError)
+                    {
+                        break;
+                    }
+                    submitError = err;
+                }
+            }
+            else if(!submitError)
+            {
+                submitted += static_cast<size_t>(ret);
+            }
+            completed += reapCompletions(requests, error);
+        }
+        if(submitError)
+        {
+            //unsubmitted sqes can't be taken back, so the ring isn't used anymore
+            closeRing();
+            throw fmt::system_error(submitError, "[{}]io_uring_enter error", m_filename.string());
+        }
+        if(error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    size_t reapCompletions(const ReadRequest* requests, std::exception_ptr& error)
+    {
+        size_t rv = 0;
+        unsigned head = *m_cqHead;
+        unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        for(; head != tail; ++head, ++rv)
+        {
+            auto& cqe = m_cqes[head & m_cqMask];
+            auto& request = requests[cqe.user_data];
+            if(error)
+            {
+                continue;
+            }
+            try
+            {
+                if(cqe.res < 0)
+                {
+                    throw fmt::system_error(-cqe.res, "[{}]readAtMany {} error", m_filename.string(),
+                                            request.offset);
+                }
+                size_t bytesRead = static_cast<size_t>(cqe.res);
+                if(bytesRead != request.buf.size())
+                {
+                    //short read, the rest is read or reported by pread
+                    RandomAccessFile::readAt(request.offset + bytesRead, request.buf + bytesRead);
+                }
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+            }
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+        return rv;
+    }
+
+    std::mutex m_ringMtx;
+    int m_ringFd = -1;
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+    unsigned* m_sqTail = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_sqEntries = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+    std::vector<iovec> m_iovecs;
+};
+
+}
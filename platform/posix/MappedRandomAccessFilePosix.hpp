@@ -0,0 +1,154 @@
+#pragma once
+
+#include "RandomAccessFilePosix.hpp"
+
+#include <sys/mman.h>
+#include <string.h>
+#include <algorithm>
+
+namespace phkvs{
+
+//Memory mapped file. Reads and in-place writes are served from the mapping,
+//writes beyond the end of file use pwrite and grow the mapping.
+//Mapping is reserved beyond the end of file in large chunks, so the file
+//can grow for a while without remapping.
+class MappedRandomAccessFile : public RandomAccessFile {
+    friend class FileSystem;
+
+public:
+
+    MappedRandomAccessFile(boost::filesystem::path filename, Handle&& handle) :
+        RandomAccessFile(std::move(filename), std::move(handle))
+    {
+        m_size = RandomAccessFile::getSize();
+        if(m_size)
+        {
+            remap(m_size);
+        }
+    }
+
+    ~MappedRandomAccessFile() override
+    {
+        unmap();
+    }
+
+    void write(boost::asio::const_buffer buf) override
+    {
+        RandomAccessFile::write(buf);
+        updateSize(RandomAccessFile::getSize());
+    }
+
+    void readAt(OffsetType offset, boost::asio::mutable_buffer buf) override
+    {
+        if(offset + buf.size() > m_size)
+        {
+            throw std::runtime_error(
+                fmt::format("[{}]readAt {} requested {} bytes beyond file size {}",
+                    m_filename.string(), offset, buf.size(), m_size));
+        }
+        memcpy(buf.data(), m_data + offset, buf.size());
+    }
+
+    void readAtVectored(OffsetType offset, const std::vector<boost::asio::mutable_buffer>& bufs) override
+    {
+        //copying from mapping is cheaper than preadv
+        IRandomAccessFile::readAtVectored(offset, bufs);
+    }
+
+    void writeAt(OffsetType offset, boost::asio::const_buffer buf) override
+    {
+        if(offset + buf.size() <= m_size)
+        {
+            memcpy(m_data + offset, buf.data(), buf.size());
+            return;
+        }
+        RandomAccessFile::writeAt(offset, buf);
+        updateSize(offset + buf.size());
+    }
+
+    OffsetType getSize() override
+    {
+        return m_size;
+    }
+
+    boost::asio::const_buffer viewAt(OffsetType offset, size_t size) override
+    {
+        if(offset + size > m_size)
+        {
+            return {};
+        }
+        return {m_data + offset, size};
+    }
+
+    void sync() override
+    {
+        if(m_data && m_size && msync(m_data, m_size, MS_SYNC) == -1)
+        {
+            int err = errno;
+            throw fmt::system_error(err, "[{}]msync error", m_filename.string());
+        }
+        RandomAccessFile::sync();
+    }
+
+    void truncate(OffsetType size) override
+    {
+        RandomAccessFile::truncate(size);
+        //mapping is kept, access beyond m_size is prevented by range checks
+        m_size = size;
+        if(m_size > m_mapSize)
+        {
+            remap(m_size);
+        }
+    }
+
+private:
+    static constexpr OffsetType k_minMapSize = 16 * 1024 * 1024;
+
+    void updateSize(OffsetType newSize)
+    {
+        if(newSize <= m_size)
+        {
+            return;
+        }
+        m_size = newSize;
+        if(m_size > m_mapSize)
+        {
+            remap(m_size);
+        }
+    }
+
+    void remap(OffsetType requiredSize)
+    {
+        //grow at least twice to keep amount of remaps logarithmic
+        OffsetType newMapSize = std::max(k_minMapSize, m_mapSize * 2);
+        while(newMapSize < requiredSize)
+        {
+            newMapSize *= 2;
+        }
+        unmap();
+        void* data = mmap(nullptr, newMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_handle.get(), 0);
+        if(data == MAP_FAILED)
+        {
+            int err = errno;
+            throw fmt::system_error(err, "[{}]mmap of {} bytes failed", m_filename.string(), newMapSize);
+        }
+        m_data = static_cast<uint8_t*>(data);
+        m_mapSize = newMapSize;
+    }
+
+    void unmap()
+    {
+        if(m_data)
+        {
+            munmap(m_data, m_mapSize);
+            m_data = nullptr;
+            m_mapSize = 0;
+        }
+    }
+
+    uint8_t* m_data = nullptr;
+    OffsetType m_mapSize = 0;
+    OffsetType m_size = 0;
+};
+
+}
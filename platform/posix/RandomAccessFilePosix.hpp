@@ -3,8 +3,13 @@
 #include "IRandomAccessFile.hpp"
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <errno.h>
+#include <limits.h>
+
+#include <algorithm>
 
 #include <boost/filesystem.hpp>
 #include <fmt/format.h>
@@ -16,6 +21,8 @@ class RandomAccessFile : public IRandomAccessFile {
 
     static_assert(sizeof(OffsetType) == sizeof(off_t), "Expecting 64-bit file offset type");
 
+protected:
+
     struct Handle {
         int m_handle;
 
@@ -144,6 +151,122 @@ public:
         }
     }
 
+    void readAt(OffsetType offset, boost::asio::mutable_buffer buf) override
+    {
+        ssize_t ret = ::pread(m_handle.get(), buf.data(), buf.size(), static_cast<off_t>(offset));
+        if(ret == -1)
+        {
+            int err = errno;
+            throw fmt::system_error(err, "[{}]readAt {} error", m_filename.string(), offset);
+        }
+        if(buf.size() != static_cast<size_t>(ret))
+        {
+            throw std::runtime_error(
+                fmt::format("[{}]readAt {} requested {} bytes, but actually read {}",
+                    m_filename.string(), offset, buf.size(), ret));
+        }
+    }
+
+    void readAtVectored(OffsetType offset, const std::vector<boost::asio::mutable_buffer>& bufs) override
+    {
+        std::vector<iovec> iovecs;
+        iovecs.reserve(bufs.size());
+        size_t requested = 0;
+        for(auto& buf : bufs)
+        {
+            if(buf.size())
+            {
+                iovecs.push_back({buf.data(), buf.size()});
+                requested += buf.size();
+            }
+        }
+        size_t first = 0;
+        OffsetType currentOffset = offset;
+        while(first < iovecs.size())
+        {
+            int count = static_cast<int>(std::min<size_t>(iovecs.size() - first, IOV_MAX));
+            ssize_t ret = ::preadv(m_handle.get(), &iovecs[first], count, static_cast<off_t>(currentOffset));
+            if(ret == -1)
+            {
+                int err = errno;
+                if(err == EINTR)
+                {
+                    continue;
+                }
+                throw fmt::system_error(err, "[{}]readAtVectored {} error", m_filename.string(), offset);
+            }
+            if(ret == 0)
+            {
+                throw std::runtime_error(
+                    fmt::format("[{}]readAtVectored {} requested {} bytes, but actually read {}",
+                        m_filename.string(), offset, requested, currentOffset - offset));
+            }
+            currentOffset += static_cast<OffsetType>(ret);
+            //skip completely read buffers and continue with the rest of partially read one
+            size_t bytesRead = static_cast<size_t>(ret);
+            while(bytesRead && bytesRead >= iovecs[first].iov_len)
+            {
+                bytesRead -= iovecs[first].iov_len;
+                ++first;
+            }
+            if(bytesRead)
+            {
+                iovecs[first].iov_base = static_cast<uint8_t*>(iovecs[first].iov_base) + bytesRead;
+                iovecs[first].iov_len -= bytesRead;
+            }
+        }
+    }
+
+    void writeAt(OffsetType offset, boost::asio::const_buffer buf) override
+    {
+        ssize_t ret = ::pwrite(m_handle.get(), buf.data(), buf.size(), static_cast<off_t>(offset));
+        if(ret == -1)
+        {
+            int err = errno;
+            throw fmt::system_error(err, "[{}]writeAt {} error", m_filename.string(), offset);
+        }
+        if(buf.size() != static_cast<size_t>(ret))
+        {
+            throw std::runtime_error(
+                fmt::format("[{}]writeAt {} requested {} bytes, but actually written {}",
+                    m_filename.string(), offset, buf.size(), ret));
+        }
+    }
+
+    OffsetType getSize() override
+    {
+        struct stat st;
+        if(fstat(m_handle.get(), &st) == -1)
+        {
+            int err = errno;
+            throw fmt::system_error(err, "[{}]getSize error", m_filename.string());
+        }
+        return static_cast<OffsetType>(st.st_size);
+    }
+
+    boost::asio::const_buffer viewAt(OffsetType offset, size_t size) override
+    {
+        return {};
+    }
+
+    void sync() override
+    {
+        if(::fsync(m_handle.get()) == -1)
+        {
+            int err = errno;
+            throw fmt::system_error(err, "[{}]sync error", m_filename.string());
+        }
+    }
+
+    void truncate(OffsetType size) override
+    {
+        if(::ftruncate(m_handle.get(), static_cast<off_t>(size)) == -1)
+        {
+            int err = errno;
+            throw fmt::system_error(err, "[{}]truncate to {} error", m_filename.string(), size);
+        }
+    }
+
     const boost::filesystem::path& getFilename()const override
     {
         return m_filename;
@@ -154,7 +277,7 @@ public:
         return errno;
     }
 
-private:
+protected:
 
     static Handle open(const boost::filesystem::path& path)
     {
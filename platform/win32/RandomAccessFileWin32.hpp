@@ -144,6 +144,80 @@ public:
         }
     }
 
+    void readAt(OffsetType offset, boost::asio::mutable_buffer buf) override
+    {
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD actuallyRead = 0;
+        if(!ReadFile(m_handle.get(), buf.data(), buf.size(), &actuallyRead, &overlapped))
+        {
+            auto error = static_cast<int>(GetLastError());
+            throw fmt::windows_error(error, "[{}]readAt {} error", m_filename.string(), offset);
+        }
+        if(buf.size() != actuallyRead)
+        {
+            auto error = static_cast<int>(GetLastError());
+            throw fmt::windows_error(error, "[{}]readAt {} requested {} bytes, but actually read {}",
+                m_filename.string(), offset, buf.size(), actuallyRead);
+        }
+    }
+
+    void writeAt(OffsetType offset, boost::asio::const_buffer buf) override
+    {
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD actuallyWritten = 0;
+        if(!WriteFile(m_handle.get(), buf.data(), buf.size(), &actuallyWritten, &overlapped))
+        {
+            auto error = static_cast<int>(GetLastError());
+            throw fmt::windows_error(error, "[{}]writeAt {} error", m_filename.string(), offset);
+        }
+        if(buf.size() != actuallyWritten)
+        {
+            auto error = static_cast<int>(GetLastError());
+            throw fmt::windows_error(error, "[{}]writeAt {} requested {} bytes, but actually written {}",
+                m_filename.string(), offset, buf.size(), actuallyWritten);
+        }
+    }
+
+    OffsetType getSize() override
+    {
+        LARGE_INTEGER liFileSize;
+        if(!GetFileSizeEx(m_handle.get(), &liFileSize))
+        {
+            auto error = static_cast<int>(GetLastError());
+            throw fmt::windows_error(error, "[{}]getSize error", m_filename.string());
+        }
+        return static_cast<OffsetType>(liFileSize.QuadPart);
+    }
+
+    boost::asio::const_buffer viewAt(OffsetType offset, size_t size) override
+    {
+        return {};
+    }
+
+    void sync() override
+    {
+        if(!FlushFileBuffers(m_handle.get()))
+        {
+            auto error = static_cast<int>(GetLastError());
+            throw fmt::windows_error(error, "[{}]sync error", m_filename.string());
+        }
+    }
+
+    void truncate(OffsetType size) override
+    {
+        FILE_END_OF_FILE_INFO info;
+        info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+        if(!SetFileInformationByHandle(m_handle.get(), FileEndOfFileInfo, &info, sizeof(info)))
+        {
+            auto error = static_cast<int>(GetLastError());
+            throw fmt::windows_error(error, "[{}]truncate to {} error", m_filename.string(), size);
+        }
+    }
+
     const boost::filesystem::path& getFilename()const override
     {
         return m_filename;
@@ -130,3 +130,129 @@ TEST_F(BigFileStorageTest, WriteRead)
     }
 
 }
+
+TEST_F(BigFileStorageTest, Extents)
+{
+    using OffsetType = phkvs::BigFileStorage::OffsetType;
+    auto makeData = [](size_t size, size_t seed) {
+        std::vector<uint8_t> rv(size);
+        for(auto& v:rv)
+        {
+            v = static_cast<uint8_t>(++seed * 13);
+        }
+        return rv;
+    };
+    std::vector<std::pair<OffsetType, std::vector<uint8_t>>> offsetAndData;
+    OffsetType fileSize;
+    {
+        auto file = phkvs::FileSystem::createFileUnique(filename);
+        ASSERT_TRUE(file);
+        addToCleanup(filename);
+        auto storage = phkvs::BigFileStorage::create(std::move(file));
+        //sizes that fit one extent, few extents and more than max extent
+        for(size_t size : {300, 510, 511, 5000, 100000, 1000001, 40000000})
+        {
+            auto data = makeData(size, size);
+            offsetAndData.emplace_back(storage->allocateAndWrite(boost::asio::buffer(data)), std::move(data));
+        }
+        for(auto& p:offsetAndData)
+        {
+            std::vector<uint8_t> readData(p.second.size());
+            storage->read(p.first, boost::asio::buffer(readData));
+            EXPECT_EQ(p.second, readData);
+        }
+
+        //grow and shrink, offset is kept
+        for(size_t i = 0; i < offsetAndData.size(); ++i)
+        {
+            auto& p = offsetAndData[i];
+            p.second = makeData((i & 1) ? p.second.size() * 3 : p.second.size() / 3 + 1, i);
+            storage->overwrite(p.first, boost::asio::buffer(p.second));
+        }
+
+        //freed extents are reused
+        auto& freed = offsetAndData[4];
+        storage->free(freed.first);
+        fileSize = phkvs::FileSystem::openFileUnique(filename)->getSize();
+        freed.first = storage->allocateAndWrite(boost::asio::buffer(freed.second));
+        EXPECT_EQ(phkvs::FileSystem::openFileUnique(filename)->getSize(), fileSize);
+    }
+    {
+        auto file = phkvs::FileSystem::openFileUnique(filename);
+        ASSERT_TRUE(file);
+        auto storage = phkvs::BigFileStorage::open(std::move(file));
+        for(auto& p:offsetAndData)
+        {
+            std::vector<uint8_t> readData(p.second.size());
+            storage->read(p.first, boost::asio::buffer(readData));
+            EXPECT_EQ(p.second, readData);
+        }
+        //free lists are kept in file
+        auto& freed = offsetAndData[2];
+        storage->free(freed.first);
+        storage->allocateAndWrite(boost::asio::buffer(freed.second));
+        EXPECT_EQ(phkvs::FileSystem::openFileUnique(filename)->getSize(), fileSize);
+    }
+}
+
+TEST_F(BigFileStorageTest, PageChains)
+{
+    {
+        auto file = phkvs::FileSystem::createFileUnique(filename);
+        ASSERT_TRUE(file);
+        addToCleanup(filename);
+        phkvs::BigFileStorage::create(std::move(file));
+        //turn into file of version 1.0 with values in linked pages
+        file = phkvs::FileSystem::openFileUnique(filename);
+        ASSERT_TRUE(file);
+        std::array<uint8_t, 2> minorVersion{};
+        file->writeAt(6, boost::asio::buffer(minorVersion));
+    }
+    auto file = phkvs::FileSystem::openFileUnique(filename);
+    ASSERT_TRUE(file);
+    auto storage = phkvs::BigFileStorage::open(std::move(file));
+    using OffsetType = phkvs::BigFileStorage::OffsetType;
+    std::vector<std::pair<OffsetType, std::vector<uint8_t>>> offsetAndData;
+    auto makeData = [](size_t size, size_t seed) {
+        std::vector<uint8_t> data(size);
+        for(auto& v : data)
+        {
+            v = static_cast<uint8_t>(++seed);
+        }
+        return data;
+    };
+    auto check = [&]() {
+        for(auto& p : offsetAndData)
+        {
+            std::vector<uint8_t> readData(p.second.size(), 0);
+            storage->read(p.first, boost::asio::buffer(readData));
+            EXPECT_EQ(p.second, readData);
+        }
+    };
+    //contiguous chains, longer than one read run
+    for(size_t size : {1u, 504u, 505u, 50000u, 200000u, 500000u})
+    {
+        auto data = makeData(size, size);
+        offsetAndData.emplace_back(storage->allocateAndWrite(boost::asio::buffer(data)), std::move(data));
+    }
+    check();
+
+    //fragmented chains from freed pages
+    storage->free(offsetAndData[3].first);
+    storage->free(offsetAndData[1].first);
+    storage->free(offsetAndData[4].first);
+    offsetAndData.erase(offsetAndData.begin() + 3, offsetAndData.begin() + 5);
+    offsetAndData.erase(offsetAndData.begin() + 1);
+    for(size_t i = 0; i < 3; ++i)
+    {
+        auto data = makeData(90000, i);
+        offsetAndData.emplace_back(storage->allocateAndWrite(boost::asio::buffer(data)), std::move(data));
+    }
+    check();
+
+    //chain grows with pages at the end of file
+    auto& grown = offsetAndData.back();
+    grown.second = makeData(300000, 7);
+    storage->overwrite(grown.first, boost::asio::buffer(grown.second));
+    check();
+}
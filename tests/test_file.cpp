@@ -57,3 +57,160 @@ TEST_F(Files, OpenRead)
         EXPECT_EQ(data, dataRead);
     }
 }
+
+TEST_F(Files, ReadWriteAt)
+{
+    boost::filesystem::path fileName = "test.bin";
+    auto file = phkvs::FileSystem::createFileUnique(fileName);
+    ASSERT_TRUE(file) << "Failed to create file " << fileName;
+
+    addToCleanup(fileName);
+
+    std::vector<uint8_t> data = {1, 2, 3, 4, 5, 6, 7, 8};
+    file->writeAt(0, boost::asio::buffer(data));
+    EXPECT_EQ(file->getSize(), data.size());
+
+    std::vector<uint8_t> data2 = {9, 10, 11, 12};
+    file->writeAt(data.size(), boost::asio::buffer(data2));
+    file->writeAt(2, boost::asio::buffer(data2.data(), 2));
+    EXPECT_EQ(file->getSize(), data.size() + data2.size());
+
+    std::vector<uint8_t> dataRead(4);
+    file->readAt(0, boost::asio::buffer(dataRead));
+    EXPECT_EQ(dataRead, std::vector<uint8_t>({1, 2, 9, 10}));
+    file->readAt(data.size(), boost::asio::buffer(dataRead));
+    EXPECT_EQ(dataRead, data2);
+
+    //positional ops do not use file position
+    std::vector<uint8_t> dataSeq(2);
+    file->seek(4);
+    file->readAt(0, boost::asio::buffer(dataRead));
+    file->read(boost::asio::buffer(dataSeq));
+    EXPECT_EQ(dataSeq, std::vector<uint8_t>({5, 6}));
+
+    EXPECT_THROW(file->readAt(10, boost::asio::buffer(dataRead)), std::runtime_error);
+}
+
+TEST_F(Files, MappedReadWriteAt)
+{
+    using AccessMode = phkvs::FileSystem::AccessMode;
+    boost::filesystem::path fileName = "test.bin";
+    std::vector<uint8_t> data = {1, 2, 3, 4, 5, 6, 7, 8};
+    {
+        auto file = phkvs::FileSystem::createFileUnique(fileName, AccessMode::memoryMapped);
+        ASSERT_TRUE(file) << "Failed to create file " << fileName;
+
+        addToCleanup(fileName);
+
+        EXPECT_EQ(file->getSize(), 0);
+        file->writeAt(0, boost::asio::buffer(data));
+        EXPECT_EQ(file->getSize(), data.size());
+
+        //overwrite inside of mapping
+        uint8_t value = 0xff;
+        file->writeAt(3, boost::asio::buffer(&value, 1));
+        data[3] = value;
+
+        auto view = file->viewAt(0, data.size());
+        ASSERT_EQ(view.size(), data.size());
+        EXPECT_EQ(memcmp(view.data(), data.data(), data.size()), 0);
+        EXPECT_EQ(file->viewAt(4, data.size()).size(), 0);
+
+        //grow beyond initial mapping
+        const phkvs::IRandomAccessFile::OffsetType farOffset = 40 * 1024 * 1024;
+        file->writeAt(farOffset, boost::asio::buffer(data));
+        EXPECT_EQ(file->getSize(), farOffset + data.size());
+        std::vector<uint8_t> dataRead(data.size());
+        file->readAt(farOffset, boost::asio::buffer(dataRead));
+        EXPECT_EQ(data, dataRead);
+        file->readAt(0, boost::asio::buffer(dataRead));
+        EXPECT_EQ(data, dataRead);
+
+        EXPECT_THROW(file->readAt(farOffset + 1, boost::asio::buffer(dataRead)), std::runtime_error);
+    }
+    {
+        auto file = phkvs::FileSystem::openFileUnique(fileName);
+        ASSERT_TRUE(file) << "Failed to open file " << fileName;
+        std::vector<uint8_t> dataRead(data.size());
+        file->readAt(0, boost::asio::buffer(dataRead));
+        EXPECT_EQ(data, dataRead);
+    }
+}
+
+TEST_F(Files, ReadAtMany)
+{
+    using AccessMode = phkvs::FileSystem::AccessMode;
+    boost::filesystem::path fileName = "test.bin";
+    for(auto mode : {AccessMode::regular, AccessMode::uring})
+    {
+        auto file = phkvs::FileSystem::createFileUnique(fileName, mode);
+        ASSERT_TRUE(file) << "Failed to create file " << fileName;
+
+        addToCleanup(fileName);
+
+        std::vector<uint8_t> data(100000);
+        for(size_t i = 0; i < data.size(); ++i)
+        {
+            data[i] = static_cast<uint8_t>(i * 7);
+        }
+        file->writeAt(0, boost::asio::buffer(data));
+
+        //more requests than ring entries
+        const size_t requestsCount = 200;
+        std::vector<std::vector<uint8_t>> dataRead(requestsCount);
+        std::vector<phkvs::IRandomAccessFile::ReadRequest> requests;
+        for(size_t i = 0; i < requestsCount; ++i)
+        {
+            dataRead[i].resize(1 + i * 3);
+            requests.push_back({(requestsCount - i) * 401, boost::asio::buffer(dataRead[i])});
+        }
+        file->readAtMany(requests);
+        for(size_t i = 0; i < requestsCount; ++i)
+        {
+            auto offset = (requestsCount - i) * 401;
+            EXPECT_TRUE(std::equal(dataRead[i].begin(), dataRead[i].end(), data.begin() + offset)) << i;
+        }
+
+        requests.push_back({data.size() - 1, boost::asio::buffer(dataRead.back())});
+        EXPECT_THROW(file->readAtMany(requests), std::runtime_error);
+        //file is still usable after error
+        file->readAtMany({requests.begin(), requests.begin() + 2});
+    }
+}
+
+TEST_F(Files, ReadAtVectored)
+{
+    using AccessMode = phkvs::FileSystem::AccessMode;
+    boost::filesystem::path fileName = "test.bin";
+    for(auto mode : {AccessMode::regular, AccessMode::memoryMapped, AccessMode::uring})
+    {
+        auto file = phkvs::FileSystem::createFileUnique(fileName, mode);
+        ASSERT_TRUE(file) << "Failed to create file " << fileName;
+
+        addToCleanup(fileName);
+
+        std::vector<uint8_t> data(100000);
+        for(size_t i = 0; i < data.size(); ++i)
+        {
+            data[i] = static_cast<uint8_t>(i * 7);
+        }
+        file->writeAt(0, boost::asio::buffer(data));
+
+        //more buffers than preadv takes at once
+        const size_t buffersCount = 3000;
+        std::vector<uint8_t> dataRead(buffersCount * 31);
+        std::vector<boost::asio::mutable_buffer> bufs;
+        size_t pos = 0;
+        for(size_t i = 0; i < buffersCount; ++i)
+        {
+            size_t size = i % 31;
+            bufs.emplace_back(dataRead.data() + pos, size);
+            pos += size;
+        }
+        const size_t offset = 123;
+        file->readAtVectored(offset, bufs);
+        EXPECT_TRUE(std::equal(dataRead.begin(), dataRead.begin() + pos, data.begin() + offset)) << static_cast<int>(mode);
+
+        EXPECT_THROW(file->readAtVectored(data.size() - pos / 2, bufs), std::runtime_error);
+    }
+}
@@ -3,6 +3,7 @@
 #include <random>
 #include <chrono>
 #include <thread>
+#include <atomic>
 
 #include <fmt/format.h>
 
@@ -34,13 +35,19 @@ public:
         addToCleanup(path / (volumeName + ".phkvsmain"));
         addToCleanup(path / (volumeName + ".phkvsbig"));
         addToCleanup(path / (volumeName + ".phkvsstm"));
+        addToCleanup(path / (volumeName + ".phkvswal"));
+        addToCleanup(path / (volumeName + ".phkvscompact"));
+        addToCleanup(path / (volumeName + ".phkvsmain.compact"));
+        addToCleanup(path / (volumeName + ".phkvsbig.compact"));
+        addToCleanup(path / (volumeName + ".phkvsstm.compact"));
     }
 
     phkvs::PHKVStorage::VolumeId
     createMountAndCleanVolume(const boost::filesystem::path& volumePath, boost::string_view volumeName,
-                              boost::string_view mountPointPath)
+                              boost::string_view mountPointPath,
+                              boost::optional<phkvs::PHKVStorage::Durability> durability = {})
     {
-        auto rv = storage->createAndMountVolume(volumePath, volumeName, mountPointPath);
+        auto rv = storage->createAndMountVolume(volumePath, volumeName, mountPointPath, durability);
         addVolumeToCleanup(volumePath, std::string(volumeName.data(), volumeName.length()));
         return rv;
     }
@@ -61,6 +68,342 @@ TEST_F(PHKVStorageTest, createUnmountMount)
     EXPECT_TRUE(storage->lookup("/hello"));
 }
 
+TEST_F(PHKVStorageTest, memoryMappedMainFile)
+{
+    phkvs::PHKVStorage::Options opt;
+    opt.memoryMappedMainFile = true;
+    createStorage(opt);
+
+    auto volId = createMountAndCleanVolume(".", "test", "/");
+
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        storage->store(fmt::format("/foo/key{}", i), static_cast<uint32_t>(i));
+    }
+    storage->unmountVolume(volId);
+    storage->mountVolume(".", "test", "/");
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        auto valOpt = storage->lookup(fmt::format("/foo/key{}", i));
+        ASSERT_TRUE(valOpt);
+        EXPECT_EQ(boost::get<uint32_t>(*valOpt), i);
+    }
+}
+
+TEST_F(PHKVStorageTest, writeAheadLog)
+{
+    phkvs::PHKVStorage::Options opt;
+    opt.durability = phkvs::PHKVStorage::Durability::perOp;
+    createStorage(opt);
+
+    auto volId = createMountAndCleanVolume(".", "test", "/");
+
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        storage->store(fmt::format("/foo/key{}", i), fmt::format("value{}", i));
+    }
+    storage->eraseDirRecursive("/foo");
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        storage->store(fmt::format("/bar/key{}", i), fmt::format("value{}", i));
+    }
+    storage->unmountVolume(volId);
+    storage->mountVolume(".", "test", "/");
+    EXPECT_FALSE(storage->lookup("/foo/key1"));
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        auto valOpt = storage->lookup(fmt::format("/bar/key{}", i));
+        ASSERT_TRUE(valOpt);
+        EXPECT_EQ(boost::get<std::string>(*valOpt), fmt::format("value{}", i));
+    }
+}
+
+TEST_F(PHKVStorageTest, durabilityPerMount)
+{
+    using Durability = phkvs::PHKVStorage::Durability;
+    phkvs::PHKVStorage::Options opt;
+    opt.durability = Durability::periodic;
+    opt.syncInterval = std::chrono::milliseconds(5);
+    createStorage(opt);
+
+    createMountAndCleanVolume(".", "test1", "/periodic");
+    createMountAndCleanVolume(".", "test2", "/batch", Durability::perBatch);
+    createMountAndCleanVolume(".", "test3", "/op", Durability::perOp);
+
+    const size_t threadsCount = 4;
+    const size_t keysCount = 100;
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < threadsCount; ++t)
+    {
+        threads.emplace_back([this, t, keysCount]() {
+            for(size_t i = 0; i < keysCount; ++i)
+            {
+                for(auto dir : {"periodic", "batch", "op"})
+                {
+                    storage->store(fmt::format("/{}/key{}_{}", dir, t, i), static_cast<uint64_t>(t * keysCount + i));
+                }
+            }
+        });
+    }
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    //volumes must be mountable without log replay after storage destruction
+    storage.reset();
+    opt.durability = Durability::none;
+    createStorage(opt);
+    storage->mountVolume(".", "test1", "/periodic");
+    storage->mountVolume(".", "test2", "/batch");
+    storage->mountVolume(".", "test3", "/op");
+    for(size_t t = 0; t < threadsCount; ++t)
+    {
+        for(size_t i = 0; i < keysCount; ++i)
+        {
+            for(auto dir : {"periodic", "batch", "op"})
+            {
+                auto valOpt = storage->lookup(fmt::format("/{}/key{}_{}", dir, t, i));
+                ASSERT_TRUE(valOpt);
+                EXPECT_EQ(boost::get<uint64_t>(*valOpt), t * keysCount + i);
+            }
+        }
+    }
+}
+
+TEST_F(PHKVStorageTest, expirationInCache)
+{
+    createStorage();
+    auto volId = createMountAndCleanVolume(".", "test", "/");
+
+    auto expTime = std::chrono::system_clock::now() + std::chrono::milliseconds(300);
+    storage->store("/dir/expiring", uint32_t{1}, expTime);
+    storage->store("/dir/expiringBatch", uint32_t{2});
+    storage->store("/dir/live", uint32_t{3});
+    phkvs::PHKVStorage::WriteBatch batch;
+    batch.expire("/dir/expiringBatch", expTime);
+    storage->write(batch);
+    EXPECT_TRUE(storage->lookup("/dir/expiring"));
+    EXPECT_TRUE(storage->lookup("/dir/expiringBatch"));
+    auto entriesOpt = storage->getDirEntries("/dir");
+    ASSERT_TRUE(entriesOpt);
+    EXPECT_EQ(entriesOpt->size(), 3);
+
+    //expiration time is loaded into cache along with value
+    storage->unmountVolume(volId);
+    storage->mountVolume(".", "test", "/");
+    EXPECT_TRUE(storage->lookup("/dir/expiring"));
+    EXPECT_TRUE(storage->lookup("/dir/expiringBatch"));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    EXPECT_FALSE(storage->lookup("/dir/expiring"));
+    EXPECT_FALSE(storage->lookup("/dir/expiringBatch"));
+    EXPECT_TRUE(storage->lookup("/dir/live"));
+    auto values = storage->lookupMany({"/dir/expiring", "/dir/live"});
+    EXPECT_FALSE(values[0]);
+    EXPECT_TRUE(values[1]);
+    entriesOpt = storage->getDirEntries("/dir");
+    ASSERT_TRUE(entriesOpt);
+    ASSERT_EQ(entriesOpt->size(), 1);
+    EXPECT_EQ(entriesOpt->front().name, "live");
+}
+
+TEST_F(PHKVStorageTest, writeBatch)
+{
+    createStorage();
+    createMountAndCleanVolume(".", "test1", "/foo");
+    createMountAndCleanVolume(".", "test2", "/bar");
+    storage->store("/foo/erased", uint32_t{1});
+
+    phkvs::PHKVStorage::WriteBatch batch;
+    for(uint32_t i = 0; i < 100; ++i)
+    {
+        batch.store(fmt::format("/foo/key{}", i), i);
+        batch.store(fmt::format("/bar/dir/key{}", i), i);
+    }
+    batch.eraseKey("/foo/erased");
+    storage->write(batch);
+
+    for(uint32_t i = 0; i < 100; ++i)
+    {
+        auto valOpt = storage->lookup(fmt::format("/foo/key{}", i));
+        ASSERT_TRUE(valOpt);
+        EXPECT_EQ(boost::get<uint32_t>(*valOpt), i);
+        valOpt = storage->lookup(fmt::format("/bar/dir/key{}", i));
+        ASSERT_TRUE(valOpt);
+        EXPECT_EQ(boost::get<uint32_t>(*valOpt), i);
+    }
+    EXPECT_FALSE(storage->lookup("/foo/erased"));
+
+    batch.clear();
+    batch.store("/baz/key", uint32_t{1});
+    EXPECT_THROW(storage->write(batch), std::runtime_error);
+}
+
+TEST_F(PHKVStorageTest, lookupMany)
+{
+    createStorage();
+    auto volId1 = createMountAndCleanVolume(".", "test1", "/foo");
+    auto volId2 = createMountAndCleanVolume(".", "test2", "/bar");
+    for(uint32_t i = 0; i < 100; ++i)
+    {
+        storage->store(fmt::format("/foo/key{}", i), i);
+        storage->store(fmt::format("/bar/dir/key{}", i), i + 1000);
+    }
+    storage->unmountVolume(volId1);
+    storage->unmountVolume(volId2);
+    storage->mountVolume(".", "test1", "/foo");
+    storage->mountVolume(".", "test2", "/bar");
+
+    std::vector<std::string> keyPaths;
+    for(uint32_t i = 0; i < 110; i += 3)
+    {
+        keyPaths.push_back(fmt::format("/bar/dir/key{}", i));
+        keyPaths.push_back(fmt::format("/foo/key{}", i));
+    }
+    keyPaths.push_back("/baz/key1");
+    std::vector<boost::string_view> keyPathViews(keyPaths.begin(), keyPaths.end());
+    auto values = storage->lookupMany(keyPathViews);
+    ASSERT_EQ(values.size(), keyPaths.size());
+    for(size_t i = 0; i + 1 < keyPaths.size(); i += 2)
+    {
+        uint32_t key = static_cast<uint32_t>(i / 2 * 3);
+        if(key < 100)
+        {
+            ASSERT_TRUE(values[i]);
+            EXPECT_EQ(boost::get<uint32_t>(*values[i]), key + 1000);
+            ASSERT_TRUE(values[i + 1]);
+            EXPECT_EQ(boost::get<uint32_t>(*values[i + 1]), key);
+        }
+        else
+        {
+            EXPECT_FALSE(values[i]);
+            EXPECT_FALSE(values[i + 1]);
+        }
+    }
+    EXPECT_FALSE(values.back());
+}
+
+TEST_F(PHKVStorageTest, cachePoolReuseOfDirs)
+{
+    phkvs::PHKVStorage::Options opt;
+    //cached dirs are reused while they have content
+    opt.cachePoolSize = 16;
+    createStorage(opt);
+    createMountAndCleanVolume(".", "test1", "/foo");
+    createMountAndCleanVolume(".", "test2", "/bar");
+
+    const size_t keysCount = 300;
+    for(size_t i = 0; i < keysCount; ++i)
+    {
+        for(auto dir : {"foo", "bar"})
+        {
+            storage->store(fmt::format("/{}/dir{}/sub{}/key{}", dir, i % 10, i % 3, i), static_cast<uint32_t>(i));
+        }
+    }
+    for(size_t i = 0; i < keysCount; ++i)
+    {
+        for(auto dir : {"foo", "bar"})
+        {
+            auto valOpt = storage->lookup(fmt::format("/{}/dir{}/sub{}/key{}", dir, i % 10, i % 3, i));
+            ASSERT_TRUE(valOpt);
+            EXPECT_EQ(boost::get<uint32_t>(*valOpt), i);
+        }
+    }
+}
+
+TEST_F(PHKVStorageTest, cacheShards)
+{
+    phkvs::PHKVStorage::Options opt;
+    opt.cacheShardsCount = 8;
+    createStorage(opt);
+    createMountAndCleanVolume(".", "test1", "/");
+    createMountAndCleanVolume(".", "test2", "/mnt");
+
+    const size_t threadsCount = 4;
+    const size_t dirsCount = 20;
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < threadsCount; ++t)
+    {
+        threads.emplace_back([this, t, dirsCount]() {
+            for(size_t i = 0; i < 100; ++i)
+            {
+                auto key = fmt::format("/dir{}/key{}_{}", i % dirsCount, t, i);
+                storage->store(key, static_cast<uint32_t>(i));
+                auto valOpt = storage->lookup(key);
+                ASSERT_TRUE(valOpt);
+                EXPECT_EQ(boost::get<uint32_t>(*valOpt), i);
+            }
+        });
+    }
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+    storage->store("/rootKey", uint32_t{1});
+    storage->store("/mnt/key", uint32_t{1});
+
+    //root dir is merged from all shards
+    auto entriesOpt = storage->getDirEntries("/");
+    ASSERT_TRUE(entriesOpt);
+    ASSERT_EQ(entriesOpt->size(), dirsCount + 2);
+    EXPECT_TRUE(std::is_sorted(entriesOpt->begin(), entriesOpt->end(),
+            [](const phkvs::PHKVStorage::DirEntry& l, const phkvs::PHKVStorage::DirEntry& r) {
+                return l.name < r.name;
+            }));
+    entriesOpt = storage->getDirEntries("/dir1");
+    ASSERT_TRUE(entriesOpt);
+    EXPECT_EQ(entriesOpt->size(), threadsCount * 100 / dirsCount);
+
+    storage->eraseDirRecursive("/dir1");
+    EXPECT_FALSE(storage->lookup("/dir1/key0_1"));
+    EXPECT_TRUE(storage->lookup("/dir2/key0_2"));
+    EXPECT_TRUE(storage->lookup("/mnt/key"));
+}
+
+TEST_F(PHKVStorageTest, concurrentLookupsAndStores)
+{
+    phkvs::PHKVStorage::Options opt;
+    opt.cacheShardsCount = 8;
+    createStorage(opt);
+    auto volId = createMountAndCleanVolume(".", "test1", "/");
+
+    const size_t keysCount = 1000;
+    for(size_t i = 0; i < keysCount; ++i)
+    {
+        storage->store(fmt::format("/dir{}/key{}", i % 10, i), static_cast<uint32_t>(i));
+    }
+    //cache is empty after remount, so dirs of different shards are read from volume concurrently
+    storage->unmountVolume(volId);
+    storage->mountVolume(".", "test1", "/");
+    std::atomic<bool> stop{false};
+    std::thread writer([this, &stop]() {
+        for(size_t i = 0; !stop; ++i)
+        {
+            storage->store(fmt::format("/other/key{}", i % 100), static_cast<uint32_t>(i));
+        }
+    });
+    const size_t readersCount = 4;
+    std::vector<std::thread> readers;
+    for(size_t t = 0; t < readersCount; ++t)
+    {
+        readers.emplace_back([this, t, keysCount]() {
+            for(size_t i = t; i < keysCount; i += readersCount)
+            {
+                auto valOpt = storage->lookup(fmt::format("/dir{}/key{}", i % 10, i));
+                ASSERT_TRUE(valOpt);
+                EXPECT_EQ(boost::get<uint32_t>(*valOpt), i);
+            }
+        });
+    }
+    for(auto& thread : readers)
+    {
+        thread.join();
+    }
+    stop = true;
+    writer.join();
+}
+
 TEST_F(PHKVStorageTest, mountMultiple)
 {
     createStorage();
@@ -238,6 +581,187 @@ TEST_F(PHKVStorageTest, getDirEntriesBasic)
     EXPECT_TRUE(subDirs.empty());
 }
 
+TEST_F(PHKVStorageTest, scanDir)
+{
+    createStorage();
+    auto volId = createMountAndCleanVolume(".", "test1", "/foo");
+    for(size_t i = 0; i < 300; i += 2)
+    {
+        storage->store(fmt::format("/foo/key{:03}", i), static_cast<uint32_t>(i));
+    }
+    storage->unmountVolume(volId);
+    createMountAndCleanVolume(".", "test2", "/");
+    for(size_t i = 0; i < 300; i += 3)
+    {
+        storage->store(fmt::format("/foo/key{:03}", i), static_cast<uint32_t>(i + 1000));
+    }
+    //keys of test2 hide keys of test1 with the same name, as it's mounted first now
+    storage->mountVolume(".", "test1", "/foo");
+    createMountAndCleanVolume(".", "test3", "/foo/mnt");
+
+    phkvs::PHKVStorage::ScanOptions options;
+    options.batchSize = 16;
+    options.withValues = true;
+    auto cursor = storage->scanDir("/foo", options);
+    ASSERT_TRUE(cursor);
+    std::vector<phkvs::PHKVStorage::ScanEntry> entries;
+    while(auto entry = cursor->next())
+    {
+        entries.push_back(std::move(*entry));
+    }
+    size_t idx = 0;
+    for(size_t i = 0; i < 300; ++i)
+    {
+        if(i % 2 != 0 && i % 3 != 0)
+        {
+            continue;
+        }
+        ASSERT_LT(idx, entries.size());
+        EXPECT_EQ(entries[idx].name, fmt::format("key{:03}", i));
+        ASSERT_TRUE(entries[idx].value);
+        EXPECT_EQ(boost::get<uint32_t>(*entries[idx].value), i % 3 == 0 ? i + 1000 : i);
+        ++idx;
+    }
+    ASSERT_EQ(entries.size(), idx + 1);
+    EXPECT_EQ(entries.back().name, "mnt");
+    EXPECT_EQ(entries.back().type, phkvs::PHKVStorage::EntryType::dir);
+
+    options = {};
+    options.prefix = "key1";
+    options.from = "key150";
+    cursor = storage->scanDir("/foo", options);
+    size_t count = 0;
+    while(auto entry = cursor->next())
+    {
+        EXPECT_GE(entry->name, "key150");
+        EXPECT_LT(entry->name, "key2");
+        ++count;
+    }
+    //multiples of 2 or 3 in [150, 200)
+    EXPECT_EQ(count, 33);
+
+    EXPECT_FALSE(storage->scanDir("/nodir")->next());
+}
+
+TEST_F(PHKVStorageTest, compactVolume)
+{
+    createStorage();
+    auto volId = createMountAndCleanVolume(".", "test", "/", phkvs::PHKVStorage::Durability::perOp);
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        storage->store(fmt::format("/dir{}/key{}", i % 10, i), std::string(1000, 'a' + i % 26));
+    }
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        if(i % 10 != 0)
+        {
+            storage->eraseKey(fmt::format("/dir{}/key{}", i % 10, i));
+        }
+    }
+    auto bigSize = boost::filesystem::file_size("test.phkvsbig");
+    auto mainSize = boost::filesystem::file_size("test.phkvsmain");
+    storage->compactVolume(volId);
+    EXPECT_LT(boost::filesystem::file_size("test.phkvsbig"), bigSize / 5);
+    EXPECT_LT(boost::filesystem::file_size("test.phkvsmain"), mainSize);
+    EXPECT_FALSE(boost::filesystem::exists("test.phkvsmain.compact"));
+
+    auto checkKeys = [this]() {
+        for(size_t i = 0; i < 1000; ++i)
+        {
+            auto val = storage->lookup(fmt::format("/dir{}/key{}", i % 10, i));
+            if(i % 10 != 0)
+            {
+                EXPECT_FALSE(val);
+                continue;
+            }
+            ASSERT_TRUE(val);
+            EXPECT_EQ(boost::get<std::string>(*val), std::string(1000, 'a' + i % 26));
+        }
+    };
+    checkKeys();
+    storage->store("/dir1/new", std::string("new"));
+    storage->unmountVolume(volId);
+    volId = storage->mountVolume(".", "test", "/");
+    checkKeys();
+    EXPECT_TRUE(storage->lookup("/dir1/new"));
+}
+
+TEST_F(PHKVStorageTest, bPlusTreeVolume)
+{
+    phkvs::PHKVStorage::Options options;
+    options.volumeDirStructure = phkvs::PHKVStorage::DirStructure::bPlusTree;
+    createStorage(options);
+    auto volId = createMountAndCleanVolume(".", "test", "/");
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        storage->store(fmt::format("/dir{}/key{}", i % 3, i), static_cast<uint32_t>(i));
+    }
+    storage->store("/dir0/expired", uint8_t{1}, std::chrono::system_clock::now() - std::chrono::seconds(10));
+    storage->compactVolume(volId);
+    storage->unmountVolume(volId);
+
+    //compacted volume keeps its structure, while new volumes are created with default one
+    createStorage();
+    storage->mountVolume(".", "test", "/");
+    storage->store("/dir3/key", uint8_t{1});
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        auto val = storage->lookup(fmt::format("/dir{}/key{}", i % 3, i));
+        ASSERT_TRUE(val);
+        EXPECT_EQ(boost::get<uint32_t>(*val), i);
+    }
+    EXPECT_FALSE(storage->lookup("/dir0/expired"));
+    auto entries = storage->getDirEntries("/dir1");
+    ASSERT_TRUE(entries);
+    EXPECT_EQ(entries->size(), 333);
+    EXPECT_TRUE(storage->lookup("/dir3/key"));
+}
+
+TEST_F(PHKVStorageTest, backgroundCompaction)
+{
+    phkvs::PHKVStorage::Options options;
+    options.compactionInterval = std::chrono::milliseconds(10);
+    options.compactionStepSize = 100;
+    options.compactionStepPause = std::chrono::milliseconds(1);
+    createStorage(options);
+    createMountAndCleanVolume(".", "test", "/");
+    for(size_t i = 0; i < 500; ++i)
+    {
+        storage->store(fmt::format("/dir/key{}", i), std::string(1000, 'x'));
+    }
+    auto bigSize = boost::filesystem::file_size("test.phkvsbig");
+    std::atomic_bool stop{false};
+    //modifications while compaction is in progress
+    std::thread writer([this, &stop]() {
+        for(size_t i = 0; !stop; ++i)
+        {
+            storage->store(fmt::format("/other/key{}", i % 100), static_cast<uint32_t>(i));
+        }
+    });
+    for(size_t i = 10; i < 500; ++i)
+    {
+        storage->eraseKey(fmt::format("/dir/key{}", i));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(boost::filesystem::file_size("test.phkvsbig") >= bigSize / 2 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    stop = true;
+    writer.join();
+    EXPECT_LT(boost::filesystem::file_size("test.phkvsbig"), bigSize / 2);
+    for(size_t i = 0; i < 10; ++i)
+    {
+        auto val = storage->lookup(fmt::format("/dir/key{}", i));
+        ASSERT_TRUE(val);
+        EXPECT_EQ(boost::get<std::string>(*val), std::string(1000, 'x'));
+    }
+    EXPECT_FALSE(storage->lookup("/dir/key10"));
+    auto entries = storage->getDirEntries("/other");
+    ASSERT_TRUE(entries);
+    EXPECT_EQ(entries->size(), 100);
+}
+
 TEST_F(PHKVStorageTest, storeConcurrent)
 {
     phkvs::PHKVStorage::Options opt;
@@ -290,3 +814,66 @@ TEST_F(PHKVStorageTest, storeConcurrent)
         thr.join();
     }
 }
+
+TEST_F(PHKVStorageTest, asyncOps)
+{
+    using Durability = phkvs::PHKVStorage::Durability;
+    phkvs::PHKVStorage::Options opt;
+    opt.syncInterval = std::chrono::milliseconds(5);
+    createStorage(opt);
+    createMountAndCleanVolume(".", "test1", "/foo");
+    createMountAndCleanVolume(".", "test2", "/bar", Durability::perBatch);
+
+    const size_t keysCount = 1000;
+    std::vector<std::future<void>> stores;
+    for(size_t i = 0; i < keysCount; ++i)
+    {
+        for(auto dir : {"foo", "bar"})
+        {
+            stores.push_back(storage->storeAsync(fmt::format("/{}/dir{}/key{}", dir, i % 10, i),
+                                                 static_cast<uint64_t>(i)));
+        }
+    }
+    //order of calls is preserved
+    for(size_t i = 0; i < keysCount; i += 2)
+    {
+        stores.push_back(storage->eraseAsync(fmt::format("/foo/dir{}/key{}", i % 10, i)));
+    }
+    auto lookupFuture = storage->lookupAsync("/foo/dir3/key3");
+    for(auto& f : stores)
+    {
+        f.get();
+    }
+    auto valOpt = lookupFuture.get();
+    ASSERT_TRUE(valOpt);
+    EXPECT_EQ(boost::get<uint64_t>(*valOpt), 3u);
+
+    std::atomic<size_t> found{0};
+    std::atomic<size_t> completed{0};
+    for(size_t i = 0; i < keysCount; ++i)
+    {
+        storage->lookupAsync(fmt::format("/foo/dir{}/key{}", i % 10, i),
+                             [&found, &completed, i](boost::optional<phkvs::PHKVStorage::ValueType> value,
+                                                     std::exception_ptr error) {
+                                 EXPECT_FALSE(error);
+                                 EXPECT_EQ(static_cast<bool>(value), (i & 1) != 0);
+                                 if(value && boost::get<uint64_t>(*value) == i)
+                                 {
+                                     ++found;
+                                 }
+                                 ++completed;
+                             });
+    }
+    for(size_t i = 0; i < keysCount; ++i)
+    {
+        EXPECT_EQ(boost::get<uint64_t>(*storage->lookupAsync(fmt::format("/bar/dir{}/key{}", i % 10, i)).get()), i);
+    }
+    while(completed != keysCount)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(found, keysCount / 2);
+
+    //errors are reported to handler
+    EXPECT_THROW(storage->storeAsync("/baz/key", static_cast<uint64_t>(1)).get(), std::exception);
+}
@@ -6,6 +6,7 @@
 #include "StringViewFormatter.hpp"
 #include "FileVersion.hpp"
 #include "KeyPathUtil.hpp"
+#include "LRUPriorityCachePool.hpp"
 
 TEST(SimpleTest, FormatIntArray)
 {
@@ -93,3 +94,71 @@ TEST(SimpleTest, KeyPathUtil)
     EXPECT_EQ(pathKey.path[1], "bar");
     EXPECT_EQ(pathKey.key, "baz");
 }
+
+namespace {
+struct PoolItem {
+    boost::intrusive::list_member_hook<> listNode;
+    uint8_t prio;
+    int value;
+    bool referenced;
+};
+}
+
+TEST(SimpleTest, LRUPriorityCachePoolSecondChance)
+{
+    std::vector<int> reused;
+    phkvs::LRUPriorityCachePool<PoolItem, &PoolItem::listNode, &PoolItem::prio, 2> pool(3, [&reused](PoolItem* item) {
+        reused.push_back(item->value);
+    });
+    pool.setSecondChance([](PoolItem* item) {
+        bool rv = item->referenced;
+        item->referenced = false;
+        return rv;
+    });
+    PoolItem* items[3];
+    for(int i = 0; i < 3; ++i)
+    {
+        items[i] = pool.allocate(1);
+        items[i]->value = i;
+        items[i]->referenced = false;
+    }
+    items[0]->referenced = true;
+    auto item = pool.allocate(1);
+    item->value = 3;
+    item->referenced = false;
+    //referenced least recently used item is skipped once
+    ASSERT_EQ(reused.size(), 1);
+    EXPECT_EQ(reused[0], 1);
+    item = pool.allocate(1);
+    ASSERT_EQ(reused.size(), 2);
+    EXPECT_EQ(reused[1], 2);
+}
+
+TEST(SimpleTest, LRUPriorityCachePoolReuseCandidate)
+{
+    std::vector<int> reused;
+    phkvs::LRUPriorityCachePool<PoolItem, &PoolItem::listNode, &PoolItem::prio, 2> pool(3, [&reused](PoolItem* item) {
+        reused.push_back(item->value);
+    });
+    PoolItem* candidate = nullptr;
+    pool.setReuseCandidate([&candidate]() {
+        return candidate;
+    });
+    PoolItem* items[3];
+    for(int i = 0; i < 3; ++i)
+    {
+        items[i] = pool.allocate(i == 2 ? 0 : 1);
+        items[i]->value = i;
+    }
+    //candidate is reused regardless of priority and usage order
+    candidate = items[2];
+    auto item = pool.allocate(1);
+    EXPECT_EQ(item, items[2]);
+    item->value = 3;
+    ASSERT_EQ(reused.size(), 1);
+    EXPECT_EQ(reused[0], 2);
+    candidate = nullptr;
+    pool.allocate(1);
+    ASSERT_EQ(reused.size(), 2);
+    EXPECT_EQ(reused[1], 0);
+}
@@ -2,6 +2,7 @@
 
 #include <random>
 #include <chrono>
+#include <map>
 #include <thread>
 
 #include <fmt/format.h>
@@ -48,9 +49,16 @@ public:
 
     void read(OffsetType offset, boost::asio::mutable_buffer buf) override
     {
+        ++m_readsCount;
         m_impl->read(offset, buf);
     }
 
+    void readMany(const std::vector<phkvs::IRandomAccessFile::ReadRequest>& requests) override
+    {
+        m_readsCount += requests.size();
+        m_impl->readMany(requests);
+    }
+
     void freeSlot(OffsetType offset, size_t size) override
     {
         auto it = m_offsetSizeMap.find(offset);
@@ -66,6 +74,7 @@ public:
 
     phkvs::SmallToMediumFileStorage::UniquePtr m_impl;
     std::map<OffsetType, size_t> m_offsetSizeMap;
+    size_t m_readsCount = 0;
 };
 
 class TrackingBigFileStorage : public phkvs::BigFileStorage {
@@ -115,6 +124,74 @@ public:
     std::map<OffsetType, size_t> m_offsetSizeMap;
 };
 
+class TrackingFile : public phkvs::IRandomAccessFile {
+public:
+    TrackingFile(phkvs::FileSystem::UniqueFilePtr&& impl) :
+        m_impl(std::move(impl))
+    {
+    }
+
+    void read(boost::asio::mutable_buffer buf) override
+    {
+        ++m_readsCount;
+        m_impl->read(buf);
+    }
+
+    void write(boost::asio::const_buffer buf) override
+    {
+        m_impl->write(buf);
+    }
+
+    void seek(OffsetType offset) override
+    {
+        m_impl->seek(offset);
+    }
+
+    OffsetType seekEnd() override
+    {
+        return m_impl->seekEnd();
+    }
+
+    void readAt(OffsetType offset, boost::asio::mutable_buffer buf) override
+    {
+        ++m_readsCount;
+        m_impl->readAt(offset, buf);
+    }
+
+    void writeAt(OffsetType offset, boost::asio::const_buffer buf) override
+    {
+        m_impl->writeAt(offset, buf);
+    }
+
+    OffsetType getSize() override
+    {
+        return m_impl->getSize();
+    }
+
+    boost::asio::const_buffer viewAt(OffsetType offset, size_t size) override
+    {
+        return m_impl->viewAt(offset, size);
+    }
+
+    void sync() override
+    {
+        m_impl->sync();
+    }
+
+    void truncate(OffsetType size) override
+    {
+        m_impl->truncate(size);
+    }
+
+    const boost::filesystem::path& getFilename() const override
+    {
+        return m_impl->getFilename();
+    }
+
+    phkvs::FileSystem::UniqueFilePtr m_impl;
+    size_t m_readsCount = 0;
+};
+
 class VolumeTest : public FilesCleanupFixture {
 public:
     boost::filesystem::path volumeFilename = "test-volume.bin";
@@ -127,6 +204,11 @@ public:
     std::mt19937 rng;
 
     void createStorageVolume()
+    {
+        createStorageVolume(phkvs::StorageVolume::Options());
+    }
+
+    void createStorageVolume(const phkvs::StorageVolume::Options& options)
     {
         auto mainFile = phkvs::FileSystem::createFileUnique(volumeFilename);
         ASSERT_TRUE(mainFile);
@@ -150,7 +232,27 @@ public:
         trackingBigStoragePtr = trackingBigStorage.get();
 
         volume = phkvs::StorageVolume::create(std::move(mainFile), std::move(trackingStmFileStorage),
-                                              std::move(trackingBigStorage));
+                                              std::move(trackingBigStorage), options);
+    }
+
+    void recreateStorageVolume(const phkvs::StorageVolume::Options& options)
+    {
+        volume.reset();
+        for(auto& path:{volumeFilename, stmFilename, bigFilename})
+        {
+            boost::filesystem::remove(path);
+        }
+        createStorageVolume(options);
+    }
+
+    void reopenStorageVolume(const phkvs::StorageVolume::Options& options)
+    {
+        volume.reset();
+        trackingStmStoragePtr = nullptr;
+        trackingBigStoragePtr = nullptr;
+        volume = phkvs::StorageVolume::open(phkvs::FileSystem::openFileUnique(volumeFilename),
+                phkvs::SmallToMediumFileStorage::open(phkvs::FileSystem::openFileUnique(stmFilename)),
+                phkvs::BigFileStorage::open(phkvs::FileSystem::openFileUnique(bigFilename)), options);
     }
 
     VolumeTest()
@@ -292,6 +394,178 @@ TEST_F(VolumeTest, InsertEraseRecursive)
     }
 }
 
+TEST_F(VolumeTest, NodeCacheWriteBack)
+{
+    phkvs::StorageVolume::Options options;
+    options.nodeCacheSize = 8;
+    reopenStorageVolume(options);
+
+    std::vector<std::pair<std::string, std::string>> keyValue;
+    for(size_t i = 0; i < 2000; ++i)
+    {
+        keyValue.emplace_back(fmt::format("/dir{}/key{}", i % 10, i), randomString(1, 300));
+        volume->store(keyValue.back().first, keyValue.back().second);
+    }
+    for(size_t i = 0; i < keyValue.size(); i += 3)
+    {
+        volume->eraseKey(keyValue[i].first);
+    }
+    auto check = [this, &keyValue]() {
+        for(size_t i = 0; i < keyValue.size(); ++i)
+        {
+            auto val = volume->lookup(keyValue[i].first);
+            if(i % 3 == 0)
+            {
+                EXPECT_FALSE(val) << "Key " << keyValue[i].first << " wasn't erased";
+                continue;
+            }
+            ASSERT_TRUE(val) << "Key " << keyValue[i].first << " not found";
+            EXPECT_EQ(boost::get<std::string>(*val), keyValue[i].second);
+        }
+    };
+    check();
+    reopenStorageVolume(phkvs::StorageVolume::Options{});
+    check();
+    options.nodeCacheSize = 0;
+    reopenStorageVolume(options);
+    check();
+}
+
+TEST_F(VolumeTest, ConcurrentLookups)
+{
+    phkvs::StorageVolume::Options options;
+    options.nodeCacheSize = 8;
+    reopenStorageVolume(options);
+
+    std::vector<std::pair<std::string, std::string>> keyValue;
+    for(size_t i = 0; i < 2000; ++i)
+    {
+        keyValue.emplace_back(fmt::format("/dir{}/key{}", i % 10, i), randomString(1, 300));
+        volume->store(keyValue.back().first, keyValue.back().second);
+    }
+    //modified nodes are evicted by lookups
+    const size_t threadsCount = 4;
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < threadsCount; ++t)
+    {
+        threads.emplace_back([this, t, &keyValue]() {
+            for(size_t i = t; i < keyValue.size(); i += 3)
+            {
+                auto val = volume->lookup(keyValue[i].first);
+                ASSERT_TRUE(val) << "Key " << keyValue[i].first << " not found";
+                EXPECT_EQ(boost::get<std::string>(*val), keyValue[i].second);
+            }
+            auto entries = volume->getDirEntries(fmt::format("/dir{}", t));
+            ASSERT_TRUE(entries);
+            EXPECT_EQ(entries->size(), keyValue.size() / 10);
+        });
+    }
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+    for(size_t i = 0; i < keyValue.size(); i += 2)
+    {
+        volume->eraseKey(keyValue[i].first);
+    }
+    reopenStorageVolume(phkvs::StorageVolume::Options{});
+    for(size_t i = 0; i < keyValue.size(); ++i)
+    {
+        auto val = volume->lookup(keyValue[i].first);
+        if(i % 2 == 0)
+        {
+            EXPECT_FALSE(val) << "Key " << keyValue[i].first << " wasn't erased";
+            continue;
+        }
+        ASSERT_TRUE(val) << "Key " << keyValue[i].first << " not found";
+        EXPECT_EQ(boost::get<std::string>(*val), keyValue[i].second);
+    }
+}
+
+TEST_F(VolumeTest, WriteBatch)
+{
+    volume->store("/dir0/expiring", uint8_t{1});
+    volume->store("/dir1/erased", uint8_t{1});
+
+    phkvs::StorageVolume::WriteBatch batch;
+    std::vector<std::pair<std::string, std::string>> keyValue;
+    //keys of different dirs are interleaved and not sorted
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        keyValue.emplace_back(fmt::format("/dir{}/key{}", (i * 7) % 3, (i * 37) % 1000), randomString(1, 100));
+        batch.store(keyValue.back().first, keyValue.back().second);
+    }
+    batch.expire("/dir0/expiring", std::chrono::system_clock::now() - std::chrono::seconds(1));
+    batch.eraseKey("/dir1/erased");
+    //ops on the same key are applied in order
+    batch.store("/dir2/overwritten", uint8_t{1});
+    batch.eraseKey("/dir2/overwritten");
+    batch.store("/dir2/overwritten", uint8_t{2});
+    volume->write(batch);
+
+    auto check = [this, &keyValue]() {
+        for(auto& p:keyValue)
+        {
+            auto val = volume->lookup(p.first);
+            ASSERT_TRUE(val) << "Key " << p.first << " not found";
+            EXPECT_EQ(boost::get<std::string>(*val), p.second);
+        }
+        EXPECT_FALSE(volume->lookup("/dir0/expiring"));
+        EXPECT_FALSE(volume->lookup("/dir1/erased"));
+        auto val = volume->lookup("/dir2/overwritten");
+        ASSERT_TRUE(val);
+        EXPECT_EQ(boost::get<uint8_t>(*val), 2);
+    };
+    check();
+    reopenStorageVolume(phkvs::StorageVolume::Options{});
+    check();
+}
+
+TEST_F(VolumeTest, LookupMany)
+{
+    phkvs::StorageVolume::Options options;
+    options.nodeCacheSize = 8;
+    reopenStorageVolume(options);
+
+    for(uint32_t i = 0; i < 1000; ++i)
+    {
+        volume->store(fmt::format("/dir{}/key{}", i % 3, i), i);
+    }
+    volume->store("/dir0/expired", uint8_t{1}, std::chrono::system_clock::now() - std::chrono::seconds(1));
+
+    std::vector<std::string> keyPaths;
+    std::vector<boost::optional<uint32_t>> expected;
+    for(uint32_t i = 0; i < 1100; i += 7)
+    {
+        //keys from the end of range are missing
+        keyPaths.push_back(fmt::format("/dir{}/key{}", i % 3, i));
+        expected.push_back(i < 1000 ? boost::make_optional(i) : boost::none);
+    }
+    std::shuffle(keyPaths.begin(), keyPaths.end(), rng);
+    keyPaths.push_back("/dir0/expired");
+    keyPaths.push_back("/missingDir/key1");
+    keyPaths.push_back("/dir1/key1");
+    keyPaths.push_back("/dir1/key1");
+
+    std::vector<boost::string_view> keyPathViews(keyPaths.begin(), keyPaths.end());
+    auto values = volume->lookupMany(keyPathViews);
+    ASSERT_EQ(values.size(), keyPaths.size());
+    for(size_t i = 0; i < keyPaths.size(); ++i)
+    {
+        auto single = volume->lookup(keyPaths[i]);
+        EXPECT_EQ(values[i].is_initialized(), single.is_initialized()) << keyPaths[i];
+        if(values[i] && single)
+        {
+            EXPECT_EQ(boost::get<uint32_t>(*values[i]), boost::get<uint32_t>(*single)) << keyPaths[i];
+        }
+    }
+    size_t expectedFound = std::count_if(expected.begin(), expected.end(),
+            [](const boost::optional<uint32_t>& v) { return v.is_initialized(); }) + 2;
+    EXPECT_EQ(static_cast<size_t>(std::count_if(values.begin(), values.end(),
+            [](const boost::optional<phkvs::StorageVolume::ValueType>& v) { return v.is_initialized(); })),
+            expectedFound);
+}
+
 TEST_F(VolumeTest, GetDirEntries)
 {
     std::string baseDir = "/foo/bar/";
@@ -332,6 +606,481 @@ TEST_F(VolumeTest, GetDirEntries)
     EXPECT_TRUE(subDirs.empty());
 }
 
+TEST_F(VolumeTest, ScanDir)
+{
+    const size_t keysCount = 1000;
+    for(size_t i = 0; i < keysCount; ++i)
+    {
+        volume->store(fmt::format("/dir/key{:04}", i), static_cast<uint32_t>(i));
+    }
+    volume->store("/dir/expired", uint8_t{1}, std::chrono::system_clock::now() - std::chrono::seconds(10));
+    volume->store("/dir/sub/key", uint8_t{1});
+
+    phkvs::StorageVolume::ScanOptions options;
+    options.batchSize = 64;
+    options.withValues = true;
+    std::vector<phkvs::StorageVolume::ScanEntry> entries;
+    for(;;)
+    {
+        auto batch = volume->scanDir("/dir", options);
+        ASSERT_TRUE(batch);
+        ASSERT_LE(batch->size(), options.batchSize);
+        if(batch->empty())
+        {
+            break;
+        }
+        options.from = batch->back().name + '\0';
+        std::move(batch->begin(), batch->end(), std::back_inserter(entries));
+    }
+    ASSERT_EQ(entries.size(), keysCount + 1);
+    for(size_t i = 0; i < keysCount; ++i)
+    {
+        EXPECT_EQ(entries[i].name, fmt::format("key{:04}", i));
+        ASSERT_TRUE(entries[i].value);
+        EXPECT_EQ(boost::get<uint32_t>(*entries[i].value), i);
+    }
+    EXPECT_EQ(entries.back().name, "sub");
+    EXPECT_EQ(entries.back().type, phkvs::PHKVStorage::EntryType::dir);
+
+    options = {};
+    options.prefix = "key05";
+    auto batch = volume->scanDir("/dir", options);
+    ASSERT_TRUE(batch);
+    ASSERT_EQ(batch->size(), 100);
+    EXPECT_EQ(batch->front().name, "key0500");
+    EXPECT_EQ(batch->back().name, "key0599");
+    EXPECT_FALSE(batch->front().value);
+
+    options.from = "key0550";
+    batch = volume->scanDir("/dir", options);
+    ASSERT_TRUE(batch);
+    ASSERT_EQ(batch->size(), 50);
+    EXPECT_EQ(batch->front().name, "key0550");
+
+    EXPECT_FALSE(volume->scanDir("/nodir", options));
+}
+
+TEST_F(VolumeTest, BPlusTreeDirs)
+{
+    phkvs::StorageVolume::Options options;
+    options.dirStructure = phkvs::StorageVolume::DirStructure::bPlusTree;
+    recreateStorageVolume(options);
+    EXPECT_EQ(volume->getDirStructure(), phkvs::StorageVolume::DirStructure::bPlusTree);
+
+    //short and long keys, so separators of inner nodes are both inplace and external
+    std::vector<std::string> names;
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        names.push_back(i % 3 ? fmt::format("key{:04}", i) : fmt::format("key{:04}-{}", i, std::string(20, 'x')));
+    }
+    std::map<std::string, uint32_t> model;
+    std::uniform_int_distribution<size_t> nameDis(0, names.size() - 1);
+    std::uniform_int_distribution<size_t> dirDis(0, 2);
+    for(size_t i = 0; i < 20000; ++i)
+    {
+        auto keyPath = fmt::format("/dir{}/{}", dirDis(rng), names[nameDis(rng)]);
+        //erase less often, so dirs grow to several tree levels
+        if(rng() % 3 == 0)
+        {
+            volume->eraseKey(keyPath);
+            model.erase(keyPath);
+        }
+        else
+        {
+            volume->store(keyPath, static_cast<uint32_t>(i));
+            model[keyPath] = static_cast<uint32_t>(i);
+        }
+    }
+    auto checkContent = [this, &model]() {
+        for(size_t d = 0; d < 3; ++d)
+        {
+            std::string dirPath = fmt::format("/dir{}/", d);
+            auto entries = volume->getDirEntries(dirPath);
+            ASSERT_TRUE(entries);
+            auto it = model.lower_bound(dirPath);
+            for(auto& entry:*entries)
+            {
+                ASSERT_NE(it, model.end());
+                EXPECT_EQ(dirPath + entry.name, it->first);
+                auto val = volume->lookup(it->first);
+                ASSERT_TRUE(val);
+                EXPECT_EQ(boost::get<uint32_t>(*val), it->second);
+                ++it;
+            }
+            EXPECT_TRUE(it == model.end() || it->first.compare(0, dirPath.length(), dirPath) != 0);
+        }
+    };
+    checkContent();
+
+    phkvs::StorageVolume::ScanOptions scanOptions;
+    scanOptions.from = "key0500";
+    scanOptions.batchSize = 10;
+    auto batch = volume->scanDir("/dir1", scanOptions);
+    ASSERT_TRUE(batch);
+    auto it = model.lower_bound("/dir1/key0500");
+    for(auto& entry:*batch)
+    {
+        ASSERT_NE(it, model.end());
+        EXPECT_EQ("/dir1/" + entry.name, it->first);
+        ++it;
+    }
+
+    //all nodes and separators are freed when dir becomes empty
+    for(auto& p:model)
+    {
+        if(p.first.compare(0, 6, "/dir0/") == 0 || p.first.compare(0, 6, "/dir1/") == 0)
+        {
+            volume->eraseKey(p.first);
+        }
+    }
+    volume->eraseDirRecursive("/dir2");
+    EXPECT_TRUE(trackingStmStoragePtr->m_offsetSizeMap.empty());
+    model.clear();
+    for(size_t i = 0; i < names.size(); ++i)
+    {
+        auto keyPath = fmt::format("/dir{}/{}", i % 3, names[i]);
+        volume->store(keyPath, static_cast<uint32_t>(i));
+        model[keyPath] = static_cast<uint32_t>(i);
+    }
+
+    reopenStorageVolume(phkvs::StorageVolume::Options());
+    EXPECT_EQ(volume->getDirStructure(), phkvs::StorageVolume::DirStructure::bPlusTree);
+    checkContent();
+}
+
+TEST_F(VolumeTest, LazyKeyLoading)
+{
+    //single node of entries with keys in small to medium storage
+    std::vector<std::string> keys;
+    for(size_t i = 0; i < 16; ++i)
+    {
+        keys.push_back(fmt::format("/dir/{:040}", i));
+        volume->store(keys.back(), static_cast<uint32_t>(i));
+    }
+    volume.reset();
+    auto stmStorage = std::make_unique<TrackingSmallToMediumFileStorage>(
+            phkvs::SmallToMediumFileStorage::open(phkvs::FileSystem::openFileUnique(stmFilename)));
+    auto& reads = stmStorage->m_readsCount;
+    volume = phkvs::StorageVolume::open(phkvs::FileSystem::openFileUnique(volumeFilename), std::move(stmStorage),
+            phkvs::BigFileStorage::open(phkvs::FileSystem::openFileUnique(bigFilename)));
+
+    auto val = volume->lookup(keys[5]);
+    ASSERT_TRUE(val);
+    EXPECT_EQ(boost::get<uint32_t>(*val), 5);
+    //only keys probed by binary search and edge keys are fetched
+    EXPECT_LT(reads, keys.size());
+    size_t firstLookupReads = reads;
+    EXPECT_TRUE(volume->lookup(keys[5]));
+    EXPECT_EQ(reads, firstLookupReads);
+
+    auto entries = volume->getDirEntries("/dir");
+    ASSERT_TRUE(entries);
+    ASSERT_EQ(entries->size(), keys.size());
+    EXPECT_EQ("/dir/" + entries->back().name, keys.back());
+    for(size_t i = 0; i < keys.size(); ++i)
+    {
+        val = volume->lookup(keys[i]);
+        ASSERT_TRUE(val);
+        EXPECT_EQ(boost::get<uint32_t>(*val), i);
+    }
+}
+
+TEST_F(VolumeTest, KeyFingerprints)
+{
+    //single node of keys that differ in first 8 chars, so they are compared without fetching
+    std::vector<std::string> keys;
+    for(size_t i = 0; i < 14; ++i)
+    {
+        keys.push_back(fmt::format("/dir/{:08}{:032}", i, 0));
+        volume->store(keys.back(), static_cast<uint32_t>(i));
+    }
+    //keys with the same prefix and length are fetched
+    std::string samePrefix = "/dir/00000003";
+    volume->store(samePrefix + std::string(32, 'a'), 100u);
+    volume->store(samePrefix + std::string(32, 'b'), 101u);
+    volume.reset();
+    auto stmStorage = std::make_unique<TrackingSmallToMediumFileStorage>(
+            phkvs::SmallToMediumFileStorage::open(phkvs::FileSystem::openFileUnique(stmFilename)));
+    auto& reads = stmStorage->m_readsCount;
+    volume = phkvs::StorageVolume::open(phkvs::FileSystem::openFileUnique(volumeFilename), std::move(stmStorage),
+            phkvs::BigFileStorage::open(phkvs::FileSystem::openFileUnique(bigFilename)));
+
+    auto val = volume->lookup(keys[9]);
+    ASSERT_TRUE(val);
+    EXPECT_EQ(boost::get<uint32_t>(*val), 9);
+    //found key itself
+    EXPECT_EQ(reads, 1);
+    size_t foundReads = reads;
+    EXPECT_FALSE(volume->lookup(fmt::format("/dir/{:07}a{:032}", 7, 0)));
+    EXPECT_FALSE(volume->lookup(fmt::format("/dir/{:08}", 99)));
+    EXPECT_EQ(reads, foundReads);
+    //same prefix, but different hash, only probed key is fetched to find position
+    EXPECT_FALSE(volume->lookup(fmt::format("/dir/{:08}{:032}", 9, 1)));
+    EXPECT_LE(reads, foundReads + 1);
+
+    val = volume->lookup(samePrefix + std::string(32, 'b'));
+    ASSERT_TRUE(val);
+    EXPECT_EQ(boost::get<uint32_t>(*val), 101);
+    for(size_t i = 0; i < keys.size(); ++i)
+    {
+        val = volume->lookup(keys[i]);
+        ASSERT_TRUE(val);
+        EXPECT_EQ(boost::get<uint32_t>(*val), i);
+    }
+    auto entries = volume->getDirEntries("/dir");
+    ASSERT_TRUE(entries);
+    EXPECT_EQ(entries->size(), keys.size() + 2);
+}
+
+TEST_F(VolumeTest, InlineNexts)
+{
+    //short keys are inplace and nexts are stored in nodes, so lookups don't read small to medium storage
+    for(size_t i = 0; i < 200; ++i)
+    {
+        volume->store(fmt::format("/dir{}/key{}", i % 2, i), static_cast<uint32_t>(i));
+    }
+    volume.reset();
+    auto stmStorage = std::make_unique<TrackingSmallToMediumFileStorage>(
+            phkvs::SmallToMediumFileStorage::open(phkvs::FileSystem::openFileUnique(stmFilename)));
+    auto& reads = stmStorage->m_readsCount;
+    volume = phkvs::StorageVolume::open(phkvs::FileSystem::openFileUnique(volumeFilename), std::move(stmStorage),
+            phkvs::BigFileStorage::open(phkvs::FileSystem::openFileUnique(bigFilename)));
+    for(size_t i = 0; i < 200; ++i)
+    {
+        auto val = volume->lookup(fmt::format("/dir{}/key{}", i % 2, i));
+        ASSERT_TRUE(val);
+        EXPECT_EQ(boost::get<uint32_t>(*val), i);
+    }
+    EXPECT_FALSE(volume->lookup("/dir0/key1"));
+    EXPECT_EQ(reads, 0);
+}
+
+TEST_F(VolumeTest, PagedNodes)
+{
+    for(auto dirStructure:{phkvs::StorageVolume::DirStructure::skipList,
+                           phkvs::StorageVolume::DirStructure::bPlusTree})
+    {
+        phkvs::StorageVolume::Options options;
+        options.dirStructure = dirStructure;
+        options.nodePageSize = 4096;
+        recreateStorageVolume(options);
+        EXPECT_EQ(volume->getNodePageSize(), 4096);
+        //derived from page size
+        EXPECT_GT(volume->getNodeEntriesCount(), 16);
+
+        //many dirs, so head nodes are carved from several pages
+        //keys of each dir
+        std::vector<std::map<size_t, uint32_t>> model(50);
+        for(size_t i = 0; i < 5000; ++i)
+        {
+            size_t key = rng() % 2000;
+            volume->store(fmt::format("/dir{}/key{}", i % 50, key), static_cast<uint32_t>(i));
+            model[i % 50][key] = static_cast<uint32_t>(i);
+        }
+        for(size_t d = 0; d < 20; ++d)
+        {
+            volume->eraseDirRecursive(fmt::format("/dir{}", d));
+            model[d].clear();
+        }
+
+        reopenStorageVolume(phkvs::StorageVolume::Options());
+        EXPECT_EQ(volume->getNodePageSize(), 4096);
+        EXPECT_EQ(volume->getDirStructure(), dirStructure);
+        for(size_t i = 0; i < 100; ++i)
+        {
+            volume->store(fmt::format("/newdir{}/key", i), static_cast<uint32_t>(i));
+        }
+        for(size_t i = 0; i < 100; ++i)
+        {
+            auto val = volume->lookup(fmt::format("/newdir{}/key", i));
+            ASSERT_TRUE(val);
+            EXPECT_EQ(boost::get<uint32_t>(*val), i);
+        }
+        for(size_t d = 0; d < 50; ++d)
+        {
+            for(size_t k = 0; k < 2000; k += 7)
+            {
+                auto keyPath = fmt::format("/dir{}/key{}", d, k);
+                auto it = model[d].find(k);
+                auto val = volume->lookup(keyPath);
+                ASSERT_EQ(!!val, it != model[d].end()) << keyPath;
+                if(val)
+                {
+                    EXPECT_EQ(boost::get<uint32_t>(*val), it->second);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(VolumeTest, NodeEntriesCount)
+{
+    phkvs::StorageVolume::Options options;
+    options.nodeEntriesCount = 4;
+    recreateStorageVolume(options);
+    EXPECT_EQ(volume->getNodePageSize(), 0);
+    EXPECT_EQ(volume->getNodeEntriesCount(), 4);
+    for(size_t i = 0; i < 500; ++i)
+    {
+        volume->store(fmt::format("/dir/key{:03}", i), static_cast<uint32_t>(i));
+    }
+    reopenStorageVolume(phkvs::StorageVolume::Options());
+    EXPECT_EQ(volume->getNodeEntriesCount(), 4);
+    auto entries = volume->getDirEntries("/dir");
+    ASSERT_TRUE(entries);
+    ASSERT_EQ(entries->size(), 500);
+    EXPECT_EQ(entries->back().name, "key499");
+
+    //entries don't fit into page
+    options.nodePageSize = 512;
+    options.nodeEntriesCount = 16;
+    EXPECT_THROW(recreateStorageVolume(options), std::runtime_error);
+    options.nodePageSize = 3000;
+    options.nodeEntriesCount = 0;
+    EXPECT_THROW(recreateStorageVolume(options), std::runtime_error);
+}
+
+TEST_F(VolumeTest, HashIndex)
+{
+    for(auto dirStructure:{phkvs::StorageVolume::DirStructure::skipList,
+                           phkvs::StorageVolume::DirStructure::bPlusTree})
+    {
+        phkvs::StorageVolume::Options options;
+        options.dirStructure = dirStructure;
+        options.hashIndex = true;
+        //small nodes are split often, so records of index are moved often
+        options.nodeEntriesCount = 4;
+        recreateStorageVolume(options);
+        EXPECT_TRUE(volume->hasHashIndex());
+
+        std::map<std::string, uint32_t> model;
+        auto check = [this, &model]() {
+            for(size_t d = 0; d < 4; ++d)
+            {
+                for(size_t k = 0; k < 500; ++k)
+                {
+                    auto keyPath = fmt::format("/dir{}/key{}", d, k);
+                    auto it = model.find(keyPath);
+                    auto val = volume->lookup(keyPath);
+                    ASSERT_EQ(!!val, it != model.end()) << keyPath;
+                    if(val)
+                    {
+                        EXPECT_EQ(boost::get<uint32_t>(*val), it->second);
+                    }
+                }
+            }
+            auto vals = volume->lookupMany({"/dir0/key1", "/dir0/sub/key1"});
+            EXPECT_EQ(!!vals[0], model.count("/dir0/key1") != 0);
+            EXPECT_EQ(!!vals[1], model.count("/dir0/sub/key1") != 0);
+        };
+        for(size_t i = 0; i < 10000; ++i)
+        {
+            size_t k = rng() % 500;
+            auto keyPath = k % 2 ? fmt::format("/dir{}/key{}", rng() % 4, k) :
+                           fmt::format("/dir{}/sub/key{}", rng() % 4, k);
+            if(rng() % 3 == 0)
+            {
+                volume->eraseKey(keyPath);
+                model.erase(keyPath);
+            }
+            else
+            {
+                volume->store(keyPath, static_cast<uint32_t>(i));
+                model[keyPath] = static_cast<uint32_t>(i);
+            }
+            if(i % 2000 == 1999)
+            {
+                auto dirPath = fmt::format("/dir{}/sub", rng() % 4);
+                volume->eraseDirRecursive(dirPath);
+                model.erase(model.lower_bound(dirPath + "/"), model.lower_bound(dirPath + "0"));
+            }
+        }
+        //long keys are external, records of moved entries are found by hash from fingerprint
+        for(size_t k = 0; k < 500; k += 2)
+        {
+            auto keyPath = fmt::format("/dir0/{}-{}", std::string(20, 'x'), k);
+            volume->store(keyPath, static_cast<uint32_t>(k));
+            model[keyPath] = static_cast<uint32_t>(k);
+        }
+        check();
+        for(size_t k = 0; k < 500; k += 2)
+        {
+            auto keyPath = fmt::format("/dir0/{}-{}", std::string(20, 'x'), k);
+            auto val = volume->lookup(keyPath);
+            ASSERT_TRUE(val) << keyPath;
+            EXPECT_EQ(boost::get<uint32_t>(*val), k);
+        }
+
+        reopenStorageVolume(phkvs::StorageVolume::Options());
+        EXPECT_TRUE(volume->hasHashIndex());
+        check();
+        for(size_t d = 0; d < 4; ++d)
+        {
+            volume->eraseDirRecursive(fmt::format("/dir{}", d));
+        }
+        EXPECT_FALSE(volume->lookup("/dir0/key1"));
+        volume->store("/dir0/key1", 1u);
+        EXPECT_TRUE(volume->lookup("/dir0/key1"));
+    }
+}
+
+TEST_F(VolumeTest, DirFilters)
+{
+    for(auto dirStructure:{phkvs::StorageVolume::DirStructure::skipList,
+                           phkvs::StorageVolume::DirStructure::bPlusTree})
+    {
+        phkvs::StorageVolume::Options options;
+        options.dirStructure = dirStructure;
+        options.dirFilters = true;
+        recreateStorageVolume(options);
+        EXPECT_TRUE(volume->hasDirFilters());
+        //filters grow several times
+        for(size_t i = 0; i < 1000; ++i)
+        {
+            volume->store(fmt::format("/key{}", i), static_cast<uint32_t>(i));
+            volume->store(fmt::format("/dir{}/key{}", i % 3, i), static_cast<uint32_t>(i));
+        }
+        volume->eraseKey("/key10");
+        volume->eraseDirRecursive("/dir2");
+        volume->store("/dir2/new", 1u);
+
+        volume.reset();
+        auto mainFile = std::make_unique<TrackingFile>(phkvs::FileSystem::openFileUnique(volumeFilename));
+        auto& reads = mainFile->m_readsCount;
+        phkvs::StorageVolume::Options openOptions;
+        openOptions.nodeCacheSize = 0;
+        volume = phkvs::StorageVolume::open(std::move(mainFile),
+                phkvs::SmallToMediumFileStorage::open(phkvs::FileSystem::openFileUnique(stmFilename)),
+                phkvs::BigFileStorage::open(phkvs::FileSystem::openFileUnique(bigFilename)), openOptions);
+        EXPECT_TRUE(volume->hasDirFilters());
+        for(size_t i = 0; i < 1000; ++i)
+        {
+            auto val = volume->lookup(fmt::format("/key{}", i));
+            ASSERT_EQ(!!val, i != 10);
+            if(val)
+            {
+                EXPECT_EQ(boost::get<uint32_t>(*val), i);
+            }
+            EXPECT_EQ(!!volume->lookup(fmt::format("/dir{}/key{}", i % 3, i)), i % 3 != 2);
+        }
+        EXPECT_TRUE(volume->lookup("/dir2/new"));
+
+        //filter of root is loaded, so most misses don't read volume
+        size_t readsBefore = reads;
+        for(size_t i = 0; i < 1000; ++i)
+        {
+            EXPECT_FALSE(volume->lookup(fmt::format("/missing{}", i)));
+            EXPECT_FALSE(volume->lookup(fmt::format("/nodir{}/key", i)));
+        }
+        EXPECT_LT(reads - readsBefore, 200);
+        auto vals = volume->lookupMany({"/key1", "/missing1", "/dir0/key0", "/dir0/missing"});
+        EXPECT_TRUE(vals[0]);
+        EXPECT_FALSE(vals[1]);
+        EXPECT_TRUE(vals[2]);
+        EXPECT_FALSE(vals[3]);
+    }
+}
+
 TEST_F(VolumeTest, ExternalAllocations)
 {
     auto stmAllocAtStart = trackingStmStoragePtr->m_offsetSizeMap;
@@ -377,6 +1126,129 @@ TEST_F(VolumeTest, Expiration)
     EXPECT_EQ(dirOpt->size(), 0);
 }
 
+TEST_F(VolumeTest, ReapExpired)
+{
+    for(size_t i = 0; i < 50; ++i)
+    {
+        volume->store(fmt::format("/live/key{}", i), randomString(100, 100));
+    }
+    auto stmSlotsCount = trackingStmStoragePtr->m_offsetSizeMap.size();
+    auto past = std::chrono::system_clock::now() - std::chrono::seconds(10);
+    auto future = std::chrono::system_clock::now() + std::chrono::hours(1);
+    const size_t expiredCount = 100;
+    for(size_t i = 0; i < expiredCount; ++i)
+    {
+        volume->store(fmt::format("/ttl/key{}", i), randomString(100, 100), past);
+    }
+    volume->store("/ttl/overwritten", uint8_t{1}, past);
+    volume->store("/ttl/overwritten", uint8_t{2});
+    volume->store("/ttl/future", uint8_t{3}, future);
+
+    EXPECT_TRUE(volume->hasExpiredKeys());
+    EXPECT_EQ(volume->reapExpired(30), 30);
+    size_t processed = 30;
+    while(size_t count = volume->reapExpired(1000))
+    {
+        processed += count;
+    }
+    //overwritten key is still in index, but isn't erased
+    EXPECT_EQ(processed, expiredCount + 1);
+    EXPECT_FALSE(volume->hasExpiredKeys());
+    auto val = volume->lookup("/ttl/overwritten");
+    ASSERT_TRUE(val);
+    EXPECT_EQ(boost::get<uint8_t>(*val), 2);
+    EXPECT_TRUE(volume->lookup("/ttl/future"));
+    auto dirOpt = volume->getDirEntries("/ttl");
+    ASSERT_TRUE(dirOpt);
+    EXPECT_EQ(dirOpt->size(), 2);
+    //values of expired keys are freed
+    EXPECT_LT(trackingStmStoragePtr->m_offsetSizeMap.size(), stmSlotsCount + 10);
+
+    reopenStorageVolume(phkvs::StorageVolume::Options{});
+    EXPECT_FALSE(volume->hasExpiredKeys());
+    EXPECT_TRUE(volume->lookup("/ttl/future"));
+    EXPECT_TRUE(volume->lookup("/live/key0"));
+}
+
+TEST_F(VolumeTest, CopyWithModifications)
+{
+    std::map<std::string, std::string> expected;
+    for(size_t i = 0; i < 300; ++i)
+    {
+        auto keyPath = fmt::format("/dir{}/key{:03}", i % 3, i);
+        auto value = randomString(10, 300);
+        volume->store(keyPath, value);
+        expected[keyPath] = value;
+    }
+    volume->store("/dir0/expired", uint8_t{1}, std::chrono::system_clock::now() - std::chrono::seconds(10));
+
+    boost::filesystem::path targetFilename = "test-target-volume.bin";
+    boost::filesystem::path targetStmFilename = "test-target-stm.bin";
+    boost::filesystem::path targetBigFilename = "test-target-big.bin";
+    addToCleanup(targetFilename);
+    addToCleanup(targetStmFilename);
+    addToCleanup(targetBigFilename);
+    auto target = phkvs::StorageVolume::create(phkvs::FileSystem::createFileUnique(targetFilename),
+            phkvs::SmallToMediumFileStorage::create(phkvs::FileSystem::createFileUnique(targetStmFilename)),
+            phkvs::BigFileStorage::create(phkvs::FileSystem::createFileUnique(targetBigFilename)));
+
+    volume->startCopy(*target);
+    //the whole dir0 and part of dir1
+    EXPECT_TRUE(volume->copyStep(150));
+
+    auto modify = [this, &expected](const std::string& keyPath, const std::string& value) {
+        volume->store(keyPath, value);
+        expected[keyPath] = value;
+    };
+    //copied, not copied and new keys
+    modify("/dir0/key000", "new0");
+    modify("/dir2/key002", "new2");
+    modify("/dir0/new", "new");
+    modify("/dir3/new", "new");
+    volume->eraseKey("/dir0/key003");
+    expected.erase("/dir0/key003");
+    volume->eraseKey("/dir2/key005");
+    expected.erase("/dir2/key005");
+    phkvs::StorageVolume::WriteBatch batch;
+    batch.store("/dir1/key001", std::string("batch1"));
+    expected["/dir1/key001"] = "batch1";
+    batch.eraseKey("/dir0/key006");
+    expected.erase("/dir0/key006");
+    volume->write(batch);
+
+    while(volume->copyStep(100))
+    {
+        volume->eraseDirRecursive("/dir1");
+    }
+    for(auto it = expected.begin(); it != expected.end();)
+    {
+        it = it->first.compare(0, 6, "/dir1/") == 0 ? expected.erase(it) : std::next(it);
+    }
+    //modifications after copy is complete are applied too
+    modify("/dir2/key008", "new8");
+    volume->stopCopy();
+    volume->store("/dir2/key011", std::string("notcopied"));
+
+    EXPECT_GT(volume->getFreedSize(), 0);
+    for(auto& dir : {"/dir0", "/dir2", "/dir3"})
+    {
+        auto sourceDir = volume->getDirEntries(dir);
+        auto targetDir = target->getDirEntries(dir);
+        ASSERT_TRUE(sourceDir);
+        ASSERT_TRUE(targetDir);
+        EXPECT_EQ(sourceDir->size(), targetDir->size());
+    }
+    EXPECT_FALSE(target->getDirEntries("/dir1"));
+    for(auto& p : expected)
+    {
+        auto val = target->lookup(p.first);
+        ASSERT_TRUE(val) << p.first;
+        EXPECT_EQ(boost::get<std::string>(*val), p.second);
+    }
+    EXPECT_FALSE(target->lookup("/dir0/expired"));
+    EXPECT_NE(boost::get<std::string>(*target->lookup("/dir2/key011")), "notcopied");
+}
+
 TEST_F(VolumeTest, OverwriteException)
 {
     volume->store("/dir/key", uint8_t{1});
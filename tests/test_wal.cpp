@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+
+#include "FilesCleanupFixture.hpp"
+
+#include "WriteAheadLog.hpp"
+
+#include <boost/filesystem.hpp>
+
+class WriteAheadLogTest : public FilesCleanupFixture {
+public:
+    boost::filesystem::path logFilename = "test-wal.bin";
+    boost::filesystem::path dataFilename1 = "test-data1.bin";
+    boost::filesystem::path dataFilename2 = "test-data2.bin";
+
+    phkvs::WriteAheadLog::UniquePtr log;
+
+    WriteAheadLogTest()
+    {
+        addToCleanup(logFilename);
+        addToCleanup(dataFilename1);
+        addToCleanup(dataFilename2);
+    }
+
+    std::vector<phkvs::FileSystem::UniqueFilePtr> openDataFiles()
+    {
+        std::vector<phkvs::FileSystem::UniqueFilePtr> rv;
+        rv.push_back(phkvs::FileSystem::openFileUnique(dataFilename1));
+        rv.push_back(phkvs::FileSystem::openFileUnique(dataFilename2));
+        return rv;
+    }
+
+    void createLog(phkvs::WriteAheadLog::Options options = {})
+    {
+        std::vector<phkvs::FileSystem::UniqueFilePtr> dataFiles;
+        dataFiles.push_back(phkvs::FileSystem::createFileUnique(dataFilename1));
+        dataFiles.push_back(phkvs::FileSystem::createFileUnique(dataFilename2));
+        log = phkvs::WriteAheadLog::create(phkvs::FileSystem::createFileUnique(logFilename),
+                                           std::move(dataFiles), options);
+    }
+
+    void openLog(phkvs::WriteAheadLog::Options options = {})
+    {
+        log = phkvs::WriteAheadLog::open(phkvs::FileSystem::openFileUnique(logFilename), openDataFiles(), options);
+    }
+
+    static std::vector<uint8_t> readFile(const boost::filesystem::path& filename)
+    {
+        auto file = phkvs::FileSystem::openFileUnique(filename);
+        std::vector<uint8_t> rv(file->getSize());
+        file->readAt(0, boost::asio::buffer(rv));
+        return rv;
+    }
+};
+
+TEST_F(WriteAheadLogTest, PendingChangesAreVisibleAndApplied)
+{
+    createLog();
+    auto file1 = log->getFile(0);
+    auto file2 = log->getFile(1);
+
+    std::vector<uint8_t> data1(10000);
+    for(size_t i = 0; i < data1.size(); ++i)
+    {
+        data1[i] = static_cast<uint8_t>(i);
+    }
+    file1->writeAt(0, boost::asio::buffer(data1));
+    std::vector<uint8_t> data2 = {1, 2, 3, 4, 5, 6, 7, 8};
+    file2->writeAt(5000, boost::asio::buffer(data2));
+
+    EXPECT_EQ(file1->getSize(), data1.size());
+    EXPECT_EQ(file2->getSize(), 5000 + data2.size());
+    EXPECT_EQ(readFile(dataFilename1).size(), 0);
+
+    std::vector<uint8_t> dataRead(data1.size());
+    file1->readAt(0, boost::asio::buffer(dataRead));
+    EXPECT_EQ(data1, dataRead);
+
+    log->sync();
+
+    EXPECT_EQ(readFile(dataFilename1), data1);
+    auto fileData2 = readFile(dataFilename2);
+    ASSERT_EQ(fileData2.size(), 5000 + data2.size());
+    EXPECT_TRUE(std::equal(data2.begin(), data2.end(), fileData2.begin() + 5000));
+    EXPECT_TRUE(std::all_of(fileData2.begin(), fileData2.begin() + 5000, [](uint8_t v) { return v == 0; }));
+
+    //partial overwrite of synced data is merged with file content
+    std::vector<uint8_t> patch = {0xff, 0xff};
+    file1->writeAt(4095, boost::asio::buffer(patch));
+    file1->readAt(0, boost::asio::buffer(dataRead));
+    data1[4095] = 0xff;
+    data1[4096] = 0xff;
+    EXPECT_EQ(data1, dataRead);
+    log->sync();
+    EXPECT_EQ(readFile(dataFilename1), data1);
+}
+
+TEST_F(WriteAheadLogTest, ReplayOnOpen)
+{
+    createLog();
+    std::vector<uint8_t> data(100, 0xaa);
+    {
+        auto file = log->getFile(0);
+        file->writeAt(0, boost::asio::buffer(data));
+    }
+    log->sync();
+    log.reset();
+
+    //simulate lost write of data file
+    {
+        auto dataFile = phkvs::FileSystem::openFileUnique(dataFilename1);
+        dataFile->truncate(0);
+    }
+    openLog();
+    EXPECT_EQ(readFile(dataFilename1), data);
+    //log is truncated after replay
+    EXPECT_LT(readFile(logFilename).size(), data.size());
+}
+
+TEST_F(WriteAheadLogTest, TornRecordIsIgnored)
+{
+    createLog();
+    std::vector<uint8_t> data1(100, 0xaa);
+    std::vector<uint8_t> data2(100, 0xbb);
+    auto file = log->getFile(0);
+    file->writeAt(0, boost::asio::buffer(data1));
+    log->sync();
+    auto logSizeAfterFirstRecord = readFile(logFilename).size();
+    file->writeAt(0, boost::asio::buffer(data2));
+    log->sync();
+    file.reset();
+    log.reset();
+
+    //cut the second record and simulate lost writes of both records
+    {
+        auto logFile = phkvs::FileSystem::openFileUnique(logFilename);
+        logFile->truncate(logFile->getSize() - 1);
+        EXPECT_GT(logFile->getSize(), logSizeAfterFirstRecord);
+        auto dataFile = phkvs::FileSystem::openFileUnique(dataFilename1);
+        dataFile->truncate(0);
+    }
+    openLog();
+    EXPECT_EQ(readFile(dataFilename1), data1);
+}
+
+TEST_F(WriteAheadLogTest, Truncate)
+{
+    createLog();
+    auto file = log->getFile(0);
+    std::vector<uint8_t> data(10000, 0xaa);
+    file->writeAt(0, boost::asio::buffer(data));
+    log->sync();
+    file->truncate(100);
+    EXPECT_EQ(file->getSize(), 100);
+    std::vector<uint8_t> tail(10, 0xbb);
+    file->writeAt(200, boost::asio::buffer(tail));
+    EXPECT_EQ(file->getSize(), 210);
+    log->sync();
+
+    auto fileData = readFile(dataFilename1);
+    ASSERT_EQ(fileData.size(), 210);
+    EXPECT_TRUE(std::all_of(fileData.begin(), fileData.begin() + 100, [](uint8_t v) { return v == 0xaa; }));
+    EXPECT_TRUE(std::all_of(fileData.begin() + 100, fileData.begin() + 200, [](uint8_t v) { return v == 0; }));
+    EXPECT_TRUE(std::all_of(fileData.begin() + 200, fileData.end(), [](uint8_t v) { return v == 0xbb; }));
+}
+
+TEST_F(WriteAheadLogTest, GroupCommitAndCheckpoint)
+{
+    phkvs::WriteAheadLog::Options options;
+    options.groupCommitSize = 1000;
+    options.checkpointSize = 5000;
+    createLog(options);
+    auto file = log->getFile(0);
+    std::vector<uint8_t> data(100, 0xaa);
+    for(size_t i = 0; i < 9; ++i)
+    {
+        file->writeAt(i * data.size(), boost::asio::buffer(data));
+        log->commit();
+    }
+    EXPECT_EQ(readFile(dataFilename1).size(), 0);
+    file->writeAt(900, boost::asio::buffer(data));
+    log->commit();
+    EXPECT_EQ(readFile(dataFilename1).size(), 1000);
+    for(size_t i = 0; i < 100; ++i)
+    {
+        file->writeAt(i * data.size(), boost::asio::buffer(data));
+        log->commit();
+    }
+    EXPECT_LT(readFile(logFilename).size(), options.checkpointSize);
+}